@@ -3,6 +3,7 @@ const cors = require('cors');
 const bodyParser = require('body-parser');
 const { spawn } = require('child_process');
 const path = require('path');
+const { EventEmitter } = require('events');
 
 const app = express();
 // Use the port provided by the environment (for deployment platforms like Render, Railway, etc.)
@@ -18,6 +19,99 @@ app.use((req, res, next) => {
   next();
 });
 
+// Get the absolute path to the bank_app executable
+const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
+
+// Long-lived `bank serve` process shared by all requests, so the database is
+// loaded once instead of on every call. Commands are written as tab-separated
+// lines and answered in order with "<code> <stdoutLength> <stderrLength>\n"
+// followed by the captured stdout and stderr bytes.
+let bankDaemon = null;
+let daemonBuffer = Buffer.alloc(0);
+const pendingCommands = [];
+
+function failPendingCommands(message) {
+  while (pendingCommands.length > 0) {
+    const backend = pendingCommands.shift();
+    backend.stderr.emit('data', Buffer.from(message));
+    backend.emit('close', 1);
+  }
+}
+
+function drainDaemonOutput() {
+  while (pendingCommands.length > 0) {
+    const headerEnd = daemonBuffer.indexOf('\n');
+    if (headerEnd === -1) return;
+
+    const [code, outLength, errLength] = daemonBuffer.slice(0, headerEnd).toString().split(' ').map(Number);
+    const frameEnd = headerEnd + 1 + outLength + errLength;
+    if (daemonBuffer.length < frameEnd) return;
+
+    const stdout = daemonBuffer.slice(headerEnd + 1, headerEnd + 1 + outLength);
+    const stderr = daemonBuffer.slice(headerEnd + 1 + outLength, frameEnd);
+    daemonBuffer = daemonBuffer.slice(frameEnd);
+
+    const backend = pendingCommands.shift();
+    if (stdout.length > 0) backend.stdout.emit('data', stdout);
+    if (stderr.length > 0) backend.stderr.emit('data', stderr);
+    backend.emit('close', code);
+  }
+}
+
+function startBankDaemon() {
+  bankDaemon = spawn(bankAppPath, ['serve']);
+  daemonBuffer = Buffer.alloc(0);
+
+  bankDaemon.stdout.on('data', (data) => {
+    daemonBuffer = Buffer.concat([daemonBuffer, data]);
+    drainDaemonOutput();
+  });
+
+  bankDaemon.stderr.on('data', (data) => {
+    console.error('Backend daemon:', data.toString());
+  });
+
+  const daemon = bankDaemon;
+  const onExit = () => {
+    if (bankDaemon !== daemon) return;
+    console.error('Backend daemon exited');
+    bankDaemon = null;
+    failPendingCommands('Backend process exited');
+  };
+  daemon.on('error', onExit);
+  daemon.on('close', onExit);
+  daemon.stdin.on('error', onExit);
+}
+
+// Drop-in replacement for spawn(bankAppPath, args): returns an emitter with
+// stdout/stderr 'data' events and a 'close' event carrying the exit code.
+// Set BANK_SPAWN_PER_REQUEST=1 to fall back to one process per request.
+function runBank(args) {
+  if (process.env.BANK_SPAWN_PER_REQUEST) {
+    return spawn(bankAppPath, args);
+  }
+
+  const backend = new EventEmitter();
+  backend.stdout = new EventEmitter();
+  backend.stderr = new EventEmitter();
+
+  const fields = args.map(String);
+  if (fields.some((field) => /[\t\r\n]/.test(field))) {
+    process.nextTick(() => {
+      backend.stderr.emit('data', Buffer.from('Invalid characters in request'));
+      backend.emit('close', 1);
+    });
+    return backend;
+  }
+
+  if (!bankDaemon) {
+    startBankDaemon();
+  }
+  pendingCommands.push(backend);
+  bankDaemon.stdin.write(fields.join('\t') + '\n');
+  return backend;
+}
+
 // Routes
 app.post('/api/auth/login', (req, res) => {
   const { username, password } = req.body;
@@ -27,11 +121,9 @@ app.post('/api/auth/login', (req, res) => {
     return res.status(400).json({ error: 'Username and password are required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['login', username, password]);
+  // Run the command on the C++ backend
+  const backend = runBank(['login', username, password]);
 
   let output = '';
   let error = '';
@@ -47,7 +139,7 @@ app.post('/api/auth/login', (req, res) => {
   backend.on('close', (code) => {
     if (code === 0) {
       // Login successful - get user details
-      const userDetailsBackend = spawn(bankAppPath, ['get-user', username]);
+      const userDetailsBackend = runBank(['get-user', username]);
       
       let userOutput = '';
       let userError = '';
@@ -123,11 +215,9 @@ app.post('/api/auth/register', (req, res) => {
     return res.status(400).json({ error: 'Password must be at least 6 characters and include uppercase, lowercase, and numbers' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['register', name, phone, username, password]);
+  // Run the command on the C++ backend
+  const backend = runBank(['register', name, phone, username, password]);
 
   let output = '';
   let error = '';
@@ -168,11 +258,9 @@ app.get('/api/accounts', (req, res) => {
     return res.status(400).json({ error: 'Username is required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['get-accounts', username]);
+  // Run the command on the C++ backend
+  const backend = runBank(['get-accounts', username]);
 
   let output = '';
   let error = '';
@@ -216,11 +304,9 @@ app.post('/api/accounts', (req, res) => {
     return res.status(400).json({ error: 'All fields are required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['create-account', username, password, type, initialBalance.toString()]);
+  // Run the command on the C++ backend
+  const backend = runBank(['create-account', username, password, type, initialBalance.toString()]);
 
   let output = '';
   let error = '';
@@ -263,12 +349,10 @@ app.post('/api/transactions/deposit', (req, res) => {
     return res.status(400).json({ error: 'All fields are required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
   console.log('Using backend path:', bankAppPath);
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['deposit', accountNumber.toString(), amount.toString(), password]);
+  // Run the command on the C++ backend
+  const backend = runBank(['deposit', accountNumber.toString(), amount.toString(), password]);
   console.log('Backend process spawned with args:', ['deposit', accountNumber.toString(), amount.toString(), '[HIDDEN]']);
 
   let output = '';
@@ -309,11 +393,9 @@ app.post('/api/transactions/withdraw', (req, res) => {
     return res.status(400).json({ error: 'All fields are required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['withdraw', accountNumber.toString(), amount.toString(), password]);
+  // Run the command on the C++ backend
+  const backend = runBank(['withdraw', accountNumber.toString(), amount.toString(), password]);
   console.log('Backend process spawned with args:', ['withdraw', accountNumber.toString(), amount.toString(), '[HIDDEN]']);
 
   let output = '';
@@ -346,11 +428,9 @@ app.post('/api/transactions/transfer', (req, res) => {
     return res.status(400).json({ error: 'All fields are required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['transfer', fromAccount.toString(), toAccount.toString(), amount.toString(), password]);
+  // Run the command on the C++ backend
+  const backend = runBank(['transfer', fromAccount.toString(), toAccount.toString(), amount.toString(), password]);
   console.log('Backend process spawned with args:', ['transfer', fromAccount.toString(), toAccount.toString(), amount.toString(), '[HIDDEN]']);
 
   let output = '';
@@ -383,11 +463,17 @@ app.get('/api/transactions/:accountNumber', (req, res) => {
     return res.status(400).json({ error: 'Account number is required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['get-transactions', accountNumber]);
+  // Optional ?from=&to= range (timestamps or dates such as 2024-01-31)
+  const { from, to } = req.query;
+  const args = ['get-transactions', accountNumber];
+  if (from || to) {
+    args.push(from || '');
+    if (to) args.push(to);
+  }
+
+  // Run the command on the C++ backend
+  const backend = runBank(args);
 
   let output = '';
   let error = '';
@@ -425,11 +511,9 @@ app.get('/api/accounts/:accountNumber', (req, res) => {
     return res.status(400).json({ error: 'Account number is required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['get-account', accountNumber]);
+  // Run the command on the C++ backend
+  const backend = runBank(['get-account', accountNumber]);
 
   let output = '';
   let error = '';
@@ -474,11 +558,9 @@ app.delete('/api/accounts/:accountNumber', (req, res) => {
     return res.status(400).json({ error: 'Account number and password are required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['close-account', accountNumber.toString(), password]);
+  // Run the command on the C++ backend
+  const backend = runBank(['close-account', accountNumber.toString(), password]);
   console.log('Backend process spawned with args:', ['close-account', accountNumber.toString(), '[HIDDEN]']);
 
   let output = '';
@@ -511,11 +593,9 @@ app.get('/api/user/profile', (req, res) => {
     return res.status(400).json({ error: 'Username is required' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['get-user', username]);
+  // Run the command on the C++ backend
+  const backend = runBank(['get-user', username]);
 
   let output = '';
   let error = '';
@@ -557,11 +637,9 @@ app.put('/api/user/profile', (req, res) => {
     return res.status(400).json({ error: 'Phone number must be 10 digits' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['update-profile', username, name, phone]);
+  // Run the command on the C++ backend
+  const backend = runBank(['update-profile', username, name, phone]);
 
   let output = '';
   let error = '';
@@ -598,11 +676,9 @@ app.put('/api/user/change-password', (req, res) => {
     return res.status(400).json({ error: 'New password must be at least 6 characters and include uppercase, lowercase, and numbers' });
   }
 
-  // Get the absolute path to the bank_app executable
-  const bankAppPath = path.join(__dirname, 'bin', process.platform === 'win32' ? 'bank.exe' : 'bank');
 
-  // Spawn the C++ backend process
-  const backend = spawn(bankAppPath, ['change-password', username, currentPassword, newPassword]);
+  // Run the command on the C++ backend
+  const backend = runBank(['change-password', username, currentPassword, newPassword]);
 
   let output = '';
   let error = '';
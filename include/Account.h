@@ -1,9 +1,12 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <vector>
 #include "ITransaction.h"
+#include "Money.h"
 
 class Customer;  // Forward declaration
 
@@ -13,27 +16,55 @@ enum class AccountType {
     AUDITABLE_SAVINGS
 };
 
+// The balance is versioned so that it can be read and changed without
+// locks. Readers retry until they see the same even version before and
+// after reading it (a seqlock). A change reads the balance optimistically,
+// then claims the account by swapping that version for the next (odd)
+// number and retries if another change got there first; the version is
+// even again once the new balance is stored. The top bit marks a closed
+// account, which refuses all further changes.
+//
+// Interest accrues lazily: the stored balance is as of an interest period
+// (a count of month-ends), and reading it adds the interest of the periods
+// run since, compounded month by month exactly as month-end used to apply
+// it. A change stores the balance as of the current period.
 class Account {
 protected:
     int accountNumber;
-    double balance;
     Customer* owner;
     // std::vector<std::unique_ptr<ITransaction>> transactionHistory;
     AccountType type;
 
+private:
+    static constexpr uint64_t CLOSED = uint64_t(1) << 63;
+
+    std::atomic<uint64_t> version;
+    std::atomic<int64_t> balance;  // cents
+    std::atomic<uint32_t> accruedPeriod;  // the period balance is as of
+
+    // Swaps an even, open version for the next odd one
+    bool claim(uint64_t seen);
+    // Stores the balance claimed at seen and makes the version even again
+    void publish(uint64_t seen, Money newBalance, uint32_t period);
+    // A stored balance brought forward to period, or period moved up to
+    // storedPeriod if that is later
+    Money accrued(Money stored, uint32_t storedPeriod, uint32_t& period) const;
+
 public:
-    Account(int accNo, double initialBalance, Customer* owner, AccountType type);
+    Account(int accNo, Money initialBalance, Customer* owner, AccountType type);
     virtual ~Account() = default;
 
     // Pure virtual methods
-    virtual bool deposit(double amount) = 0;
-    virtual bool withdraw(double amount) = 0;
+    virtual bool deposit(Money amount) = 0;
+    virtual bool withdraw(Money amount) = 0;
     virtual void applyMonthlyUpdate() = 0;
-    virtual double calculateInterest() const = 0;
+    virtual Money calculateInterest() const = 0;
 
     // Common methods
     int getAccountNumber() const { return accountNumber; }
-    double getBalance() const { return balance; }
+    Money getBalance() const;
+    // Also returns the interest period the balance is as of
+    Money getBalance(uint32_t& period) const;
     Customer* getOwner() const { return owner; }
     AccountType getType() const { return type; }
     std::string getTypeString() const {
@@ -49,10 +80,47 @@ public:
         }
     }
     
+    bool isClosed() const { return (version.load(std::memory_order_acquire) & CLOSED) != 0; }
+
+    // Moves amount between two accounts as one change; false if from lacks
+    // the funds or either account is closed
+    static bool transferBetween(Account& from, Account& to, Money amount);
+
+    // Marks the account closed if its balance is zero; false otherwise
+    bool close();
+
+    // Changes made since startup, and how many times one had to start over
+    // because another change or a closure got to the account first
+    struct ChangeStats {
+        uint64_t changes;
+        uint64_t retries;
+    };
+    static ChangeStats changeStats();
+
+    // The current interest period, read from source (the account table's
+    // header) when one is set and 0 otherwise
+    static uint32_t currentPeriod();
+    static void setPeriodSource(const volatile uint32_t* source);
+
+    // Savings accounts accrue interest lazily; the others are updated by
+    // applyMonthlyUpdate() at every month-end
+    static bool accruesLazily(AccountType type) { return type == AccountType::SAVINGS; }
+
     // Transaction history methods
     void addTransaction(std::unique_ptr<ITransaction> transaction);
     // const std::vector<std::unique_ptr<ITransaction>>& getTransactionHistory() const;
 
 protected:
-    void updateBalance(double newBalance);
+    // Adds delta (negative to take money out) as one optimistic change;
+    // false, leaving the balance alone, if it would go negative or the
+    // account is closed
+    bool changeBalance(Money delta);
+    // Sets the balance outright, as of an interest period, e.g. when
+    // loading or restoring it
+    void updateBalance(Money newBalance, uint32_t period);
+    // The balance after periods month-ends of interest; none by default
+    virtual Money accrue(Money storedBalance, uint32_t periods) const;
+
+    // Database restores journaled balances through updateBalance()
+    friend class Database;
 }; 
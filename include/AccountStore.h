@@ -0,0 +1,175 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Fixed-width account table, data/accounts.dat.
+//
+// Account numbers are handed out sequentially from FIRST_ACCOUNT, so the
+// record of account n lives at HEADER_SIZE + (n - FIRST_ACCOUNT) * SLOT_SIZE
+// and a balance change is persisted with a single pwrite of that slot.
+// Slots that were never written read back as zeroes, i.e. free; closed
+// accounts are marked free in place.
+//
+// Every slot carries the version of the balance it holds, which lets
+// journal replay tell whether a journaled balance is older than the slot,
+// and the interest period the balance is accrued to. The header holds the
+// current interest period; month-end advances it, and savings balances
+// catch up with it lazily (see Account).
+//
+// Balances are whole cents (see Money). Version 1 tables held them as
+// doubles; open() upgrades those in place, holding WRITER_BYTE exclusively
+// so that only one of several processes opening the table does so.
+//
+// Processes changing a balance hold an fcntl write lock on the bytes of its
+// slot (see Lock), so changes to one account serialize across processes
+// while changes to different accounts proceed in parallel. fcntl locks do
+// not exclude threads of the same process, so Lock also takes one of a set
+// of mutexes striped by account number.
+//
+// A process that changes balances without these locks (the optimistic
+// engine) must be the only one changing them: it holds an exclusive lock on
+// WRITER_BYTE for its lifetime, and every other process takes a shared lock
+// on it before its first Lock, so each side refuses while the other runs.
+class AccountStore {
+public:
+    static constexpr char MAGIC[8] = {'B', 'A', 'N', 'K', 'A', 'C', 'C', 'T'};
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t DOUBLE_BALANCE_VERSION = 1;
+    static constexpr int32_t FIRST_ACCOUNT = 10000;
+
+    enum SlotState : uint16_t {
+        FREE = 0,
+        OPEN = 1
+    };
+
+    struct Slot {
+        int32_t number;
+        int32_t ownerId;
+        int64_t balance;   // cents
+        int32_t type;      // AccountType
+        // Formerly one 32-bit state, so older (little-endian) tables read
+        // back as accrued to period 0
+        uint16_t state;    // SlotState
+        uint16_t accruedPeriod;  // interest period the balance is accrued to
+        uint64_t version;  // bumped on every balance change
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t slotSize;
+        int32_t firstAccount;
+        uint32_t interestPeriod;  // month-ends run; zero in older tables
+        uint32_t reserved[2];
+    };
+
+    static constexpr uint64_t HEADER_SIZE = sizeof(Header);
+    static constexpr uint64_t SLOT_SIZE = sizeof(Slot);
+    // Last byte of the header; only ever locked, never written
+    static constexpr uint64_t WRITER_BYTE = HEADER_SIZE - 1;
+    static constexpr uint32_t MAX_INTEREST_PERIOD = UINT16_MAX;
+    // Slots write(slots, gaps) may write back to join two runs; cheaper
+    // than another write call
+    static constexpr int32_t MAX_GAP = 8;
+
+    explicit AccountStore(const std::string& path);
+    ~AccountStore();
+
+    AccountStore(const AccountStore&) = delete;
+    AccountStore& operator=(const AccountStore&) = delete;
+
+    // Opens the file; false if it does not exist, throws if it is not an
+    // account table. A version 1 table is first rewritten as version 2.
+    bool open();
+
+    // Atomically replaces the file with the given open slots and opens it
+    void create(const std::vector<Slot>& slots);
+
+    // Open slots in account-number order
+    std::vector<Slot> readAll() const;
+
+    // One account's slot; false if it is free or beyond the end of the file
+    bool read(int accountNumber, Slot& slot) const;
+
+    // Positional writes; not durable until sync()
+    void write(const Slot& slot);
+    // Slots in account-number order; each run of consecutive accounts goes
+    // out in a single write. Given gaps, runs up to MAX_GAP slots apart are
+    // joined too, writing back the slots in between as they were just read;
+    // those are added to gaps, so the caller can redo any it changed meanwhile.
+    void write(const std::vector<Slot>& slots, std::vector<Slot>* gaps = nullptr);
+    void release(int accountNumber);
+    void sync();
+    // Makes the writes this thread made before the call durable. Threads
+    // calling it at the same time share an fdatasync: one that finds none
+    // running starts one covering every write so far, and the others wait
+    // for it, or for the next one if theirs came in too late.
+    void syncWrites();
+
+    // The header's interest period, mapped so that a month-end run by any
+    // process shows up here at once. The address stays valid, and keeps
+    // following the file, across open() and create().
+    const volatile uint32_t* interestPeriodSource() const;
+    // Durably stores a new interest period; month-end only, as sole writer
+    void setInterestPeriod(uint32_t period);
+
+    // Makes this process the only one allowed to change balances, until it
+    // exits; false if another process has taken a Lock or claimed it first
+    bool claimSoleWriter();
+    // Gives a claim back, leaving this process a writer like any other
+    void releaseSoleWriter();
+
+    static uint64_t offsetOf(int accountNumber);
+
+    static constexpr size_t LOCK_STRIPES = 64;
+
+    // Write locks on some accounts' slots, held until destroyed. Stripes are
+    // taken in stripe order and then slots in account-number order, so
+    // threads and processes locking overlapping sets cannot deadlock.
+    class Lock {
+    public:
+        Lock(AccountStore& store, std::vector<int> accountNumbers);
+        Lock(Lock&& other) noexcept;
+        ~Lock();
+
+        Lock(const Lock&) = delete;
+        Lock& operator=(const Lock&) = delete;
+        Lock& operator=(Lock&&) = delete;
+
+    private:
+        AccountStore* store;
+        int fd;
+        std::vector<int> accountNumbers;
+        std::vector<size_t> stripes;
+
+        void release();
+    };
+
+private:
+    std::string path;
+    int fd;
+    // The mapped header, or a copy of its period where nothing is mapped
+    void* mappedHeader;
+    uint32_t periodCopy;
+    std::mutex stripes[LOCK_STRIPES];
+    // How this process holds WRITER_BYTE, if at all
+    std::mutex writerMutex;
+    bool soleWriter;
+    bool sharedWriter;
+    // syncWrites() callers, numbered in arrival order
+    std::mutex syncMutex;
+    std::condition_variable syncDone;
+    uint64_t syncRequests;
+    uint64_t syncedThrough;  // requests covered by a finished sync
+    bool syncing;
+
+    void shareWriter();  // before the first Lock; throws if a sole writer runs
+    void mapHeader(const Header& current);
+    void upgradeBalances();
+
+    void writeAt(uint64_t offset, const void* data, size_t length);
+};
@@ -4,6 +4,7 @@
 #include <fstream>
 #include <chrono>
 #include <iomanip>
+#include "Transaction.h"
 
 class Auditable {
 protected:
@@ -17,7 +18,8 @@ protected:
         auto now = std::chrono::system_clock::now();
         auto time = std::chrono::system_clock::to_time_t(now);
         
-        logFile << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S")
+        std::tm local = localTime(time);
+        logFile << std::put_time(&local, "%Y-%m-%d %H:%M:%S")
                 << " - " << action << std::endl;
     }
 
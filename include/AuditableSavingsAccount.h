@@ -2,6 +2,7 @@
 
 #include "SavingsAccount.h"
 #include "Auditable.h"
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -10,19 +11,22 @@ private:
     struct AuditEntry {
         std::string timestamp;
         std::string action;
-        double amount;
-        double balance;
+        Money amount;
+        Money balance;
     };
     std::vector<AuditEntry> auditLog;
+    // Balance changes no longer lock the account, so the log has its own lock
+    std::mutex auditMutex;
     std::string getCurrentTimestamp() const;
+    void record(const std::string& action, Money amount, const std::string& message);
 
 public:
-    AuditableSavingsAccount(int accNo, double initialBalance, Customer* owner,
+    AuditableSavingsAccount(int accNo, Money initialBalance, Customer* owner,
                            double interestRate = SavingsAccount::getDefaultInterestRate(),
                            const std::string& logFileName = "savings_audit.log");
     
-    bool deposit(double amount) override;
-    bool withdraw(double amount) override;
+    bool deposit(Money amount) override;
+    bool withdraw(Money amount) override;
     void applyMonthlyUpdate() override;
 
     // Audit log methods
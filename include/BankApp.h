@@ -4,6 +4,7 @@
 #include "Account.h"
 #include "Transaction.h"
 #include "Database.h"
+#include <iostream>
 #include <memory>
 #include <string>
 
@@ -38,6 +39,10 @@ private:
     // void handleAccountStatement();
     // void handleAccountClosure();
 
+    // deposit/withdraw/transfer through the sequencer or optimistic engine
+    bool applyChange(Sequencer::Kind kind, int accountNumber, int toAccount, Money amount,
+                     const std::string& password, std::ostream& errors);
+
 public:
     static BankApp* getInstance(const std::string& bankName = "MyBank");
     void run();
@@ -46,24 +51,36 @@ public:
     // Input validation methods (moved from private)
     bool isValidName(const std::string& name);
     bool isValidPhone(const std::string& phone);
-    bool isValidUsername(const std::string& username);
+    bool isValidUsername(const std::string& username, std::ostream& errors);  // says why on errors
     bool isValidPassword(const std::string& password);
     
-    // API methods for command-line integration
+    // API methods for command-line integration. Those that can fail say why on
+    // errors, which the servers point at a stream of the request being handled.
     bool registerCustomer(const std::string& name, const std::string& phone, 
                          const std::string& username, const std::string& password);
     bool authenticateCustomer(const std::string& username, const std::string& password, int& customerId);
-    int createAccount(const std::string& username, const std::string& password, const std::string& accountType, double initialBalance);
-    bool deposit(int accountNumber, double amount, const std::string& password);
-    bool withdraw(int accountNumber, double amount, const std::string& password);
-    bool transfer(int fromAccount, int toAccount, double amount, const std::string& password);
-    bool closeAccount(int accountNumber, const std::string& password);
+    int createAccount(const std::string& username, const std::string& password, const std::string& accountType, Money initialBalance);
+    bool deposit(int accountNumber, Money amount, const std::string& password, std::ostream& errors = std::cerr);
+    bool withdraw(int accountNumber, Money amount, const std::string& password, std::ostream& errors = std::cerr);
+    bool transfer(int fromAccount, int toAccount, Money amount, const std::string& password,
+                  std::ostream& errors = std::cerr);
+    bool closeAccount(int accountNumber, const std::string& password, std::ostream& errors = std::cerr);
     std::string getAccounts(const std::string& username);
     std::string getAccountDetails(int accountNumber);
-    std::string getTransactions(int accountNumber);
+    std::string getTransactions(int accountNumber, const std::string& from = "", const std::string& to = "",
+                                std::ostream& errors = std::cerr);
     std::string getUserDetails(const std::string& username);
-    bool updateProfile(const std::string& username, const std::string& name, const std::string& phone);
-    bool changePassword(const std::string& username, const std::string& currentPassword, const std::string& newPassword);
+    bool updateProfile(const std::string& username, const std::string& name, const std::string& phone,
+                       std::ostream& errors = std::cerr);
+    bool changePassword(const std::string& username, const std::string& currentPassword, const std::string& newPassword,
+                        std::ostream& errors = std::cerr);
+
+    // Maintenance
+    std::string compactTransactions(uint64_t bytesPerSecond, std::ostream& errors = std::cerr);  // JSON stats
+    void startBackgroundCompaction(unsigned int intervalSeconds, uint64_t bytesPerSecond);
+    bool convertSnapshot(bool binary, std::ostream& errors = std::cerr);  // switch the checkpoint format
+    std::string getEngineStats();       // JSON: engine, retry rate, batches
+    std::string runMonthEnd(unsigned int threads, std::ostream& errors = std::cerr);  // JSON stats and failed accounts
     
     // Transaction handling
     // void performTransaction(int accountNumber, const std::string& type);
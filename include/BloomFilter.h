@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Bloom filter over account numbers, used in history segment footers to
+// skip segments that cannot contain an account. Sized for about a 1%
+// false-positive rate at the expected number of accounts.
+class BloomFilter {
+private:
+    std::vector<uint64_t> words;
+    unsigned int hashes;
+
+    uint64_t bitCount() const { return words.size() * 64; }
+
+public:
+    explicit BloomFilter(size_t expectedAccounts = 0);
+
+    void add(int accountNumber);
+    bool mayContain(int accountNumber) const;
+
+    // "<bits>/<hashes>/<hex words>"
+    std::string serialize() const;
+    static bool parse(std::string_view text, BloomFilter& filter);
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "BankApp.h"
+#include <iostream>
+#include <string>
+
+// Long-lived daemon mode for the command-line API.
+//
+// The database is loaded once and requests are served from the warm state.
+// Each request is a single line of tab-separated fields, e.g.
+//     deposit\t10001\t250.00\tSecret1\n
+// and each response is a header line followed by the captured output:
+//     <exitCode> <stdoutLength> <stderrLength>\n<stdout bytes><stderr bytes>
+class CommandServer {
+private:
+    BankApp* app;
+
+    void handleRequest(const std::string& line, std::ostream& out);
+
+public:
+    explicit CommandServer(BankApp* app);
+
+    // Serve framed requests from `in` until EOF
+    void serve(std::istream& in, std::ostream& out);
+
+    // Serve framed requests on stdin/stdout
+    int serveStdio();
+
+    // Serve framed requests on a Unix domain socket, one connection at a time
+    int serveSocket(const std::string& socketPath);
+};
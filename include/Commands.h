@@ -0,0 +1,10 @@
+#pragma once
+
+#include "BankApp.h"
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Runs one API command (args[0] is the command name, e.g. "deposit").
+// Results go to out, errors to err; returns the process exit code.
+int runCommand(BankApp* app, const std::vector<std::string>& args, std::ostream& out, std::ostream& err);
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "GroupCommitLog.h"
+#include "TransactionIndex.h"
+#include <cstdint>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <unordered_set>
+
+// Reclaims space in the transaction history by dropping the lines of closed
+// accounts (everything but the tombstone of an account with a CLOSED line).
+//
+// Works one sealed segment at a time: segments whose footer and index show
+// reclaimable lines are streamed into a new file, throttled to a byte rate,
+// which is then renamed into place together with its index and footer.
+// Sealed segments never receive appends, so traffic carries on throughout;
+// an active segment holding closed accounts is sealed first once it has
+// reached the seal size.
+class Compactor {
+public:
+    struct Stats {
+        bool compacted = false;       // false when there was nothing to drop
+        size_t segmentsRewritten = 0;
+        uint64_t bytesBefore = 0;     // of the rewritten segments
+        uint64_t bytesAfter = 0;
+        uint64_t linesDropped = 0;
+        size_t accountsDropped = 0;   // with lines dropped in this run
+        double seconds = 0.0;
+
+        uint64_t bytesReclaimed() const { return bytesBefore - bytesAfter; }
+    };
+
+    static constexpr uint64_t THROTTLE_CHUNK = 1 << 20;  // bytes copied between throttle checks
+
+    Compactor(GroupCommitLog& log, TransactionIndex& index);
+    ~Compactor();
+
+    // Compact now; bytesPerSecond of 0 means unthrottled
+    Stats run(uint64_t bytesPerSecond = 0);
+
+    // Compact every intervalSeconds on a background thread, if accounts
+    // were closed since the last run
+    void startBackground(unsigned int intervalSeconds, uint64_t bytesPerSecond);
+    void stopBackground();
+
+    // Called when a tombstone is written
+    void noteClosure();
+
+private:
+    GroupCommitLog& log;
+    TransactionIndex& index;
+
+    std::mutex runMutex;  // one compaction at a time
+
+    std::mutex backgroundMutex;
+    std::condition_variable wakeup;
+    std::thread background;
+    bool stopping;
+    uint64_t closures;    // tombstones written since the last run
+
+    void backgroundLoop(unsigned int intervalSeconds, uint64_t bytesPerSecond);
+    class Throttle;
+    void compactSegment(unsigned int id, const std::unordered_set<int>& closed, Throttle& throttle, Stats& stats,
+                        std::unordered_set<int>& droppedAccounts);
+};
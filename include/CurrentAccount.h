@@ -4,18 +4,18 @@
 
 class CurrentAccount : public Account {
 private:
-    double maintenanceFee;
-    static constexpr double DEFAULT_MAINTENANCE_FEE = 10.0; // $10 monthly fee
+    Money maintenanceFee;
+    static constexpr Money DEFAULT_MAINTENANCE_FEE = Money::fromMinor(1000); // $10 monthly fee
 
 public:
-    CurrentAccount(int accNo, double initialBalance, Customer* owner,
-                  double maintenanceFee = DEFAULT_MAINTENANCE_FEE);
+    CurrentAccount(int accNo, Money initialBalance, Customer* owner,
+                  Money maintenanceFee = DEFAULT_MAINTENANCE_FEE);
     
-    bool deposit(double amount) override;
-    bool withdraw(double amount) override;
+    bool deposit(Money amount) override;
+    bool withdraw(Money amount) override;
     void applyMonthlyUpdate() override;
-    double calculateInterest() const override; // Returns 0 as current accounts don't earn interest
+    Money calculateInterest() const override; // Returns 0 as current accounts don't earn interest
     
-    double getMaintenanceFee() const { return maintenanceFee; }
-    void setMaintenanceFee(double newFee) { maintenanceFee = newFee; }
+    Money getMaintenanceFee() const { return maintenanceFee; }
+    void setMaintenanceFee(Money newFee) { maintenanceFee = newFee; }
 }; 
\ No newline at end of file
@@ -18,6 +18,8 @@ public:
     // Account management
     void addAccount(std::unique_ptr<Account> account);
     bool removeAccount(int accountNumber);
+    // Removes the account from the list without destroying it; null if absent
+    std::unique_ptr<Account> takeAccount(int accountNumber);
     const std::vector<std::unique_ptr<Account>>& getAccounts() const;
     Account* findAccount(int accountNumber) const;
 
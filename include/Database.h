@@ -4,28 +4,128 @@
 #include "Customer.h"
 #include "Account.h"
 #include "Transaction.h"
+#include "Journal.h"
+#include "AccountStore.h"
+#include "Snapshot.h"
+#include "GroupCommitLog.h"
+#include "TransactionIndex.h"
+#include "Compactor.h"
+#include "ParallelLoader.h"
+#include "SharedImage.h"
+#include "ShardedMap.h"
+#include "Sequencer.h"
+#include <atomic>
 #include <string>
+#include <string_view>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 #include <mutex>
+#include <shared_mutex>
 #include <map>
 #include <iostream>
 #include <thread>
 
+// Threads may call into the database concurrently. Lookups go through
+// sharded maps and rarely contend; a balance change holds its accounts'
+// AccountStore::Lock (lockAccounts), except under the optimistic engine,
+// where it relies on the account's own compare-and-swap. Anything that
+// journals, creates or removes records, or checkpoints runs under
+// journalMutex. Locks are taken in this order: account locks, journalMutex,
+// snapshotMutex, usernameMutex, then map shards (customers before accounts).
 class Database {
 private:
-    static Database* instance;
-    // static std::mutex mutex;  // Temporarily commented out for compilation
+    static std::atomic<Database*> instance;
+    static std::mutex mutex;  // guards creation of the instance
     std::string dataDir;
     
-    // In-memory storage
-    std::unordered_map<int, std::unique_ptr<Customer>> customers; // customerId -> customer
-    std::unordered_map<std::string, int> usernameToCustomerId;  // username -> customerId
-    std::unordered_map<std::string, std::string> usernamePasswords; // username -> password
-    std::unordered_map<int, Account*> accounts;  // accountNumber -> Account*
-    std::unordered_map<int, std::string> accountPasswords;  // accountNumber -> password
+    // In-memory storage; in lazy mode these are caches filled on first access
+    mutable ShardedMap<int, std::unique_ptr<Customer>> customers; // customerId -> customer
+    mutable std::shared_mutex usernameMutex;  // guards both username maps
+    mutable std::unordered_map<std::string, int> usernameToCustomerId;  // username -> customerId
+    mutable std::unordered_map<std::string, std::string> usernamePasswords; // username -> password
+    mutable ShardedMap<int, Account*> accounts;  // accountNumber -> Account*
+    mutable ShardedMap<int, std::string> accountPasswords;  // accountNumber -> password
     int nextCustomerId;
     int nextAccountNumber;
+    // Checkpoints go to snapshot.bin instead of the text files once it exists
+    bool binarySnapshot;
+    // Held across a change's journal records and their commit; recursive
+    // because removals and checkpoints run inside other changes
+    mutable std::recursive_mutex journalMutex;
+
+    // Lazy mode (sorted binary snapshot plus accounts.dat, unless
+    // BANK_LAZY_LOAD=0): startup maps the snapshot and reads only its
+    // header; records are faulted in by key from the mapping and from
+    // accounts.dat slots. Removals are remembered until the next
+    // checkpoint so the old snapshot cannot bring them back.
+    std::atomic<bool> lazy;
+    // Guards the snapshot mapping and the removal sets: shared while
+    // faulting records in, exclusive while a checkpoint replaces them
+    mutable std::shared_mutex snapshotMutex;
+    // Shared-memory image (BANK_SHM=1); declared before snapshot, which
+    // may point into it
+    std::unique_ptr<SharedImage> sharedImage;
+    SharedImage::Sources imageSources;        // what the tables were built from
+    bool imageStale;                          // changes the image lacks
+    Snapshot snapshot;
+    std::unordered_set<int> erasedCustomers;
+    std::unordered_set<std::string> erasedUsers;
+    std::unordered_set<int> erasedAccounts;
+
+    // What changed since the last checkpoint, so saveAll() rewrites only that
+    enum DirtyTable : unsigned int {
+        DIRTY_CUSTOMERS = 1,
+        DIRTY_AUTH = 2,
+        DIRTY_COUNTERS = 4,
+        DIRTY_ALL = 7
+    };
+    unsigned int dirtyTables;
+    std::unordered_set<int> dirtyAccounts;  // slots to write: created, changed or removed
+    // Journaled changes not yet written through to accounts.dat, which other
+    // processes read balances from
+    std::unordered_set<int> unwrittenSlots;
+
+    // Version of each account's latest balance; slots and journal records
+    // carry it so replay never overwrites a newer slot. A version is bumped
+    // and its balance read under the entry's shard lock, so changes that do
+    // not lock the account still reach its slot and the journal in order.
+    mutable ShardedMap<int, uint64_t> balanceVersions;
+
+    // Account table with one slot per account number
+    AccountStore accountStore;
+    // Splits startup parsing across threads
+    ParallelLoader loader;
+    // Write-ahead journal of mutations since the last checkpoint
+    Journal journal;
+    // Transaction history, appended through group commit
+    GroupCommitLog transactionLog;
+    // Where each account's lines are in the history; filled lazily on lookup
+    mutable TransactionIndex transactionIndex;
+    // Drops closed accounts' history; declared last so it stops first
+    Compactor compactor;
+    // Applies balance changes on one thread (BANK_ENGINE=sequencer); null
+    // when they are made under per-call account locks. Stopped first of all
+    // by the destructor.
+    std::unique_ptr<Sequencer> sequencer;
+    bool optimistic;  // BANK_ENGINE=optimistic, once this process is the sole writer
+
+    // Changes and reads running without the account's lock hold an
+    // UnlockedAccess, and removed accounts are only freed once there are
+    // none, so such a caller never touches a freed account
+    mutable std::atomic<int> unlockedAccesses;
+    std::mutex retiredMutex;
+    std::vector<std::unique_ptr<Account>> retiredAccounts;
+    class UnlockedAccess {
+    public:
+        explicit UnlockedAccess(const Database& db) : db(db) { db.unlockedAccesses++; }
+        ~UnlockedAccess() { db.unlockedAccesses--; }
+    private:
+        const Database& db;
+    };
+    static constexpr size_t CHECKPOINT_THRESHOLD = 1000; // journal records
+    static constexpr uint64_t IMAGE_TAIL_BYTES = 16 * 1024; // journal past the shared image
 
     // Private constructor for singleton
     Database(const std::string& dataDir);
@@ -37,19 +137,82 @@ private:
     std::string getTransactionFilePath() const;
     std::string getAuthFilePath() const;
     std::string getCounterFilePath() const;
+    std::string getSnapshotFilePath() const;
+    std::string getAccountStorePath() const;
 
     // Save/Load operations
     void saveCustomer(const Customer* customer);
-    void saveAccount(const Account* account);
+    void saveAccountSlots();                       // write the dirty accounts' slots and sync them
+    void writeThroughSlots();                      // unsynced; the journal already made them durable
+    void writeAccountSlot(const Account* account); // persist one balance change right away
+    void writeSlotsInBulk(const std::vector<Account*>& changed);  // month-end, as sole writer
+    AccountStore::Slot makeSlot(const Account* account, uint64_t version) const;
+    uint64_t nextBalanceVersion(int accountNumber);
     void saveTransaction(const Account* account, const ITransaction* transaction);
-    void saveTransferTransaction(const ITransaction* transaction);
+    // History lines a transaction adds, with the account each belongs to
+    std::vector<std::pair<int, std::string>> historyLines(const Account* account,
+                                                          const ITransaction* transaction) const;
+    void appendHistory(const std::vector<std::pair<int, std::string>>& lines);  // in one durable append
+    void saveClosure(int accountNumber);  // tombstone hiding a closed account's history
+    void rotateHistory();                 // seal the active history segment when it is full
     void loadCustomers();
-    void loadAccounts();
+    void loadAccounts();        // legacy accounts.txt, migrated to accounts.dat
+    void loadAccountStore();
+    void linkAccount(std::unique_ptr<Account> account, uint64_t version);  // index a loaded account under its owner
+    void migrateAccounts();
     void loadTransactions();
     void saveAuthData();
     void loadAuthData();
     void saveCounters() const;
     void loadCounters();
+    void saveSnapshot();
+    void fillSnapshot(Snapshot::Writer& writer);  // every record, cached or not
+    void loadSnapshot(bool withAccounts);
+    void loadAllLazily();  // fault everything in, e.g. before leaving lazy mode
+    void removeTextSnapshot();
+    std::vector<std::string> snapshotFilePaths() const;
+    void replaceFile(const std::string& tempPath, const std::string& path) const;
+
+    // Journal operations
+    void journalCustomer(const Customer* customer);
+    void journalAccount(const Account* account);
+    void journalBalance(const Account* account);
+    void journalUser(const std::string& username);
+    void journalCounters();
+    void journalRecord(const std::string& record);
+    void markDirty(const std::string& record);
+    void commitJournal();
+    bool checkpoint();  // false if another process truncated the journal under this one
+    void recoverJournal(uint64_t from = 0, uint64_t prefixHash = Journal::EMPTY_HASH);
+    void applyJournalRecord(const std::string& record);
+    void applyJournaledBalance(Account* account, std::string_view balance, std::string_view version,
+                               std::string_view period);
+    static uint32_t journaledPeriod(std::string_view period);
+
+    // In-memory helpers shared by loading, recovery and the public API
+    // The balance is as of the given interest period
+    static std::unique_ptr<Account> makeAccount(int accountNumber, Money balance, Customer* owner, int type,
+                                                uint32_t period);
+    void eraseAccount(int accountNumber);
+    void freeRetiredAccounts();  // unless an UnlockedAccess may still use them
+    // Slot balances newer than the in-memory ones, written by other processes
+    void reloadBalance(Account* account, const AccountStore::Slot& slot);
+    bool claimBalances();  // become the sole writer for the optimistic engine
+    // Lazy mode lookups; each caches what it finds
+    Customer* faultCustomer(int customerId) const;
+    bool lookupUser(const std::string& username) const;
+    bool lookupAccountPassword(int accountNumber) const;
+    std::string usernameOf(int customerId) const;
+    void eraseCustomer(int customerId);
+    void markAccountDirty(int accountNumber);
+    // Sequencer processor: applies a batch under its accounts' locks and
+    // persists it with one history append and one journal commit
+    void applySequenced(const std::vector<Sequencer::Command*>& batch);
+
+    // Shared image: attach instead of loading, publish after changes
+    bool attachImage();
+    void publishImage();
+    void refreshImage();        // after a commit: republish, or extend its journal prefix
 
 public:
     static Database* getInstance(const std::string& dataDir = "data");
@@ -57,31 +220,99 @@ public:
     // Customer operations
     bool addCustomer(std::unique_ptr<Customer> customer, const std::string& username, const std::string& password);
     Customer* findCustomer(int customerId) const;
+    void updateCustomer(const Customer* customer);
     bool removeCustomer(int customerId);
     
     // Account operations
     bool addAccount(std::unique_ptr<Account> account, const std::string& password);
     Account* findAccount(int accountNumber) const;
     bool removeAccount(int accountNumber);
+    // Locks accounts against balance changes by other processes until the
+    // lock is destroyed, and reloads the balances their slots hold
+    AccountStore::Lock lockAccounts(const std::vector<int>& accountNumbers);
     
     // Account creation methods
-    std::unique_ptr<Account> createSavingsAccount(int customerId, double initialBalance);
-    std::unique_ptr<Account> createCurrentAccount(int customerId, double initialBalance);
-    std::unique_ptr<Account> createAuditableSavingsAccount(int customerId, double initialBalance);
+    std::unique_ptr<Account> createSavingsAccount(int customerId, Money initialBalance);
+    std::unique_ptr<Account> createCurrentAccount(int customerId, Money initialBalance);
+    std::unique_ptr<Account> createAuditableSavingsAccount(int customerId, Money initialBalance);
     
     // Transaction operations
     bool addTransaction(int accountNumber, std::unique_ptr<ITransaction> transaction);
+    enum class TransferResult { DONE, NO_ACCOUNT, INSUFFICIENT_FUNDS };
+    // Moves amount from one account to another as a single change: both
+    // accounts stay locked (in account-number order, so opposite transfers
+    // cannot deadlock) while both legs are applied and journaled in one
+    // commit. If the commit fails the balances are put back and it throws.
+    TransferResult transfer(int fromAccount, int toAccount, Money amount);
+    // Non-null when deposits, withdrawals and transfers go through the sequencer
+    Sequencer* getSequencer() const { return sequencer.get(); }
+    // How deposits, withdrawals and transfers are applied (BANK_ENGINE)
+    enum class Engine { LOCKS, SEQUENCER, OPTIMISTIC };
+    Engine getEngine() const;
+    // Optimistic engine: applies the change with the accounts' compare-and-
+    // swap, retrying on conflict, then persists it like the other engines
+    Sequencer::Result changeOptimistically(Sequencer::Kind kind, int accountNumber, int toAccount, Money amount);
+    // fn(const Account*) without taking the account's lock; nullptr if absent
+    template <typename Fn>
+    auto readAccount(int accountNumber, Fn fn) const {
+        UnlockedAccess access(*this);
+        return fn(static_cast<const Account*>(findAccount(accountNumber)));
+    }
+    // fn(const Account&) for each open account of the customer, without
+    // taking the accounts' locks
+    template <typename Fn>
+    void forEachAccountOf(int customerId, Fn fn) const {
+        if (!findCustomer(customerId)) {
+            return;
+        }
+        // The shard lock guards the list, not the balances
+        customers.read(customerId, [&](const std::unique_ptr<Customer>* customer) {
+            if (!customer) {
+                return;
+            }
+            for (const auto& account : (*customer)->getAccounts()) {
+                if (!account->isClosed()) {
+                    fn(static_cast<const Account&>(*account));
+                }
+            }
+        });
+    }
     void getTransactions(int accountNumber, std::ostream& out = std::cout) const;
+    // Raw history lines, optionally limited to timestamps in [from, to]
+    std::vector<std::string> getTransactionHistory(int accountNumber, const std::string& from = "",
+                                                   const std::string& to = "") const;
+    Compactor::Stats compactTransactions(uint64_t bytesPerSecond = 0);
+    void startBackgroundCompaction(unsigned int intervalSeconds, uint64_t bytesPerSecond);
+    // Month-end batch: advances the interest period, which accrues a month
+    // of interest on every savings account without touching it, and applies
+    // the other open accounts' monthly updates (maintenance fees, audited
+    // interest) on the given number of threads (0: one per core). The new
+    // balances and period are journaled in one commit. Other processes may
+    // not change balances meanwhile. An account whose update throws keeps
+    // its balance and is listed with the reason.
+    struct MonthEndStats {
+        uint32_t period = 0;  // the interest period now current
+        size_t accounts = 0;  // open accounts visited: all but plain savings
+        size_t updated = 0;   // balances changed
+        std::vector<std::pair<int, std::string>> failures;  // account, reason
+        double seconds = 0;
+    };
+    MonthEndStats runMonthEnd(unsigned int threads);
     
     // Authentication
     bool authenticate(const std::string& username, const std::string& password, int& customerId) const;
-    bool changePassword(int customerId, const std::string& oldPassword, const std::string& newPassword);
+    bool changePassword(int customerId, const std::string& oldPassword, const std::string& newPassword,
+                        std::ostream& errors = std::cerr);
     bool usernameExists(const std::string& username) const;
     int getCustomerIdByUsername(const std::string& username) const;
     
     // Data persistence
-    void saveAll();
+    void saveAll();   // checkpoint: rewrite the snapshot files and truncate the journal
     void loadAll();
+    // Checkpoint in the binary or the text format from now on, removing the
+    // other format's files
+    void convertSnapshot(bool binary);
+    bool usesBinarySnapshot() const { return binarySnapshot; }
     
     // Static helper methods
     static bool verifyPassword(int accountNumber, const std::string& password);
@@ -90,6 +321,9 @@ public:
     static int getNextAccountNumber();
     static void incrementCustomerId();
     static void incrementAccountNumber();
+    // Hand out the next id, safely against other threads doing the same
+    static int takeCustomerId();
+    static int takeAccountNumber();
     
     ~Database();
 };
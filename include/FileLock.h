@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+// Advisory fcntl byte-range locks, which coordinate the separate `bank`
+// processes sharing a data directory.
+//
+// Open-file-description locks are used where available (Linux): they belong
+// to the descriptor, so closing some other descriptor of the same file does
+// not drop them as it does classic POSIX locks. A length of 0 covers the
+// range from offset to any future end of the file. On Windows these do
+// nothing.
+class FileLock {
+public:
+    // Block until the range is locked; throw if the lock cannot be taken
+    static void lockShared(int fd, uint64_t offset, uint64_t length);
+    static void lockExclusive(int fd, uint64_t offset, uint64_t length);
+    // Without waiting; false if another process holds a conflicting lock
+    static bool tryLockShared(int fd, uint64_t offset, uint64_t length);
+    static bool tryLockExclusive(int fd, uint64_t offset, uint64_t length);
+    static void unlock(int fd, uint64_t offset, uint64_t length);
+};
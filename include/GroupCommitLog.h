@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <functional>
+
+// Append-only file with group commit.
+//
+// append() queues its data and blocks until a background flusher has written
+// it and synced it to disk. Appends that arrive while a sync is in progress
+// are coalesced into the next write+fdatasync, so N concurrent writers cost
+// far fewer than N syncs. Batches are capped at maxBatchRecords; maxWait
+// optionally holds a batch open to gather more writers. Each batch goes to
+// the kernel as a single append-mode write, so batches from several
+// processes sharing the file never interleave.
+//
+// A file that some process may rename away (the active history segment)
+// needs Options::lockPath: batches are then written under a shared lock on
+// that file, to whichever file is at path by then, and exclusive() holds the
+// lock exclusively, so no process appends to a file after it was replaced.
+//
+// Tunable through the environment:
+//   BANK_GROUP_COMMIT_MAX_BATCH    records per batch (default 256)
+//   BANK_GROUP_COMMIT_MAX_WAIT_US  extra gathering delay in microseconds (default 0)
+//   BANK_FSYNC=0                   write without syncing (not crash-safe)
+class GroupCommitLog {
+public:
+    struct Options {
+        size_t maxBatchRecords = 256;
+        std::chrono::microseconds maxWait{0};
+        bool sync = true;
+        std::string lockPath;  // empty if the file is never replaced
+    };
+
+    static Options optionsFromEnvironment();
+
+    explicit GroupCommitLog(const std::string& path, Options options = optionsFromEnvironment());
+    ~GroupCommitLog();
+
+    GroupCommitLog(const GroupCommitLog&) = delete;
+    GroupCommitLog& operator=(const GroupCommitLog&) = delete;
+
+    // Appends data and returns once it is durable, giving the file offset
+    // the data starts at; throws if the write failed
+    uint64_t append(const std::string& data);
+
+    // Waits for in-flight batches, then empties the file
+    void truncate();
+
+    // Waits for in-flight batches and closes the file, e.g. before it is
+    // replaced by a rename; the next append reopens it
+    void close();
+
+    // Waits for in-flight batches, closes the file and runs fn while appends
+    // are held back, in other processes too if lockPath is set, e.g. to swap
+    // in a rewritten file
+    void exclusive(const std::function<void()>& fn);
+
+    // Durability helpers for files written outside a log
+    static void syncFile(const std::string& path);
+    static void syncDirectory(const std::string& path);
+
+    uint64_t getBatchCount() const;
+    uint64_t getRecordCount() const;
+    const std::string& getPath() const { return path; }
+
+private:
+    struct Waiter {
+        bool done = false;
+        uint64_t offset = 0;
+        std::string error;
+    };
+    struct Entry {
+        std::string data;
+        Waiter* waiter;
+    };
+
+    std::string path;
+    Options options;
+    int fd;  // append-mode descriptor, -1 until the first write
+    int lockFd;
+
+    mutable std::mutex mutex;
+    std::condition_variable pendingChanged;
+    std::condition_variable batchDone;
+    std::vector<Entry> pending;
+    bool flushing;
+    bool stopping;
+    std::thread flusher;
+
+    uint64_t batches;
+    uint64_t records;
+
+    void flusherLoop();
+    void writeBatch(const std::vector<Entry>& batch, uint64_t& offset, std::string& error);
+    void writeLocked(const std::vector<Entry>& batch, uint64_t& offset, std::string& error, bool mayBeReplaced);
+    void waitIdle(std::unique_lock<std::mutex>& lock);
+    void closeFile();
+    int lockDescriptor();
+    bool replaced() const;
+};
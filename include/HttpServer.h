@@ -0,0 +1,114 @@
+#pragma once
+
+#include "BankApp.h"
+#include "WorkStealingPool.h"
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::map<std::string, std::string> query;
+    std::map<std::string, std::string> headers;  // lower-case header names
+    std::string body;
+    std::map<std::string, std::string> json;     // fields of a flat JSON body
+    bool keepAlive = true;
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string body;
+};
+
+// Native HTTP/1.1 front end for the REST API served by api/server.js.
+//
+// A single-threaded, non-blocking epoll loop accepts connections and parses
+// pipelined keep-alive requests; the BankApp API calls themselves run on a
+// work-stealing pool (BANK_WORKERS threads), so no process is spawned per
+// request and a slow statement does not stall the loop. Workers hand their
+// responses back through an eventfd. Each connection has at most one request
+// in flight, which keeps pipelined responses in order. With BANK_WORKERS=0
+// the loop calls the API itself. BANK_HTTP_LOG=1 logs each request.
+class HttpServer {
+private:
+    struct Connection {
+        int fd;
+        uint64_t serial = 0;  // tells a reused fd from the connection that had it
+        std::string input;
+        std::string output;
+        bool closeAfterWrite = false;
+        bool peerClosed = false;    // no more input, but buffered requests are still answered
+        bool busy = false;          // a request is being handled by the pool
+        unsigned int interest = 0;  // epoll events currently registered
+    };
+
+    // A response finished by a worker, waiting for the event loop
+    struct Completion {
+        int fd;
+        uint64_t serial;
+        HttpResponse response;
+        bool keepAlive;
+        std::string method;
+        std::string target;
+        std::chrono::steady_clock::time_point started;
+    };
+
+    BankApp* app;
+    int port;
+    int listenFd;
+    int epollFd;
+    int completionFd;
+    uint64_t nextSerial;
+    bool logRequests;
+    std::unordered_map<int, Connection> connections;
+    std::unique_ptr<WorkStealingPool> pool;
+
+    std::mutex completionMutex;
+    std::vector<Completion> completions;
+
+    // Event loop
+    bool openListener();
+    void acceptConnections();
+    bool handleReadable(Connection& conn);
+    bool handleWritable(Connection& conn);
+    void processInput(Connection& conn);
+    void dispatch(Connection& conn, HttpRequest request, const std::string& target,
+                  std::chrono::steady_clock::time_point started);
+    void finishRequest(Connection& conn, const HttpResponse& response, bool keepAlive,
+                       const std::string& method, const std::string& target,
+                       std::chrono::steady_clock::time_point started);
+    void deliverCompletions();
+    void updateInterest(Connection& conn);
+    void closeConnection(int fd);
+
+    // Routing
+    HttpResponse route(const HttpRequest& request);
+    HttpResponse handleLogin(const HttpRequest& request);
+    HttpResponse handleRegister(const HttpRequest& request);
+    HttpResponse handleGetAccounts(const HttpRequest& request);
+    HttpResponse handleCreateAccount(const HttpRequest& request);
+    HttpResponse handleDeposit(const HttpRequest& request);
+    HttpResponse handleWithdraw(const HttpRequest& request);
+    HttpResponse handleTransfer(const HttpRequest& request);
+    HttpResponse handleGetTransactions(const HttpRequest& request, const std::string& accountNumber);
+    HttpResponse handleGetAccount(const std::string& accountNumber);
+    HttpResponse handleCloseAccount(const HttpRequest& request, const std::string& accountNumber);
+    HttpResponse handleGetProfile(const HttpRequest& request);
+    HttpResponse handleUpdateProfile(const HttpRequest& request);
+    HttpResponse handleChangePassword(const HttpRequest& request);
+    HttpResponse handleGetWorkers();
+    HttpResponse handleGetEngine();
+
+public:
+    HttpServer(BankApp* app, int port);
+    ~HttpServer();
+
+    // Runs the event loop until SIGINT/SIGTERM; returns the exit code
+    int run();
+};
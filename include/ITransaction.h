@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "Money.h"
 
 enum class TransactionType {
     DEPOSIT,
@@ -14,7 +15,7 @@ public:
     virtual bool execute() = 0;
     virtual bool undo() = 0;
     virtual std::string getDescription() const = 0;
-    virtual double getAmount() const = 0;
+    virtual Money getAmount() const = 0;
     virtual std::string getTimestamp() const = 0;
     virtual TransactionType getType() const = 0;
 }; 
\ No newline at end of file
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "GroupCommitLog.h"
+
+// Append-only write-ahead journal of Database mutations.
+//
+// Records are colon-delimited text lines, buffered by append() and written
+// with a trailing COMMIT marker by commit(). Recovery only returns records
+// from groups that reached their COMMIT marker, so a multi-record change
+// (e.g. both balances of a transfer) is replayed all-or-nothing and a torn
+// tail from a crash is ignored. Commits go through a GroupCommitLog, so a
+// committed group is on disk before commit() returns.
+//
+// The journal also tracks how much of the file this process has applied (and
+// a hash of those bytes), so a shared database image can say which prefix
+// of the journal it already includes.
+//
+// Several processes may append to one journal. Commits hold a shared fcntl
+// lock on it and checkpoints an exclusive one (CheckpointLock), so no
+// commit lands between a checkpoint's last read and its truncation. An
+// unfinished group at the end is only cut off under the exclusive lock, so
+// another process's group still being written is not mistaken for a torn one.
+class Journal {
+private:
+    std::string path;
+    GroupCommitLog log;
+    std::string pending;
+    size_t pendingRecords;
+    size_t committedRecords;
+    // Leading bytes of the file whose records this process has applied;
+    // stops advancing once another process's groups land in between
+    uint64_t applied;
+    uint64_t appliedDigest;
+    int lockFd;  // the journal opened only to hold locks
+    int checkpointLocks;  // CheckpointLocks held; they nest
+
+    int lockDescriptor();
+    // Reads the groups starting at from; false if an unfinished one follows
+    bool readGroups(uint64_t from, std::vector<std::string>& records, std::string& committedText);
+    void truncateTo(uint64_t size);
+
+public:
+    explicit Journal(const std::string& path);
+    ~Journal();
+
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Keeps other processes from committing until destroyed; may be nested
+    class CheckpointLock {
+    public:
+        explicit CheckpointLock(Journal& journal);
+        ~CheckpointLock();
+
+        CheckpointLock(const CheckpointLock&) = delete;
+        CheckpointLock& operator=(const CheckpointLock&) = delete;
+
+    private:
+        Journal& journal;
+    };
+
+    void append(const std::string& record);
+    void commit();
+    void rollback();
+
+    // Records of all complete groups, in order; also resets the record count.
+    // With from > 0, only groups starting at that offset are read, the
+    // first from bytes being known to hash to prefixHash.
+    std::vector<std::string> readCommitted(uint64_t from = 0, uint64_t prefixHash = EMPTY_HASH);
+
+    // Truncate the journal once its contents are in a checkpoint
+    void reset();
+
+    size_t getRecordCount() const { return committedRecords; }
+    bool hasPending() const { return pendingRecords > 0; }
+    const std::string& getPath() const { return path; }
+
+    uint64_t appliedBytes() const { return applied; }
+    uint64_t appliedHash() const { return appliedDigest; }
+    // False once another process has checkpointed (truncated) the journal
+    // since this one read it
+    bool startsWithApplied() const { return fileStartsWith(path, applied, appliedDigest); }
+
+    // FNV-1a, extended a piece at a time
+    static constexpr uint64_t EMPTY_HASH = 14695981039346656037ull;
+    static uint64_t extendHash(uint64_t hash, std::string_view bytes);
+    // Whether the first bytes of a journal file hash to hash
+    static bool fileStartsWith(const std::string& path, uint64_t bytes, uint64_t hash);
+};
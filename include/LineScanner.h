@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Finds record and field delimiters in bulk text, for scans over the whole
+// transaction history (index rebuilds, closure scans, compaction).
+//
+// Searches compare 16 (SSE2) or 32 (AVX2) bytes per step. The widest path
+// the CPU supports is picked once at startup; BANK_SCAN=scalar|sse2|avx2
+// forces one (a path the CPU lacks falls back to the next narrower one).
+// Other architectures always use the scalar loop.
+class LineScanner {
+public:
+    enum class Path {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
+
+    // First c in [begin, end), or end
+    static const char* find(const char* begin, const char* end, char c);
+
+    // Offsets of every c in data[0, length), in order; positions must have
+    // room for length entries. Returns how many were found.
+    static size_t findAll(const char* data, size_t length, char c, uint32_t* positions);
+
+    // Calls onLine(line, offset) for each newline-terminated line in text,
+    // without its newline; offset is where the line starts in text. Returns
+    // the bytes consumed, i.e. up to and including the last newline; a
+    // trailing partial line is left for the caller.
+    template <typename OnLine>
+    static size_t forEachLine(std::string_view text, OnLine onLine) {
+        // Newlines are located a window at a time, then handed out
+        constexpr size_t WINDOW = 4096;
+        uint32_t newlines[WINDOW];
+        size_t lineStart = 0;
+        for (size_t window = 0; window < text.size(); window += WINDOW) {
+            size_t length = text.size() - window < WINDOW ? text.size() - window : WINDOW;
+            size_t count = findAll(text.data() + window, length, '\n', newlines);
+            for (size_t i = 0; i < count; i++) {
+                size_t newline = window + newlines[i];
+                onLine(text.substr(lineStart, newline - lineStart), lineStart);
+                lineStart = newline + 1;
+            }
+        }
+        return lineStart;
+    }
+
+    // Reads a file from `from` in large blocks and calls onLine(line, offset)
+    // for each complete line that starts before `to`, offset being its
+    // position in the file. A last line without its newline (still being
+    // written) is not reported. Returns the offset after the last line
+    // reported, or from if the file cannot be opened.
+    static uint64_t scanFile(const std::string& path, uint64_t from, uint64_t to,
+                             const std::function<void(std::string_view, uint64_t)>& onLine);
+
+    // The path in use, and the widest one this CPU supports
+    static Path activePath();
+    static Path bestPath();
+    static const char* pathName(Path path);
+
+    // Switches paths, e.g. to compare them; clamped to bestPath()
+    static void usePath(Path path);
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+// An amount of money as a whole number of cents (minor units), so balances
+// and amounts add, subtract and compare exactly.
+//
+// The text form is a plain decimal with two places ("1250.00", "-0.05"),
+// written and read without going through floating point. parse() also
+// reads what older versions persisted (doubles such as "997.16666666666663"
+// or "1e+06"), rounding to the nearest cent.
+class Money {
+public:
+    static constexpr int64_t MINOR_PER_MAJOR = 100;
+    // Room format() needs: a sign, 19 digits, the point and a terminator
+    static constexpr size_t MAX_TEXT = 24;
+
+    constexpr Money() : minor(0) {}
+    static constexpr Money fromMinor(int64_t minor) { return Money(minor); }
+    // The nearest cent, halves away from zero; throws std::out_of_range
+    // for values no amount can hold
+    static Money fromDouble(double value);
+
+    constexpr int64_t toMinor() const { return minor; }
+    double toDouble() const { return static_cast<double>(minor) / MINOR_PER_MAJOR; }
+
+    // This amount scaled by factor (an interest rate, say), rounded to the
+    // nearest cent like fromDouble()
+    Money times(double factor) const;
+
+    // Writes the text form to buffer, which must hold MAX_TEXT characters,
+    // and returns its end; no terminator is written
+    char* format(char* buffer) const;
+    std::string toString() const;
+
+    // The amount at the start of text; like the RecordTokenizer parsers it
+    // skips leading whitespace, ignores what follows the number, and throws
+    // std::invalid_argument or std::out_of_range
+    static Money parse(std::string_view text);
+
+    constexpr Money operator-() const { return Money(-minor); }
+    constexpr Money operator+(Money other) const { return Money(minor + other.minor); }
+    constexpr Money operator-(Money other) const { return Money(minor - other.minor); }
+    Money& operator+=(Money other) {
+        minor += other.minor;
+        return *this;
+    }
+    Money& operator-=(Money other) {
+        minor -= other.minor;
+        return *this;
+    }
+
+    constexpr bool operator==(Money other) const { return minor == other.minor; }
+    constexpr bool operator!=(Money other) const { return minor != other.minor; }
+    constexpr bool operator<(Money other) const { return minor < other.minor; }
+    constexpr bool operator<=(Money other) const { return minor <= other.minor; }
+    constexpr bool operator>(Money other) const { return minor > other.minor; }
+    constexpr bool operator>=(Money other) const { return minor >= other.minor; }
+
+private:
+    int64_t minor;
+
+    explicit constexpr Money(int64_t minor) : minor(minor) {}
+};
+
+// The text form, padded to the stream's width
+std::ostream& operator<<(std::ostream& out, Money amount);
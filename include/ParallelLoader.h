@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Runs startup parsing on several threads.
+//
+// Files are read whole and split into chunks that each end on a newline,
+// so every chunk can be parsed on its own; run() hands the chunks to a pool
+// of worker threads. Callers keep one result per chunk and merge them in
+// chunk order afterwards, which keeps the outcome identical to a
+// sequential load.
+//
+// Tunable through the environment:
+//   BANK_LOAD_THREADS  worker threads (default: hardware concurrency)
+class ParallelLoader {
+public:
+    static unsigned int threadsFromEnvironment();
+
+    explicit ParallelLoader(unsigned int threads = threadsFromEnvironment());
+
+    unsigned int getThreadCount() const { return threads; }
+
+    // Calls task(i) for every i in [0, count), spread over the pool, and
+    // returns when all are done; rethrows the first exception a task threw
+    void run(size_t count, const std::function<void(size_t)>& task) const;
+
+    // Number of chunks worth splitting a given amount of work into
+    size_t chunkCount(size_t bytes, size_t minChunkBytes = 256 * 1024) const;
+
+    // Reads a whole file; false if it does not exist
+    static bool readFile(const std::string& path, std::string& contents);
+
+    // Splits text into at most `pieces` chunks, each ending after a newline
+    // (or at the end of the text)
+    static std::vector<std::string_view> splitLines(std::string_view text, size_t pieces);
+
+private:
+    unsigned int threads;
+};
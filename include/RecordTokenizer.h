@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+// Splits one delimited record (a line of customers.txt, auth.txt, a journal
+// record, a history line...) into fields without allocating.
+//
+// Fields are views into the caller's buffer and stay valid only as long as
+// it does. next() behaves like std::getline(ss, field, delimiter): it
+// returns the text up to the next delimiter, and an empty field once the
+// record is used up. rest() returns everything left, delimiters included,
+// like a final std::getline(ss, field).
+//
+// The number parsers use std::from_chars. Like std::stoi/std::stoull they
+// read a leading number and ignore what follows it (padding, '\r'), and
+// throw std::invalid_argument or std::out_of_range.
+class RecordTokenizer {
+public:
+    explicit RecordTokenizer(std::string_view record, char delimiter = ':')
+        : remaining(record), delimiter(delimiter), exhausted(false) {}
+
+    std::string_view next() {
+        if (exhausted) {
+            return std::string_view();
+        }
+        size_t end = remaining.find(delimiter);
+        std::string_view field = remaining.substr(0, end);
+        if (end == std::string_view::npos) {
+            remaining = std::string_view();
+            exhausted = true;
+        } else {
+            remaining.remove_prefix(end + 1);
+        }
+        return field;
+    }
+
+    std::string_view rest() {
+        std::string_view field = exhausted ? std::string_view() : remaining;
+        remaining = std::string_view();
+        exhausted = true;
+        return field;
+    }
+
+    // Whether next() would still return a field (possibly an empty one)
+    bool hasMore() const { return !exhausted; }
+
+    static int toInt(std::string_view field);
+    static uint64_t toUnsigned(std::string_view field);
+
+private:
+    std::string_view remaining;
+    char delimiter;
+    bool exhausted;
+};
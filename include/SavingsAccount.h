@@ -10,15 +10,21 @@ protected:
 public:
     static double getDefaultInterestRate() { return DEFAULT_INTEREST_RATE; }
     
-    SavingsAccount(int accNo, double initialBalance, Customer* owner,
+    SavingsAccount(int accNo, Money initialBalance, Customer* owner,
                   double interestRate = DEFAULT_INTEREST_RATE,
                   AccountType type = AccountType::SAVINGS);
     
-    bool deposit(double amount) override;
-    bool withdraw(double amount) override;
+    bool deposit(Money amount) override;
+    bool withdraw(Money amount) override;
+    // Does nothing for plain savings accounts, which accrue lazily
     void applyMonthlyUpdate() override;
-    double calculateInterest() const override;
+    Money calculateInterest() const override;
     
     double getInterestRate() const { return interestRate; }
     void setInterestRate(double newRate) { interestRate = newRate; }
+
+protected:
+    // Plain savings accounts apply the month-ends they have not seen yet
+    // when the balance is next read or changed
+    Money accrue(Money storedBalance, uint32_t periods) const override;
 }; 
\ No newline at end of file
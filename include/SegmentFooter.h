@@ -0,0 +1,47 @@
+#pragma once
+
+#include "BloomFilter.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// Summary written as the last line of a sealed transaction history segment:
+//
+//   #SEGMENT:<lines>:<min timestamp>:<max timestamp>:<closed accounts>:<bloom>
+//
+// Lookups use the timestamp range and the Bloom filter of account numbers to
+// skip segments without reading them; the closed-account list lets
+// compaction find tombstones without scanning.
+struct SegmentFooter {
+    static constexpr const char* MARKER = "#SEGMENT";
+
+    uint64_t lines = 0;
+    std::string minTimestamp;
+    std::string maxTimestamp;
+    std::vector<int> closedAccounts;
+    BloomFilter accounts;
+
+    // Building: include every history line, then seal() to size the filter
+    void include(std::string_view line);
+    void seal();
+
+    bool overlaps(const std::string& from, const std::string& to) const;
+    bool closes(int accountNumber) const;
+
+    std::string toLine() const;
+    static bool parse(const std::string& line, SegmentFooter& footer);
+
+    static bool isFooter(std::string_view line);
+
+private:
+    std::unordered_set<int> included;
+};
+
+// Timestamp (second field) of a history line, or "" if it has none
+std::string_view historyTimestamp(std::string_view line);
+
+// Whether a timestamp lies in [from, to]; empty bounds are open and "to" may
+// be a prefix such as a date
+bool timestampInRange(std::string_view timestamp, const std::string& from, const std::string& to);
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "Money.h"
+#include "RingBuffer.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Single-writer engine for balance changes (BANK_ENGINE=sequencer), modelled
+// on the LMAX disruptor. Instead of each API thread locking the accounts it
+// changes, threads publish commands into a lock-free ring buffer and wait on
+// a future; one sequencer thread takes them off in order, hands them in
+// batches to a processor that applies and persists the whole batch at once,
+// and then completes their futures.
+//
+// The sequencer thread yields while the buffer is briefly empty and then
+// sleeps until a producer wakes it, so an idle process does not spin.
+class Sequencer {
+public:
+    enum class Kind { DEPOSIT, WITHDRAWAL, TRANSFER };
+    // REJECTED: the account refused the change (insufficient funds or an
+    // invalid amount)
+    enum class Result { DONE, NO_ACCOUNT, REJECTED };
+
+    struct Command {
+        Kind kind;
+        int account;    // the source account of a transfer
+        int toAccount;  // transfers only
+        Money amount;
+        Result result;  // set by the processor
+        std::promise<Result> done;
+    };
+
+    // Applies a batch in order, setting each command's result; throws if
+    // the batch could not be persisted, which fails every command in it
+    typedef std::function<void(const std::vector<Command*>&)> Processor;
+
+    static constexpr size_t CAPACITY = 4096;   // commands waiting in the buffer
+    static constexpr size_t MAX_BATCH = 256;   // commands applied per batch
+
+    explicit Sequencer(Processor processor);
+    ~Sequencer();  // applies the commands already published first
+
+    Sequencer(const Sequencer&) = delete;
+    Sequencer& operator=(const Sequencer&) = delete;
+
+    static bool enabledFromEnvironment();
+
+    // Publishes a command and waits until its batch is durable; rethrows
+    // the batch's error
+    Result submit(Kind kind, int account, int toAccount, Money amount);
+
+    uint64_t getBatchCount() const { return batches.load(); }
+    uint64_t getCommandCount() const { return commands.load(); }
+
+private:
+    Processor processor;
+    RingBuffer<Command*> ring;
+
+    // Lets the sequencer thread sleep while there is nothing to do
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> stopping;
+
+    std::atomic<uint64_t> batches;
+    std::atomic<uint64_t> commands;
+
+    std::thread thread;  // last, so it starts once the rest is set up
+
+    void run();
+    void wake();
+};
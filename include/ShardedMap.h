@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+// Hash map split into shards that are locked independently, so threads
+// working on different keys rarely wait for each other. Each shard is an
+// unordered_map behind its own std::shared_mutex: lookups take it shared,
+// inserts, updates and removals exclusively.
+//
+// Integer keys are sharded by value, so consecutive account numbers and
+// customer ids land in different shards. Entries never move once inserted,
+// so a pointer or reference taken from one stays valid until it is erased.
+template <typename Key, typename Value, size_t SHARDS = 64>
+class ShardedMap {
+public:
+    // Copies the value out; false if absent
+    bool get(const Key& key, Value& value) const {
+        const Shard& shard = shardFor(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        if (it == shard.map.end()) {
+            return false;
+        }
+        value = it->second;
+        return true;
+    }
+
+    bool contains(const Key& key) const {
+        const Shard& shard = shardFor(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.count(key) != 0;
+    }
+
+    // fn(const Value*) under the shared lock; nullptr if absent
+    template <typename Fn>
+    auto read(const Key& key, Fn fn) const {
+        const Shard& shard = shardFor(key);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto it = shard.map.find(key);
+        return fn(it != shard.map.end() ? &it->second : nullptr);
+    }
+
+    // fn(Value&) under the exclusive lock, inserting Value() first if absent
+    template <typename Fn>
+    auto update(const Key& key, Fn fn) {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return fn(shard.map[key]);
+    }
+
+    void set(const Key& key, Value value) {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        shard.map[key] = std::move(value);
+    }
+
+    // False, leaving the map alone, if key is already present
+    bool insert(const Key& key, Value value) {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.emplace(key, std::move(value)).second;
+    }
+
+    bool erase(const Key& key) {
+        Shard& shard = shardFor(key);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.erase(key) != 0;
+    }
+
+    // fn(const Key&, const Value&) for every entry, one shard at a time
+    // under its shared lock; entries added meanwhile may be missed
+    template <typename Fn>
+    void forEach(Fn fn) const {
+        for (const Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            for (const auto& entry : shard.map) {
+                fn(entry.first, entry.second);
+            }
+        }
+    }
+
+    size_t size() const {
+        size_t total = 0;
+        for (const Shard& shard : shards) {
+            std::shared_lock<std::shared_mutex> lock(shard.mutex);
+            total += shard.map.size();
+        }
+        return total;
+    }
+
+    // Room for count entries spread evenly over the shards
+    void reserve(size_t count) {
+        for (Shard& shard : shards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.map.reserve(shard.map.size() + count / SHARDS + 1);
+        }
+    }
+
+    void clear() {
+        for (Shard& shard : shards) {
+            std::unique_lock<std::shared_mutex> lock(shard.mutex);
+            shard.map.clear();
+        }
+    }
+
+private:
+    // A cache line each, so neighbouring shards' locks do not contend
+    struct alignas(64) Shard {
+        mutable std::shared_mutex mutex;
+        std::unordered_map<Key, Value> map;
+    };
+
+    Shard shards[SHARDS];
+
+    Shard& shardFor(const Key& key) {
+        return shards[std::hash<Key>{}(key) % SHARDS];
+    }
+    const Shard& shardFor(const Key& key) const {
+        return shards[std::hash<Key>{}(key) % SHARDS];
+    }
+};
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Database image shared between the processes using one data directory, so a
+// short-lived `bank <command>` attaches to tables another process already
+// loaded instead of reading the data files (enabled with BANK_SHM=1).
+//
+// Two POSIX shared-memory objects per data directory:
+//   /bank-<key>          control block: a robust process-shared mutex, the
+//                        generation of the current image and what it was
+//                        built from (stamps of the snapshot files, the
+//                        identity of accounts.dat, the journal prefix it
+//                        includes)
+//   /bank-<key>.<gen>    the image: a sorted Snapshot, which holds offsets
+//                        rather than pointers and so can be mapped anywhere
+//
+// Images are immutable. Publishing writes a new generation and swaps it in
+// under the mutex; processes still reading an older one keep their mapping.
+// Balances are not in the image but in accounts.dat, which processes using
+// the image keep current. An image is only used while the files it was
+// built from are unchanged, and journal records past its prefix are
+// replayed by whoever attaches. Not available on Windows.
+class SharedImage {
+public:
+    struct FileStamp {
+        uint32_t exists;
+        uint32_t reserved;
+        uint64_t device;
+        uint64_t inode;
+        uint64_t size;
+        int64_t modifiedSeconds;
+        int64_t modifiedNanoseconds;
+    };
+
+    static constexpr size_t MAX_FILES = 8;
+
+    // What an image (or a process's tables) was built from
+    struct Sources {
+        uint32_t fileCount;
+        uint32_t reserved;
+        FileStamp files[MAX_FILES];  // must be unchanged
+        FileStamp accountStore;      // must be the same file; its slots change
+        uint64_t journalBytes;       // journal prefix already included
+        uint64_t journalHash;        // Journal::extendHash of that prefix
+    };
+
+    explicit SharedImage(const std::string& dataDir);
+    ~SharedImage();
+
+    SharedImage(const SharedImage&) = delete;
+    SharedImage& operator=(const SharedImage&) = delete;
+
+    static bool enabledFromEnvironment();
+
+    // Stamps files as they are now; journal fields are left empty
+    static Sources stampFiles(const std::vector<std::string>& files, const std::string& accountStore);
+    static FileStamp stamp(const std::string& path);
+
+    // Maps the current image if it was built from the given files and the
+    // journal still begins with the prefix it includes. On success data and
+    // size describe the image, which stays mapped until this object is
+    // destroyed, and sources receives what it was built from.
+    bool attach(const std::string& journalPath, Sources& sources, const char*& data, size_t& size);
+
+    // Makes image (Snapshot bytes built from sources) the current
+    // generation; false if shared memory is unavailable
+    bool publish(const Sources& sources, const std::string& image);
+
+    // Records that the current image also covers a longer journal prefix,
+    // provided it is still the generation this process attached to or
+    // published
+    bool extend(uint64_t journalBytes, uint64_t journalHash);
+
+    bool isAvailable() const { return control != nullptr; }
+    uint64_t generation() const { return knownGeneration; }
+
+private:
+    struct Control;
+
+    std::string name;                // of the control block
+    Control* control;
+    uint64_t knownGeneration;        // last attached or published
+    std::vector<std::pair<void*, size_t>> mappings;  // attached images
+
+    std::string imageName(uint64_t generation) const;
+    void openControl();
+};
@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Versioned binary snapshot of customers, accounts, credentials and counters,
+// an alternative to the colon-delimited text files.
+//
+// Layout, in native byte order:
+//   Header          magic, version, byte-order mark, counters, table locations
+//   customers       CustomerRecord[], by id
+//   accounts        AccountRecord[] (version 1 only; accounts now live in
+//                   accounts.dat)
+//   users           UserRecord[] by username: customer id, password
+//   accountAuth     AccountAuthRecord[] by account number: password
+//   strings         heap the records point into with StringRef
+//   accountLists    AccountList[], one per customer, in customer order
+//   accountNumbers  int32_t[] the lists point into
+//
+// Records are fixed-width, so a mapped snapshot is read in place: opening
+// checks the header and table bounds, and nothing is parsed per record.
+// From version 2 the tables are sorted by key, so a single record can be
+// found by binary search without loading the rest.
+class Snapshot {
+public:
+    static constexpr char MAGIC[8] = {'B', 'A', 'N', 'K', 'S', 'N', 'A', 'P'};
+    static constexpr uint32_t VERSION = 2;
+    static constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct StringRef {
+        uint32_t offset;  // into the string heap
+        uint32_t length;
+    };
+
+    struct CustomerRecord {
+        int32_t id;
+        uint32_t reserved;
+        StringRef name;
+        StringRef phone;
+    };
+
+    struct AccountRecord {
+        int32_t number;
+        int32_t ownerId;
+        double balance;
+        int32_t type;     // AccountType
+        uint32_t reserved;
+    };
+
+    struct UserRecord {
+        int32_t customerId;
+        uint32_t reserved;
+        StringRef username;
+        StringRef password;
+    };
+
+    struct AccountAuthRecord {
+        int32_t accountNumber;
+        uint32_t reserved;
+        StringRef password;
+    };
+
+    struct AccountList {
+        uint32_t offset;  // into accountNumbers
+        uint32_t count;
+    };
+
+    struct Table {
+        uint64_t offset;  // from the start of the file
+        uint64_t count;   // records, or bytes for the string heap
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t byteOrder;
+        int32_t nextCustomerId;
+        int32_t nextAccountNumber;
+        Table customers;
+        Table accounts;
+        Table users;
+        Table accountAuth;
+        Table strings;
+        // Version 2
+        Table accountLists;
+        Table accountNumbers;
+    };
+
+    static constexpr size_t V1_HEADER_SIZE = 104;
+
+    // Collects records in any order and writes a sorted snapshot file
+    class Writer {
+    private:
+        std::vector<CustomerRecord> customers;
+        std::vector<AccountList> accountLists;
+        std::vector<int32_t> accountNumbers;
+        std::vector<UserRecord> users;
+        std::vector<AccountAuthRecord> accountAuth;
+        std::string strings;
+        int32_t nextCustomerId = 0;
+        int32_t nextAccountNumber = 0;
+
+        StringRef addString(std::string_view text);
+        std::string_view text(StringRef ref) const { return std::string_view(strings).substr(ref.offset, ref.length); }
+
+    public:
+        void addCustomer(int id, std::string_view name, std::string_view phone, const std::vector<int>& accounts);
+        void addUser(std::string_view username, int customerId, std::string_view password);
+        void addAccountPassword(int accountNumber, std::string_view password);
+        void setCounters(int nextCustomerId, int nextAccountNumber);
+
+        // The sorted snapshot, as it would be written to a file
+        std::string serialize();
+
+        // Throws if the file cannot be written
+        void write(const std::string& path);
+    };
+
+    Snapshot() = default;
+    ~Snapshot();
+
+    Snapshot(const Snapshot&) = delete;
+    Snapshot& operator=(const Snapshot&) = delete;
+
+    // Maps a snapshot file; false if it does not exist, throws if it is
+    // not a valid snapshot
+    bool open(const std::string& path);
+    // Reads a snapshot the caller keeps in memory (e.g. shared memory) for
+    // as long as this one is open; throws if it is not a valid snapshot
+    void openImage(const char* bytes, size_t length, const std::string& name);
+    void close();
+
+    bool isOpen() const { return data != nullptr; }
+    uint32_t version() const { return info.version; }
+    // Whether records can be looked up by key (version 2 and later)
+    bool isSorted() const { return info.version >= 2; }
+
+    int nextCustomerId() const { return info.nextCustomerId; }
+    int nextAccountNumber() const { return info.nextAccountNumber; }
+
+    size_t customerCount() const { return info.customers.count; }
+    size_t accountCount() const { return info.accounts.count; }
+    size_t userCount() const { return info.users.count; }
+    size_t accountAuthCount() const { return info.accountAuth.count; }
+
+    const CustomerRecord& customer(size_t i) const { return table<CustomerRecord>(info.customers)[i]; }
+    const AccountRecord& account(size_t i) const { return table<AccountRecord>(info.accounts)[i]; }
+    const UserRecord& user(size_t i) const { return table<UserRecord>(info.users)[i]; }
+    const AccountAuthRecord& accountAuth(size_t i) const { return table<AccountAuthRecord>(info.accountAuth)[i]; }
+
+    // Account numbers owned by the i-th customer; empty before version 2
+    std::vector<int> customerAccounts(size_t i) const;
+
+    // Binary searches over sorted snapshots; false if absent
+    bool findCustomer(int id, size_t& index) const;
+    bool findUser(std::string_view username, size_t& index) const;
+    bool findAccountAuth(int accountNumber, size_t& index) const;
+
+    // Points into the mapping; throws if the reference is out of bounds
+    std::string_view text(StringRef ref) const;
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    void* mapping = nullptr;    // mmap'd region, if any
+    std::vector<char> buffer;   // file contents where mmap is unavailable
+    Header info{};              // copy of the header; version 2 tables empty for version 1
+
+    template <typename Record>
+    const Record* table(const Table& where) const {
+        return reinterpret_cast<const Record*>(data + where.offset);
+    }
+
+    void readHeader(const std::string& path);
+};
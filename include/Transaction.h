@@ -3,11 +3,23 @@
 #include <string>
 #include <memory>
 #include <chrono>
+#include <ctime>
 #include <iomanip>
 #include <sstream>
 #include "ITransaction.h"
 #include "Account.h"  // Include full Account definition
 
+// std::localtime returns a shared buffer; this is safe across threads
+inline std::tm localTime(std::time_t time) {
+    std::tm result{};
+#ifdef _WIN32
+    localtime_s(&result, &time);
+#else
+    localtime_r(&time, &result);
+#endif
+    return result;
+}
+
 // Function declaration
 void transactionFun(int accountNumber);
 void printAccountStatement(int accountNumber);
@@ -16,16 +28,16 @@ void closeAccount(int accountNumber);
 class Deposit : public ITransaction {
 private:
     Account* account;
-    double amount;
+    Money amount;
     std::string timestamp;
     TransactionType type;
 
 public:
-    Deposit(Account* account, double amount);
+    Deposit(Account* account, Money amount);
     bool execute() override;
     bool undo() override;
     std::string getDescription() const override { return "Deposit"; }
-    double getAmount() const override { return amount; }
+    Money getAmount() const override { return amount; }
     std::string getTimestamp() const override { return timestamp; }
     TransactionType getType() const override { return TransactionType::DEPOSIT; }
 };
@@ -33,16 +45,16 @@ public:
 class Withdrawal : public ITransaction {
 private:
     Account* account;
-    double amount;
+    Money amount;
     std::string timestamp;
     TransactionType type;
 
 public:
-    Withdrawal(Account* account, double amount);
+    Withdrawal(Account* account, Money amount);
     bool execute() override;
     bool undo() override;
     std::string getDescription() const override { return "Withdrawal"; }
-    double getAmount() const override { return amount; }
+    Money getAmount() const override { return amount; }
     std::string getTimestamp() const override { return timestamp; }
     TransactionType getType() const override { return TransactionType::WITHDRAWAL; }
 };
@@ -51,16 +63,16 @@ class Transfer : public ITransaction {
 private:
     Account* fromAccount;
     Account* toAccount;
-    double amount;
+    Money amount;
     std::string timestamp;
     TransactionType type;
 
 public:
-    Transfer(Account* from, Account* to, double amount);
+    Transfer(Account* from, Account* to, Money amount);
     bool execute() override;
     bool undo() override;
     std::string getDescription() const override { return "Transfer"; }
-    double getAmount() const override { return amount; }
+    Money getAmount() const override { return amount; }
     std::string getTimestamp() const override { return timestamp; }
     TransactionType getType() const override { return TransactionType::TRANSFER; }
     int getFromAccount() const { return fromAccount->getAccountNumber(); }
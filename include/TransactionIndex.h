@@ -0,0 +1,133 @@
+#pragma once
+
+#include "SegmentFooter.h"
+#include "GroupCommitLog.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+// Account number -> locations of that account's lines in the transaction
+// history.
+//
+// The history is a sequence of segments. New lines go to the active segment,
+// transactions.txt; once it reaches a size or age bound it is sealed: a
+// SegmentFooter line is appended and it is renamed to transactions.NNNNNN.txt.
+// Sealed segments never change except through compaction. Processes sharing
+// the history notice segments sealed by others when the next segment file
+// appears, and then reload the active segment too.
+//
+// Each segment has an index of "account:offset:length" lines next to it. The
+// active segment's index is append-only and loaded on the first lookup.
+// Entries are expected to tile the file; a gap (e.g. a crash between the
+// history append and the index append) or a history that grew behind our
+// back is filled by scanning just the missing byte range, and an entry that
+// does not match the history triggers a rebuild. A sealed segment's index is
+// only loaded when its footer says the segment may hold the account and
+// overlaps the requested dates.
+//
+// Closing an account appends an "account:timestamp:CLOSED" tombstone rather
+// than rewriting the history; lookups return nothing before the last
+// tombstone of an account.
+class TransactionIndex {
+private:
+    struct Location {
+        uint64_t offset;
+        uint64_t length;  // including the newline
+    };
+    typedef std::unordered_map<int, std::vector<Location>> LocationMap;
+
+    struct Segment {
+        unsigned int id;
+        SegmentFooter footer;
+        LocationMap locations;
+        bool indexLoaded = false;
+    };
+
+    std::string historyPath;
+    std::string indexPath;
+
+    // Sealed segments, oldest first; read on the first lookup
+    std::vector<Segment> sealed;
+    bool segmentsLoaded;
+
+    // Active segment
+    LocationMap locations;
+    uint64_t indexedEnd;  // active bytes covered by the index
+    bool loaded;
+    std::ofstream indexFile;
+
+    // Rotation
+    uint64_t segmentBytes;
+    unsigned int segmentSeconds;
+    uint64_t activeEnd;       // active segment size as of the last append
+    std::time_t activeStart;  // time of its first line, 0 if unknown
+
+    mutable std::mutex mutex;
+    std::mutex sealMutex;  // one seal at a time
+
+    // Active segment
+    void load();
+    void rebuild();
+    void refreshActive();
+    void scanHistory(uint64_t from, uint64_t to);
+    void add(int accountNumber, uint64_t offset, uint64_t length);
+    void appendEntry(int accountNumber, uint64_t offset, uint64_t length);
+    void rewriteIndexFile();
+
+    // Sealed segments
+    void loadSegments();
+    bool refreshSegments();
+    void loadSegmentIndex(Segment& segment);
+    Segment* findSegment(unsigned int id);
+    unsigned int nextSegmentId() const;
+    bool sealDue() const;
+
+    static uint64_t scanFile(const std::string& path, uint64_t from, uint64_t to,
+                             LocationMap& into, SegmentFooter* footer);
+    static bool readLines(const std::string& path, const std::vector<Location>& where, int accountNumber,
+                          const std::string& from, const std::string& to, std::vector<std::string>& into);
+    static void writeIndexFile(const std::string& path, const LocationMap& entries);
+    static uint64_t fileSize(const std::string& path);
+
+public:
+    static constexpr const char* CLOSED_TYPE = "CLOSED";
+    static constexpr uint64_t DEFAULT_SEGMENT_BYTES = 16 << 20;
+
+    // Account number at the start of a history line, or -1
+    static int accountOf(std::string_view line);
+
+    // Whether a history line is a closure tombstone
+    static bool isClosure(std::string_view line);
+
+    // Rotation bounds come from BANK_SEGMENT_BYTES and BANK_SEGMENT_SECONDS
+    TransactionIndex(const std::string& historyPath, const std::string& indexPath);
+
+    // Record lines just appended to the history, in file order
+    void record(int accountNumber, uint64_t offset, uint64_t length);
+
+    // History lines of one account since its last closure, oldest first,
+    // optionally limited to timestamps in [from, to]
+    std::vector<std::string> lines(int accountNumber, const std::string& from = "", const std::string& to = "");
+
+    // Whether the active segment has reached its size or age bound
+    bool needsSeal();
+
+    // Seal the active segment; appends are held back while it is renamed
+    void seal(GroupCommitLog& log);
+
+    // Compaction support
+    std::vector<unsigned int> segmentIds();
+    std::unordered_set<int> closedAccounts();
+    bool activeHasAny(const std::unordered_set<int>& accounts);
+    bool segmentHasReclaimable(unsigned int id, const std::unordered_set<int>& closed);
+    std::string segmentPath(unsigned int id) const;
+    std::string segmentIndexPath(unsigned int id) const;
+    // Atomically rename a compacted segment and its index into place
+    void replaceSegment(unsigned int id, const std::string& compactedPath, const std::string& compactedIndexPath);
+};
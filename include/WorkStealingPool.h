@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads that runs the servers' API calls.
+//
+// Every worker owns a deque of tasks. Tasks submitted from outside the pool
+// are spread over the deques round-robin; a worker takes the oldest task of
+// its own deque and, when that is empty, steals the newest task from another
+// worker's, so one slow task does not hold up the requests queued behind it.
+//
+// Tasks are either SHORT (balance checks, deposits, transfers, ...) or LONG
+// (statements). Workers always look for short work first, and at most
+// workers - 1 of them run long tasks at once, so a burst of statement
+// queries cannot occupy the whole pool while balance checks wait.
+class WorkStealingPool {
+public:
+    enum class Priority { SHORT, LONG };
+    typedef std::function<void()> Task;
+
+    struct WorkerStats {
+        size_t queued;      // tasks waiting in the worker's deque
+        uint64_t executed;  // tasks the worker ran
+        uint64_t stolen;    // of those, taken from another worker's deque
+    };
+
+    explicit WorkStealingPool(unsigned int workers);
+    ~WorkStealingPool();  // runs the tasks already submitted first
+
+    WorkStealingPool(const WorkStealingPool&) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+    // BANK_WORKERS, or one worker per core (at least two); 0 asks the
+    // caller not to use a pool at all
+    static unsigned int workersFromEnvironment();
+
+    // Tasks must not throw; an escaping exception is reported on std::cerr
+    void submit(Task task, Priority priority = Priority::SHORT);
+
+    unsigned int size() const { return static_cast<unsigned int>(workers.size()); }
+    unsigned int longTaskLimit() const { return maxLongRunning; }
+    std::vector<WorkerStats> stats() const;
+
+private:
+    struct Worker {
+        mutable std::mutex mutex;
+        std::deque<Task> shortTasks;
+        std::deque<Task> longTasks;
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+        std::thread thread;
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    unsigned int maxLongRunning;
+    std::atomic<unsigned int> nextWorker;
+    std::atomic<unsigned int> longRunning;
+
+    // Queued task counts, so idle workers can sleep until there is work
+    // they are allowed to run
+    std::atomic<size_t> pendingShort;
+    std::atomic<size_t> pendingLong;
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    std::atomic<bool> stopping;
+
+    bool hasRunnableWork() const;
+    bool drained() const;
+    bool takeFrom(size_t self, bool longTask, Task& task);
+    bool takeLong(size_t self, Task& task);
+    void run(size_t self);
+};
@@ -1,9 +1,19 @@
 #include "../include/Account.h"
 #include <stdexcept>
+#include <thread>
 
-Account::Account(int accNo, double initialBalance, Customer* owner, AccountType type)
-    : accountNumber(accNo), balance(initialBalance), owner(owner), type(type) {
-    if (initialBalance < 0) {
+namespace {
+
+std::atomic<uint64_t> changesMade(0);
+std::atomic<uint64_t> changeRetries(0);
+std::atomic<const volatile uint32_t*> periodSource(nullptr);
+
+} // namespace
+
+Account::Account(int accNo, Money initialBalance, Customer* owner, AccountType type)
+    : accountNumber(accNo), owner(owner), type(type), version(0), balance(initialBalance.toMinor()),
+      accruedPeriod(currentPeriod()) {
+    if (initialBalance < Money()) {
         throw std::invalid_argument("Initial balance cannot be negative");
     }
     if (!owner) {
@@ -11,11 +21,165 @@ Account::Account(int accNo, double initialBalance, Customer* owner, AccountType
     }
 }
 
-void Account::updateBalance(double newBalance) {
-    if (newBalance < 0) {
+Money Account::getBalance() const {
+    uint32_t period;
+    return getBalance(period);
+}
+
+Money Account::getBalance(uint32_t& period) const {
+    uint32_t now = currentPeriod();
+    while (true) {
+        uint64_t before = version.load(std::memory_order_acquire);
+        if ((before & 1) == 0) {
+            Money value = Money::fromMinor(balance.load(std::memory_order_relaxed));
+            uint32_t storedPeriod = accruedPeriod.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (version.load(std::memory_order_relaxed) == before) {
+                period = now;
+                return accrued(value, storedPeriod, period);
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+Money Account::accrued(Money stored, uint32_t storedPeriod, uint32_t& period) const {
+    if (storedPeriod >= period) {
+        period = storedPeriod;
+        return stored;
+    }
+    return accrue(stored, period - storedPeriod);
+}
+
+Money Account::accrue(Money storedBalance, uint32_t) const {
+    return storedBalance;
+}
+
+uint32_t Account::currentPeriod() {
+    // An aligned 32-bit load; the month-end that changes it runs with the
+    // account table to itself
+    const volatile uint32_t* source = periodSource.load(std::memory_order_acquire);
+    return source ? *source : 0;
+}
+
+void Account::setPeriodSource(const volatile uint32_t* source) {
+    periodSource.store(source, std::memory_order_release);
+}
+
+bool Account::claim(uint64_t seen) {
+    return version.compare_exchange_strong(seen, seen + 1, std::memory_order_acquire, std::memory_order_relaxed);
+}
+
+void Account::publish(uint64_t seen, Money newBalance, uint32_t period) {
+    balance.store(newBalance.toMinor(), std::memory_order_relaxed);
+    accruedPeriod.store(period, std::memory_order_relaxed);
+    version.store(seen + 2, std::memory_order_release);
+}
+
+bool Account::changeBalance(Money delta) {
+    changesMade.fetch_add(1, std::memory_order_relaxed);
+    uint32_t now = currentPeriod();
+    while (true) {
+        uint64_t seen = version.load(std::memory_order_acquire);
+        if (seen & CLOSED) {
+            return false;
+        }
+        if ((seen & 1) == 0) {
+            uint32_t period = now;
+            Money current = accrued(Money::fromMinor(balance.load(std::memory_order_relaxed)),
+                                    accruedPeriod.load(std::memory_order_relaxed), period);
+            Money updated = current + delta;
+            if (updated < Money()) {
+                // Only a refusal if nothing changed the balance meanwhile
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (version.load(std::memory_order_relaxed) == seen) {
+                    return false;
+                }
+            } else if (claim(seen)) {
+                // The claim succeeded, so current is still the balance
+                publish(seen, updated, period);
+                return true;
+            }
+        }
+        changeRetries.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+    }
+}
+
+void Account::updateBalance(Money newBalance, uint32_t period) {
+    if (newBalance < Money()) {
         throw std::runtime_error("Balance cannot be negative");
     }
-    balance = newBalance;
+    while (true) {
+        uint64_t seen = version.load(std::memory_order_acquire);
+        if ((seen & 1) == 0 && claim(seen)) {
+            publish(seen, newBalance, period);
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
+
+bool Account::transferBetween(Account& from, Account& to, Money amount) {
+    if (&from == &to) {
+        throw std::invalid_argument("Cannot transfer to the same account");
+    }
+    // Claimed in account-number order, and the first claim is given back
+    // when the second fails, so two opposite transfers cannot deadlock
+    Account& first = from.accountNumber < to.accountNumber ? from : to;
+    Account& second = &first == &from ? to : from;
+    changesMade.fetch_add(1, std::memory_order_relaxed);
+    uint32_t now = currentPeriod();
+    while (true) {
+        uint64_t firstSeen = first.version.load(std::memory_order_acquire);
+        uint64_t secondSeen = second.version.load(std::memory_order_acquire);
+        if ((firstSeen | secondSeen) & CLOSED) {
+            return false;
+        }
+        if (((firstSeen | secondSeen) & 1) == 0 && first.claim(firstSeen)) {
+            if (second.claim(secondSeen)) {
+                uint64_t fromSeen = &first == &from ? firstSeen : secondSeen;
+                uint64_t toSeen = &first == &from ? secondSeen : firstSeen;
+                uint32_t fromPeriod = now;
+                uint32_t toPeriod = now;
+                Money fromBalance = from.accrued(Money::fromMinor(from.balance.load(std::memory_order_relaxed)),
+                                                 from.accruedPeriod.load(std::memory_order_relaxed), fromPeriod);
+                bool funded = fromBalance >= amount;
+                Money toBalance = to.accrued(Money::fromMinor(to.balance.load(std::memory_order_relaxed)),
+                                             to.accruedPeriod.load(std::memory_order_relaxed), toPeriod);
+                from.publish(fromSeen, funded ? fromBalance - amount : fromBalance, fromPeriod);
+                to.publish(toSeen, funded ? toBalance + amount : toBalance, toPeriod);
+                return funded;
+            }
+            first.version.store(firstSeen, std::memory_order_release);
+        }
+        changeRetries.fetch_add(1, std::memory_order_relaxed);
+        std::this_thread::yield();
+    }
+}
+
+bool Account::close() {
+    while (true) {
+        uint64_t seen = version.load(std::memory_order_acquire);
+        if (seen & CLOSED) {
+            return true;
+        }
+        if ((seen & 1) == 0) {
+            if (balance.load(std::memory_order_relaxed) != 0) {
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (version.load(std::memory_order_relaxed) == seen) {
+                    return false;
+                }
+            } else if (version.compare_exchange_strong(seen, seen | CLOSED, std::memory_order_acq_rel)) {
+                return true;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+Account::ChangeStats Account::changeStats() {
+    return ChangeStats{changesMade.load(), changeRetries.load()};
 }
 
 // void Account::addTransaction(std::unique_ptr<ITransaction> transaction) {
@@ -0,0 +1,520 @@
+#include "../include/AccountStore.h"
+#include "../include/GroupCommitLog.h"
+#include "../include/FileLock.h"
+#include "../include/Money.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+static_assert(sizeof(AccountStore::Slot) == 32, "account slot layout changed");
+static_assert(sizeof(AccountStore::Header) == 32, "account table header layout changed");
+
+namespace {
+
+#ifdef _WIN32
+int openFile(const std::string& path, int flags) {
+    return _open(path.c_str(), flags | _O_BINARY, 0644);
+}
+
+bool writeFully(int fd, uint64_t offset, const char* data, size_t length) {
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+        return false;
+    }
+    return _write(fd, data, static_cast<unsigned int>(length)) == static_cast<int>(length);
+}
+
+bool readFully(int fd, uint64_t offset, char* data, size_t length) {
+    if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+        return false;
+    }
+    return _read(fd, data, static_cast<unsigned int>(length)) == static_cast<int>(length);
+}
+
+int syncDescriptor(int fd) {
+    return _commit(fd);
+}
+
+int closeFile(int fd) {
+    return _close(fd);
+}
+#else
+int openFile(const std::string& path, int flags) {
+    return ::open(path.c_str(), flags, 0644);
+}
+
+bool writeFully(int fd, uint64_t offset, const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t written = ::pwrite(fd, data, length, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        offset += static_cast<uint64_t>(written);
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool readFully(int fd, uint64_t offset, char* data, size_t length) {
+    while (length > 0) {
+        ssize_t got = ::pread(fd, data, length, static_cast<off_t>(offset));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        data += got;
+        offset += static_cast<uint64_t>(got);
+        length -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+int syncDescriptor(int fd) {
+#ifdef __APPLE__
+    return fsync(fd);
+#else
+    return fdatasync(fd);
+#endif
+}
+
+int closeFile(int fd) {
+    return ::close(fd);
+}
+#endif
+
+// Whether path no longer names the file open on fd, e.g. after a rename
+bool replacedOnDisk(int fd, const std::string& path) {
+#ifdef _WIN32
+    (void)fd;
+    (void)path;
+    return false;
+#else
+    struct stat opened;
+    struct stat current;
+    if (::fstat(fd, &opened) != 0 || ::stat(path.c_str(), &current) != 0) {
+        return true;
+    }
+    return opened.st_ino != current.st_ino || opened.st_dev != current.st_dev;
+#endif
+}
+
+AccountStore::Header makeHeader() {
+    AccountStore::Header header{};
+    std::memcpy(header.magic, AccountStore::MAGIC, sizeof(header.magic));
+    header.version = AccountStore::VERSION;
+    header.slotSize = static_cast<uint32_t>(AccountStore::SLOT_SIZE);
+    header.firstAccount = AccountStore::FIRST_ACCOUNT;
+    return header;
+}
+
+} // namespace
+
+AccountStore::AccountStore(const std::string& path)
+    : path(path), fd(-1), mappedHeader(nullptr), periodCopy(0), soleWriter(false), sharedWriter(false),
+      syncRequests(0), syncedThrough(0), syncing(false) {
+}
+
+AccountStore::~AccountStore() {
+#ifndef _WIN32
+    if (mappedHeader) {
+        munmap(mappedHeader, HEADER_SIZE);
+    }
+#endif
+    if (fd >= 0) {
+        closeFile(fd);
+    }
+}
+
+uint64_t AccountStore::offsetOf(int accountNumber) {
+    if (accountNumber < FIRST_ACCOUNT) {
+        throw std::out_of_range("Account number below the first slot: " + std::to_string(accountNumber));
+    }
+    return HEADER_SIZE + static_cast<uint64_t>(accountNumber - FIRST_ACCOUNT) * SLOT_SIZE;
+}
+
+bool AccountStore::open() {
+    int opened = openFile(path, O_RDWR);
+    if (opened < 0) {
+        if (errno == ENOENT) {
+            return false;
+        }
+        throw std::runtime_error("Failed to open " + path);
+    }
+
+    Header header;
+    Header expected = makeHeader();
+    if (!readFully(opened, 0, reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 ||
+        (header.version != expected.version && header.version != DOUBLE_BALANCE_VERSION) ||
+        header.slotSize != expected.slotSize ||
+        header.firstAccount != expected.firstAccount) {
+        closeFile(opened);
+        throw std::runtime_error("Not an account table: " + path);
+    }
+
+    if (fd >= 0) {
+        closeFile(fd);
+    }
+    fd = opened;
+    mapHeader(header);
+    {
+        // Locks belong to the old descriptor
+        std::lock_guard<std::mutex> lock(writerMutex);
+        soleWriter = false;
+        sharedWriter = false;
+    }
+    if (header.version == DOUBLE_BALANCE_VERSION) {
+        upgradeBalances();
+    }
+    return true;
+}
+
+void AccountStore::upgradeBalances() {
+    // Processes starting together all find the old table. The first to lock
+    // the writer byte upgrades it; the others then find it replaced and
+    // open the upgraded one. Either way open() closes the locked descriptor.
+    int locked = fd;
+    FileLock::lockExclusive(locked, WRITER_BYTE, 1);
+    try {
+        if (replacedOnDisk(locked, path)) {
+            open();
+            return;
+        }
+        // Free slots carry nothing worth keeping, so the open ones are enough
+        std::vector<Slot> slots = readAll();
+        for (Slot& slot : slots) {
+            double balance;
+            std::memcpy(&balance, &slot.balance, sizeof(balance));
+            slot.balance = Money::fromDouble(balance).toMinor();
+        }
+        create(slots);
+    } catch (...) {
+        if (fd == locked) {
+            FileLock::unlock(locked, WRITER_BYTE, 1);
+        }
+        throw;
+    }
+}
+
+void AccountStore::create(const std::vector<Slot>& slots) {
+    std::string tempPath = path + ".tmp";
+    int temp = openFile(tempPath, O_RDWR | O_CREAT | O_TRUNC);
+    if (temp < 0) {
+        throw std::runtime_error("Failed to create " + tempPath);
+    }
+
+    // Lay the whole table out in memory and write it in one go
+    uint64_t size = HEADER_SIZE;
+    for (const Slot& slot : slots) {
+        size = std::max(size, offsetOf(slot.number) + SLOT_SIZE);
+    }
+    std::vector<char> image(size, 0);
+    Header header = makeHeader();
+    header.interestPeriod = *interestPeriodSource();
+    std::memcpy(image.data(), &header, sizeof(header));
+    for (const Slot& slot : slots) {
+        std::memcpy(image.data() + offsetOf(slot.number), &slot, sizeof(slot));
+    }
+    bool ok = writeFully(temp, 0, image.data(), image.size());
+    if (GroupCommitLog::optionsFromEnvironment().sync) {
+        ok = ok && syncDescriptor(temp) == 0;
+    }
+    closeFile(temp);
+    if (!ok) {
+        std::remove(tempPath.c_str());
+        throw std::runtime_error("Failed to write " + tempPath);
+    }
+
+#ifdef _WIN32
+    if (fd >= 0) {
+        closeFile(fd);
+        fd = -1;
+    }
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to replace " + path);
+    }
+    open();
+}
+
+std::vector<AccountStore::Slot> AccountStore::readAll() const {
+    std::vector<Slot> slots;
+    if (fd < 0) {
+        return slots;
+    }
+
+    // Read in large chunks; a trailing partial slot is ignored
+    constexpr size_t CHUNK_SLOTS = 4096;
+    std::vector<Slot> chunk(CHUNK_SLOTS);
+    uint64_t offset = HEADER_SIZE;
+    while (true) {
+#ifdef _WIN32
+        if (_lseeki64(fd, static_cast<__int64>(offset), SEEK_SET) < 0) {
+            throw std::runtime_error("Failed to read " + path);
+        }
+        int got = _read(fd, chunk.data(), static_cast<unsigned int>(CHUNK_SLOTS * SLOT_SIZE));
+#else
+        ssize_t got = ::pread(fd, chunk.data(), CHUNK_SLOTS * SLOT_SIZE, static_cast<off_t>(offset));
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (got < 0) {
+            throw std::runtime_error("Failed to read " + path);
+        }
+        size_t count = static_cast<size_t>(got) / SLOT_SIZE;
+        for (size_t i = 0; i < count; i++) {
+            if (chunk[i].state == OPEN) {
+                slots.push_back(chunk[i]);
+            }
+        }
+        if (count < CHUNK_SLOTS) {
+            break;
+        }
+        offset += count * SLOT_SIZE;
+    }
+    return slots;
+}
+
+bool AccountStore::read(int accountNumber, Slot& slot) const {
+    if (fd < 0 || accountNumber < FIRST_ACCOUNT) {
+        return false;
+    }
+    return readFully(fd, offsetOf(accountNumber), reinterpret_cast<char*>(&slot), sizeof(slot)) &&
+           slot.state == OPEN && slot.number == accountNumber;
+}
+
+void AccountStore::write(const Slot& slot) {
+    writeAt(offsetOf(slot.number), &slot, sizeof(slot));
+}
+
+void AccountStore::write(const std::vector<Slot>& slots, std::vector<Slot>* gaps) {
+    // Joined runs are bounded, so the buffer stays small
+    constexpr int32_t MAX_SPAN = 4096;
+    int32_t maxGap = gaps ? MAX_GAP : 0;
+    std::vector<Slot> span;
+    size_t start = 0;
+    for (size_t i = 1; i <= slots.size(); i++) {
+        if (i < slots.size() && slots[i].number - slots[i - 1].number <= maxGap + 1 &&
+            slots[i].number - slots[start].number < MAX_SPAN) {
+            continue;
+        }
+        int32_t first = slots[start].number;
+        size_t length = static_cast<size_t>(slots[i - 1].number - first + 1);
+        if (length == i - start) {
+            writeAt(offsetOf(first), &slots[start], length * SLOT_SIZE);
+        } else {
+            span.resize(length);
+            if (fd < 0 || !readFully(fd, offsetOf(first), reinterpret_cast<char*>(span.data()), length * SLOT_SIZE)) {
+                throw std::runtime_error("Failed to read " + path);
+            }
+            size_t next = start;
+            for (size_t j = 0; j < length; j++) {
+                if (next < i && slots[next].number == first + static_cast<int32_t>(j)) {
+                    span[j] = slots[next++];
+                } else {
+                    gaps->push_back(span[j]);
+                }
+            }
+            writeAt(offsetOf(first), span.data(), length * SLOT_SIZE);
+        }
+        start = i;
+    }
+}
+
+void AccountStore::release(int accountNumber) {
+    Slot slot{};
+    slot.number = accountNumber;
+    slot.state = FREE;
+    writeAt(offsetOf(accountNumber), &slot, sizeof(slot));
+}
+
+void AccountStore::sync() {
+    if (fd < 0 || !GroupCommitLog::optionsFromEnvironment().sync) {
+        return;
+    }
+    if (syncDescriptor(fd) != 0) {
+        throw std::runtime_error("Failed to sync " + path);
+    }
+}
+
+void AccountStore::syncWrites() {
+    std::unique_lock<std::mutex> lock(syncMutex);
+    uint64_t request = ++syncRequests;
+    while (syncedThrough < request) {
+        if (syncing) {
+            syncDone.wait(lock);
+            continue;
+        }
+        // Covers every request so far, since their writes came before them
+        uint64_t covered = syncRequests;
+        syncing = true;
+        lock.unlock();
+        try {
+            sync();
+        } catch (...) {
+            // The waiters covered by it try again themselves
+            lock.lock();
+            syncing = false;
+            syncDone.notify_all();
+            throw;
+        }
+        lock.lock();
+        syncing = false;
+        syncedThrough = covered;
+        syncDone.notify_all();
+    }
+}
+
+void AccountStore::mapHeader(const Header& current) {
+    periodCopy = current.interestPeriod;
+#ifndef _WIN32
+    // Mapped over the previous mapping, if any, so pointers into it stay
+    // valid and see the new file
+    void* mapped = mmap(mappedHeader, HEADER_SIZE, PROT_READ, MAP_SHARED | (mappedHeader ? MAP_FIXED : 0), fd, 0);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Failed to map the header of " + path);
+    }
+    mappedHeader = mapped;
+#endif
+}
+
+const volatile uint32_t* AccountStore::interestPeriodSource() const {
+    if (mappedHeader) {
+        return &static_cast<const volatile Header*>(mappedHeader)->interestPeriod;
+    }
+    return &periodCopy;
+}
+
+void AccountStore::setInterestPeriod(uint32_t period) {
+    if (period > MAX_INTEREST_PERIOD) {
+        throw std::runtime_error("Interest period out of range: " + std::to_string(period));
+    }
+    writeAt(offsetof(Header, interestPeriod), &period, sizeof(period));
+    periodCopy = period;
+    sync();
+}
+
+void AccountStore::writeAt(uint64_t offset, const void* data, size_t length) {
+    if (fd < 0) {
+        throw std::runtime_error("Account table is not open: " + path);
+    }
+    if (!writeFully(fd, offset, static_cast<const char*>(data), length)) {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+bool AccountStore::claimSoleWriter() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (fd < 0) {
+        return false;
+    }
+    if (!soleWriter) {
+        // Upgrades this process's own shared lock, if it took one
+        soleWriter = FileLock::tryLockExclusive(fd, WRITER_BYTE, 1);
+        sharedWriter = sharedWriter && !soleWriter;
+    }
+    return soleWriter;
+}
+
+void AccountStore::releaseSoleWriter() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (fd < 0 || !soleWriter) {
+        return;
+    }
+    // Converted in place, so no other process can claim it in between
+    sharedWriter = FileLock::tryLockShared(fd, WRITER_BYTE, 1);
+    if (!sharedWriter) {
+        FileLock::unlock(fd, WRITER_BYTE, 1);
+    }
+    soleWriter = false;
+}
+
+void AccountStore::shareWriter() {
+    std::lock_guard<std::mutex> lock(writerMutex);
+    if (fd < 0 || soleWriter || sharedWriter) {
+        return;
+    }
+    if (!FileLock::tryLockShared(fd, WRITER_BYTE, 1)) {
+        throw std::runtime_error("Balances are being changed by another process running BANK_ENGINE=optimistic");
+    }
+    sharedWriter = true;
+}
+
+AccountStore::Lock::Lock(AccountStore& store, std::vector<int> accountNumbers)
+    : store(&store), fd(store.fd), accountNumbers(std::move(accountNumbers)) {
+    std::vector<int>& numbers = this->accountNumbers;
+    std::sort(numbers.begin(), numbers.end());
+    numbers.erase(std::unique(numbers.begin(), numbers.end()), numbers.end());
+    numbers.erase(std::remove_if(numbers.begin(), numbers.end(),
+                                 [](int number) { return number < FIRST_ACCOUNT; }),
+                  numbers.end());
+    if (!numbers.empty()) {
+        store.shareWriter();
+    }
+    for (int number : numbers) {
+        stripes.push_back(static_cast<size_t>(number) % LOCK_STRIPES);
+    }
+    std::sort(stripes.begin(), stripes.end());
+    stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+    for (size_t stripe : stripes) {
+        store.stripes[stripe].lock();
+    }
+    if (fd < 0) {
+        numbers.clear();
+    }
+    for (size_t i = 0; i < numbers.size(); i++) {
+        try {
+            FileLock::lockExclusive(fd, offsetOf(numbers[i]), SLOT_SIZE);
+        } catch (...) {
+            // The destructor does not run for a constructor that throws
+            numbers.resize(i);
+            release();
+            throw;
+        }
+    }
+}
+
+AccountStore::Lock::Lock(Lock&& other) noexcept
+    : store(other.store), fd(other.fd), accountNumbers(std::move(other.accountNumbers)),
+      stripes(std::move(other.stripes)) {
+    other.accountNumbers.clear();
+    other.stripes.clear();
+}
+
+AccountStore::Lock::~Lock() {
+    release();
+}
+
+void AccountStore::Lock::release() {
+    for (int number : accountNumbers) {
+        try {
+            FileLock::unlock(fd, offsetOf(number), SLOT_SIZE);
+        } catch (const std::exception&) {
+            // Released anyway when the file is closed
+        }
+    }
+    for (size_t stripe : stripes) {
+        store->stripes[stripe].unlock();
+    }
+    accountNumbers.clear();
+    stripes.clear();
+}
@@ -1,9 +1,10 @@
 #include "../include/AuditableSavingsAccount.h"
+#include "../include/Transaction.h"
 #include <chrono>
 #include <iomanip>
 #include <sstream>
 
-AuditableSavingsAccount::AuditableSavingsAccount(int accNo, double initialBalance, Customer* owner,
+AuditableSavingsAccount::AuditableSavingsAccount(int accNo, Money initialBalance, Customer* owner,
                                                double interestRate, const std::string& logFileName)
     : SavingsAccount(accNo, initialBalance, owner, interestRate, AccountType::AUDITABLE_SAVINGS)
     , Auditable(logFileName) {
@@ -14,62 +15,53 @@ AuditableSavingsAccount::AuditableSavingsAccount(int accNo, double initialBalanc
     entry.amount = initialBalance;
     entry.balance = initialBalance;
     auditLog.push_back(entry);
-    logAction("Account created with initial balance of $" + std::to_string(initialBalance));
+    logAction("Account created with initial balance of $" + initialBalance.toString());
 }
 
-bool AuditableSavingsAccount::deposit(double amount) {
+bool AuditableSavingsAccount::deposit(Money amount) {
     bool success = SavingsAccount::deposit(amount);
     if (success) {
-        // Log successful deposit
-        AuditEntry entry;
-        entry.timestamp = getCurrentTimestamp();
-        entry.action = "Deposit";
-        entry.amount = amount;
-        entry.balance = getBalance();
-        auditLog.push_back(entry);
-        logAction("Deposit of $" + std::to_string(amount) + " successful");
+        record("Deposit", amount, "Deposit of $" + amount.toString() + " successful");
     } else {
-        logAction("Deposit of $" + std::to_string(amount) + " failed");
+        std::lock_guard<std::mutex> lock(auditMutex);
+        logAction("Deposit of $" + amount.toString() + " failed");
     }
     return success;
 }
 
-bool AuditableSavingsAccount::withdraw(double amount) {
+bool AuditableSavingsAccount::withdraw(Money amount) {
     bool success = SavingsAccount::withdraw(amount);
     if (success) {
-        // Log successful withdrawal
-        AuditEntry entry;
-        entry.timestamp = getCurrentTimestamp();
-        entry.action = "Withdrawal";
-        entry.amount = amount;
-        entry.balance = getBalance();
-        auditLog.push_back(entry);
-        logAction("Withdrawal of $" + std::to_string(amount) + " successful");
+        record("Withdrawal", amount, "Withdrawal of $" + amount.toString() + " successful");
     } else {
-        logAction("Withdrawal of $" + std::to_string(amount) + " failed");
+        std::lock_guard<std::mutex> lock(auditMutex);
+        logAction("Withdrawal of $" + amount.toString() + " failed");
     }
     return success;
 }
 
 void AuditableSavingsAccount::applyMonthlyUpdate() {
-    double interest = calculateInterest();
+    Money interest = calculateInterest();
     SavingsAccount::applyMonthlyUpdate();
-    
-    // Log monthly update
+    record("Monthly Interest", interest, "Monthly interest of $" + interest.toString() + " applied");
+}
+
+void AuditableSavingsAccount::record(const std::string& action, Money amount, const std::string& message) {
     AuditEntry entry;
     entry.timestamp = getCurrentTimestamp();
-    entry.action = "Monthly Interest";
-    entry.amount = interest;
+    entry.action = action;
+    entry.amount = amount;
     entry.balance = getBalance();
+    std::lock_guard<std::mutex> lock(auditMutex);
     auditLog.push_back(entry);
-    
-    logAction("Monthly interest of $" + std::to_string(interest) + " applied");
+    logAction(message);
 }
 
 std::string AuditableSavingsAccount::getCurrentTimestamp() const {
     auto now = std::chrono::system_clock::now();
     auto time = std::chrono::system_clock::to_time_t(now);
+    std::tm local = localTime(time);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S");
+    ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
     return ss.str();
 } 
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "../include/SavingsAccount.h"
 #include "../include/CurrentAccount.h"
 #include "../include/AuditableSavingsAccount.h"
+#include "../include/RecordTokenizer.h"
 #include <iostream>
 #include <limits>
 #include <iomanip>
@@ -169,23 +170,23 @@ bool BankApp::isValidPhone(const std::string& phone) {
     return true;
 }
 
-bool BankApp::isValidUsername(const std::string& username) {
+bool BankApp::isValidUsername(const std::string& username, std::ostream& errors) {
     if (username.empty() || username.length() < 4) {
-        std::cout << "Invalid username! Username must be at least 4 characters." << std::endl;
+        errors << "Invalid username! Username must be at least 4 characters." << std::endl;
         return false;
     }
     
     // Username can contain letters, numbers, and underscores
     for (char c : username) {
         if (!std::isalnum(c) && c != '_') {
-            std::cout << "Invalid username! Username can only contain letters, numbers, and underscores." << std::endl;
+            errors << "Invalid username! Username can only contain letters, numbers, and underscores." << std::endl;
             return false;
         }
     }
 
     // Check if username already exists
     if (Database::getInstance()->usernameExists(username)) {
-        std::cout << "Username already exists. Please choose another one." << std::endl;
+        errors << "Username already exists. Please choose another one." << std::endl;
         return false;
     }
     
@@ -233,7 +234,7 @@ void BankApp::handleCustomerRegistration() {
     do {
         std::cout << "Choose a username (at least 4 characters, letters, numbers, and underscores only): ";
         std::getline(std::cin, username);
-    } while (!isValidUsername(username));
+    } while (!isValidUsername(username, std::cout));
     
     // Get and validate password
     do {
@@ -244,8 +245,7 @@ void BankApp::handleCustomerRegistration() {
         }
     } while (!isValidPassword(password));
 
-    int customerId = Database::getNextCustomerId();
-    Database::incrementCustomerId();
+    int customerId = Database::takeCustomerId();
     auto customerPtr = std::make_unique<Customer>(customerId, name, phone);
     if (Database::getInstance()->addCustomer(std::move(customerPtr), username, password)) {
         currentCustomer = Database::getInstance()->findCustomer(customerId);
@@ -323,8 +323,8 @@ void BankApp::handleAccountCreation() {
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
     std::cout << "Enter initial balance: $";
-    double initialBalance;
-    std::cin >> initialBalance;
+    std::string initialBalanceText;
+    std::cin >> initialBalanceText;
     std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
     std::cout << "Enter account password: ";
@@ -332,16 +332,17 @@ void BankApp::handleAccountCreation() {
     std::getline(std::cin, password);
 
     try {
+        Money initialBalance = Money::parse(initialBalanceText);
         std::unique_ptr<Account> account;
         switch (choice) {
             case 1:
-                account = Database::getInstance()->createSavingsAccount(currentCustomer->getId(), 0);
+                account = Database::getInstance()->createSavingsAccount(currentCustomer->getId(), Money());
                 break;
             case 2:
-                account = Database::getInstance()->createCurrentAccount(currentCustomer->getId(), 0);
+                account = Database::getInstance()->createCurrentAccount(currentCustomer->getId(), Money());
                 break;
             case 3:
-                account = Database::getInstance()->createAuditableSavingsAccount(currentCustomer->getId(), 0);
+                account = Database::getInstance()->createAuditableSavingsAccount(currentCustomer->getId(), Money());
                 break;
             default:
                 std::cout << "Invalid account type." << std::endl;
@@ -437,8 +438,7 @@ void BankApp::listAccounts() {
 bool BankApp::registerCustomer(const std::string& name, const std::string& phone, 
                               const std::string& username, const std::string& password) {
     try {
-        int customerId = Database::getNextCustomerId();
-        Database::incrementCustomerId();
+        int customerId = Database::takeCustomerId();
         auto customerPtr = std::make_unique<Customer>(customerId, name, phone);
         return Database::getInstance()->addCustomer(std::move(customerPtr), username, password);
     } catch (const std::exception& e) {
@@ -450,7 +450,7 @@ bool BankApp::authenticateCustomer(const std::string& username, const std::strin
     return Database::getInstance()->authenticate(username, password, customerId);
 }
 
-int BankApp::createAccount(const std::string& username, const std::string& password, const std::string& accountType, double initialBalance) {
+int BankApp::createAccount(const std::string& username, const std::string& password, const std::string& accountType, Money initialBalance) {
     try {
         // Find customer by username (no password authentication needed)
         int customerId = Database::getInstance()->getCustomerIdByUsername(username);
@@ -464,17 +464,16 @@ int BankApp::createAccount(const std::string& username, const std::string& passw
         }
         
         // Create account based on type with 0 initial balance
-        int accountNumber = Database::getNextAccountNumber();
-        Database::incrementAccountNumber();
+        int accountNumber = Database::takeAccountNumber();
         
         std::unique_ptr<Account> account;
         
         if (accountType == "savings") {
-            account = std::make_unique<SavingsAccount>(accountNumber, 0, customer);
+            account = std::make_unique<SavingsAccount>(accountNumber, Money(), customer);
         } else if (accountType == "current") {
-            account = std::make_unique<CurrentAccount>(accountNumber, 0, customer);
+            account = std::make_unique<CurrentAccount>(accountNumber, Money(), customer);
         } else if (accountType == "auditable") {
-            account = std::make_unique<AuditableSavingsAccount>(accountNumber, 0, customer);
+            account = std::make_unique<AuditableSavingsAccount>(accountNumber, Money(), customer);
         } else {
             return -1;
         }
@@ -482,13 +481,12 @@ int BankApp::createAccount(const std::string& username, const std::string& passw
         // First add the account to the database with 0 balance
         if (Database::getInstance()->addAccount(std::move(account), password)) {
             // Now get the account from the database and create the deposit transaction if there's an initial balance
-            if (initialBalance > 0) {
+            if (initialBalance > Money()) {
                 Account* dbAccount = Database::getInstance()->getAccount(accountNumber);
                 if (dbAccount) {
                     auto deposit = std::make_unique<Deposit>(dbAccount, initialBalance);
                     if (deposit->execute()) {
                         Database::getInstance()->addTransaction(accountNumber, std::move(deposit));
-                        Database::getInstance()->saveAll();
                     }
                 }
             }
@@ -500,17 +498,23 @@ int BankApp::createAccount(const std::string& username, const std::string& passw
     }
 }
 
-bool BankApp::deposit(int accountNumber, double amount, const std::string& password) {
+bool BankApp::deposit(int accountNumber, Money amount, const std::string& password, std::ostream& errors) {
     try {
+        if (Database::getInstance()->getEngine() != Database::Engine::LOCKS) {
+            return applyChange(Sequencer::Kind::DEPOSIT, accountNumber, 0, amount, password, errors);
+        }
+        // Held until the change is persisted, so no other thread or process
+        // loses it, and taken first so the account cannot be closed meanwhile
+        auto lock = Database::getInstance()->lockAccounts({accountNumber});
         Account* account = Database::getInstance()->getAccount(accountNumber);
         if (!account) {
-            std::cerr << "Account not found" << std::endl;
+            errors << "Account not found" << std::endl;
             return false;
         }
         
         // Verify account password
         if (!Database::getInstance()->verifyPassword(accountNumber, password)) {
-            std::cerr << "Incorrect password" << std::endl;
+            errors << "Incorrect password" << std::endl;
             return false;
         }
         
@@ -518,31 +522,32 @@ bool BankApp::deposit(int accountNumber, double amount, const std::string& passw
             // Create and save transaction record
             auto transaction = std::make_unique<Deposit>(account, amount);
             Database::getInstance()->addTransaction(accountNumber, std::move(transaction));
-            
-            // Save changes to database
-            Database::getInstance()->saveAll();
             return true;
         } else {
-            std::cerr << "Deposit operation failed" << std::endl;
+            errors << "Deposit operation failed" << std::endl;
             return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+        errors << "Error: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool BankApp::withdraw(int accountNumber, double amount, const std::string& password) {
+bool BankApp::withdraw(int accountNumber, Money amount, const std::string& password, std::ostream& errors) {
     try {
+        if (Database::getInstance()->getEngine() != Database::Engine::LOCKS) {
+            return applyChange(Sequencer::Kind::WITHDRAWAL, accountNumber, 0, amount, password, errors);
+        }
+        auto lock = Database::getInstance()->lockAccounts({accountNumber});
         Account* account = Database::getInstance()->getAccount(accountNumber);
         if (!account) {
-            std::cerr << "Account not found" << std::endl;
+            errors << "Account not found" << std::endl;
             return false;
         }
         
         // Verify account password
         if (!Database::getInstance()->verifyPassword(accountNumber, password)) {
-            std::cerr << "Incorrect password" << std::endl;
+            errors << "Incorrect password" << std::endl;
             return false;
         }
         
@@ -550,100 +555,129 @@ bool BankApp::withdraw(int accountNumber, double amount, const std::string& pass
             // Create and save transaction record
             auto transaction = std::make_unique<Withdrawal>(account, amount);
             Database::getInstance()->addTransaction(accountNumber, std::move(transaction));
-            
-            // Save changes to database
-            Database::getInstance()->saveAll();
             return true;
         } else {
-            std::cerr << "Insufficient funds" << std::endl;
+            errors << "Insufficient funds" << std::endl;
             return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+        errors << "Error: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool BankApp::transfer(int fromAccount, int toAccount, double amount, const std::string& password) {
+bool BankApp::transfer(int fromAccount, int toAccount, Money amount, const std::string& password,
+                       std::ostream& errors) {
     try {
         // Check if transferring to the same account
         if (fromAccount == toAccount) {
-            std::cerr << "Cannot transfer to the same account" << std::endl;
+            errors << "Cannot transfer to the same account" << std::endl;
             return false;
         }
         
-        Account* fromAcc = Database::getInstance()->getAccount(fromAccount);
-        Account* toAcc = Database::getInstance()->getAccount(toAccount);
-        
-        if (!fromAcc || !toAcc) {
-            std::cerr << "Account not found" << std::endl;
+        Database* db = Database::getInstance();
+        if (db->getEngine() != Database::Engine::LOCKS) {
+            return applyChange(Sequencer::Kind::TRANSFER, fromAccount, toAccount, amount, password, errors);
+        }
+        if (!db->getAccount(fromAccount) || !db->getAccount(toAccount)) {
+            errors << "Account not found" << std::endl;
             return false;
         }
         
         // Verify account password for the source account
-        if (!Database::getInstance()->verifyPassword(fromAccount, password)) {
-            std::cerr << "Incorrect password" << std::endl;
+        if (!db->verifyPassword(fromAccount, password)) {
+            errors << "Incorrect password" << std::endl;
             return false;
         }
         
-        // Perform transfer
-        if (fromAcc->withdraw(amount)) {
-            toAcc->deposit(amount);
-            
-            // Create and save transaction records for both accounts
-            auto fromTransaction = std::make_unique<Transfer>(fromAcc, toAcc, amount);
-            
-            Database::getInstance()->addTransaction(fromAccount, std::move(fromTransaction));
-            
-            // Save changes to database
-            Database::getInstance()->saveAll();
-            return true;
-        } else {
-            std::cerr << "Insufficient funds" << std::endl;
-            return false;
+        // Both legs and their records happen under both accounts' locks
+        switch (db->transfer(fromAccount, toAccount, amount)) {
+            case Database::TransferResult::DONE:
+                return true;
+            case Database::TransferResult::NO_ACCOUNT:
+                errors << "Account not found" << std::endl;
+                return false;
+            default:
+                errors << "Insufficient funds" << std::endl;
+                return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+        errors << "Error: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool BankApp::closeAccount(int accountNumber, const std::string& password) {
+bool BankApp::applyChange(Sequencer::Kind kind, int accountNumber, int toAccount, Money amount,
+                          const std::string& password, std::ostream& errors) {
+    // Checked again by the engine, which may find the account closed since
+    Database* db = Database::getInstance();
+    if (!db->getAccount(accountNumber) || (kind == Sequencer::Kind::TRANSFER && !db->getAccount(toAccount))) {
+        errors << "Account not found" << std::endl;
+        return false;
+    }
+    if (!db->verifyPassword(accountNumber, password)) {
+        errors << "Incorrect password" << std::endl;
+        return false;
+    }
+
+    Sequencer::Result result = db->getSequencer()
+                                   ? db->getSequencer()->submit(kind, accountNumber, toAccount, amount)
+                                   : db->changeOptimistically(kind, accountNumber, toAccount, amount);
+    switch (result) {
+        case Sequencer::Result::DONE:
+            return true;
+        case Sequencer::Result::NO_ACCOUNT:
+            errors << "Account not found" << std::endl;
+            return false;
+        default:
+            errors << (kind == Sequencer::Kind::DEPOSIT ? "Deposit operation failed" : "Insufficient funds")
+                      << std::endl;
+            return false;
+    }
+}
+
+bool BankApp::closeAccount(int accountNumber, const std::string& password, std::ostream& errors) {
     try {
+        auto lock = Database::getInstance()->lockAccounts({accountNumber});
         Account* account = Database::getInstance()->getAccount(accountNumber);
         if (!account) {
-            std::cerr << "Account not found" << std::endl;
+            errors << "Account not found" << std::endl;
             return false;
         }
         
         // Verify account password
         if (!Database::getInstance()->verifyPassword(accountNumber, password)) {
-            std::cerr << "Incorrect password" << std::endl;
+            errors << "Incorrect password" << std::endl;
             return false;
         }
         
-        double remainingBalance = account->getBalance();
-        if (remainingBalance > 0) {
+        // The optimistic engine changes balances without the lock, so a
+        // deposit may land after the withdrawal; withdraw again until the
+        // account can be closed empty, which refuses any further change
+        while (!account->close()) {
+            Money remainingBalance = account->getBalance();
+            if (remainingBalance <= Money()) {
+                continue;
+            }
             // Create and execute withdrawal for remaining balance
             auto withdrawal = std::make_unique<Withdrawal>(account, remainingBalance);
             if (withdrawal->execute()) {
                 Database::getInstance()->addTransaction(accountNumber, std::move(withdrawal));
-            } else {
-                std::cerr << "Failed to withdraw remaining balance" << std::endl;
+            } else if (account->getBalance() >= remainingBalance) {
+                errors << "Failed to withdraw remaining balance" << std::endl;
                 return false;
             }
         }
         
         // Close the account
         if (Database::getInstance()->removeAccount(accountNumber)) {
-            Database::getInstance()->saveAll();
             return true;
         } else {
-            std::cerr << "Failed to close account" << std::endl;
+            errors << "Failed to close account" << std::endl;
             return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+        errors << "Error: " << e.what() << std::endl;
         return false;
     }
 }
@@ -655,21 +689,18 @@ std::string BankApp::getAccounts(const std::string& username) {
             return "[]";
         }
         
-        Customer* customer = Database::getInstance()->findCustomer(customerId);
-        if (!customer) {
-            return "[]";
-        }
-        
+        // Balances are read without locking the accounts
         std::string result = "[";
-        const auto& accounts = customer->getAccounts();
-        for (size_t i = 0; i < accounts.size(); ++i) {
-            if (i > 0) result += ",";
+        bool first = true;
+        Database::getInstance()->forEachAccountOf(customerId, [&](const Account& account) {
+            if (!first) result += ",";
+            first = false;
             result += "{";
-            result += "\"accountNumber\":" + std::to_string(accounts[i]->getAccountNumber()) + ",";
-            result += "\"type\":\"" + accounts[i]->getTypeString() + "\",";
-            result += "\"balance\":" + std::to_string(accounts[i]->getBalance());
+            result += "\"accountNumber\":" + std::to_string(account.getAccountNumber()) + ",";
+            result += "\"type\":\"" + account.getTypeString() + "\",";
+            result += "\"balance\":" + account.getBalance().toString();
             result += "}";
-        }
+        });
         result += "]";
         return result;
     } catch (const std::exception& e) {
@@ -679,137 +710,112 @@ std::string BankApp::getAccounts(const std::string& username) {
 
 std::string BankApp::getAccountDetails(int accountNumber) {
     try {
-        Account* account = Database::getInstance()->getAccount(accountNumber);
-        if (!account) {
-            return "{}";
-        }
-        
-        std::string result = "{";
-        result += "\"accountNumber\":" + std::to_string(account->getAccountNumber()) + ",";
-        result += "\"type\":\"" + account->getTypeString() + "\",";
-        result += "\"balance\":" + std::to_string(account->getBalance()) + ",";
-        result += "\"owner\":\"" + account->getOwner()->getName() + "\"";
-        result += "}";
-        return result;
+        // The balance is read without locking the account
+        return Database::getInstance()->readAccount(accountNumber, [](const Account* account) {
+            if (!account) {
+                return std::string("{}");
+            }
+            std::string result = "{";
+            result += "\"accountNumber\":" + std::to_string(account->getAccountNumber()) + ",";
+            result += "\"type\":\"" + account->getTypeString() + "\",";
+            result += "\"balance\":" + account->getBalance().toString() + ",";
+            result += "\"owner\":\"" + account->getOwner()->getName() + "\"";
+            result += "}";
+            return result;
+        });
     } catch (const std::exception& e) {
         return "{}";
     }
 }
 
-std::string BankApp::getTransactions(int accountNumber) {
+std::string BankApp::getTransactions(int accountNumber, const std::string& from, const std::string& to,
+                                     std::ostream& errors) {
     try {
         Account* account = Database::getInstance()->getAccount(accountNumber);
         if (!account) {
-            std::cerr << "Account " << accountNumber << " not found" << std::endl;
+            errors << "Account " << accountNumber << " not found" << std::endl;
             return "[]";
         }
         
-        // Read transactions from the database file
+        // Only this account's lines are read, via the history index; with a
+        // date range the balance is the running total within the range
         std::string result = "[";
-        std::string transactionFilePath = "../data/transactions.txt";
-        std::ifstream file(transactionFilePath);
-        
-        std::cerr << "Opening transaction file: " << transactionFilePath << std::endl;
-        
-        if (file.is_open()) {
-            std::string line;
-            bool firstTransaction = true;
-            int lineCount = 0;
-            double runningBalance = 0.0; // Track running balance
-            
-            while (std::getline(file, line)) {
-                lineCount++;
-                std::cerr << "Reading line " << lineCount << ": " << line << std::endl;
-                
-                std::stringstream ss(line);
-                std::string accNumStr, timestamp, typeStr, amountStr, relatedAccountStr;
-                
-                // Parse using colons as separators
-                std::getline(ss, accNumStr, ':');
-                std::getline(ss, timestamp, ':');
-                std::getline(ss, typeStr, ':');
-                std::getline(ss, amountStr, ':');
-                std::getline(ss, relatedAccountStr); // This might be empty for deposits/withdrawals
-                
-                int accNum = std::stoi(accNumStr);
-                std::cerr << "Account number from line: " << accNum << ", looking for: " << accountNumber << std::endl;
-                
-                if (accNum != accountNumber) {
-                    std::cerr << "Skipping line - account mismatch" << std::endl;
-                    continue;
-                }
-                
-                std::cerr << "Parsed: timestamp='" << timestamp << "', type='" << typeStr << "', amount='" << amountStr << "', related='" << relatedAccountStr << "'" << std::endl;
-                
-                if (!timestamp.empty() && !typeStr.empty() && !amountStr.empty()) {
-                    if (!firstTransaction) {
-                        result += ",";
-                    }
-                    
-                    double amount = std::stod(amountStr);
-                    int typeInt = std::stoi(typeStr);
-                    
-                    // Update running balance based on transaction type
-                    if (typeInt == static_cast<int>(TransactionType::DEPOSIT) || 
-                        (typeInt == static_cast<int>(TransactionType::TRANSFER))) {
-                        runningBalance += amount;
-                    } else if (typeInt == static_cast<int>(TransactionType::WITHDRAWAL)) {
-                        runningBalance -= amount; // amount is already negative for withdrawals/transfer out
-                    }
-                    
-                    std::string typeName;
-                    std::string relatedAccount = "null";
-                    
-                    switch (typeInt) {
-                        case static_cast<int>(TransactionType::DEPOSIT):
-                            typeName = "Deposit";
-                            break;
-                        case static_cast<int>(TransactionType::WITHDRAWAL):
-                            typeName = "Withdrawal";
-                            break;
-                        case static_cast<int>(TransactionType::TRANSFER):
-                            // Determine if this is a transfer in or out based on amount
-                            if (amount > 0) {
-                                typeName = "Transfer In";
-                                if (!relatedAccountStr.empty()) {
-                                    relatedAccount = "\"From " + relatedAccountStr + "\"";
-                                }
-                            } else {
-                                typeName = "Transfer Out";
-                                if (!relatedAccountStr.empty()) {
-                                    relatedAccount = "\"To " + relatedAccountStr + "\"";
-                                }
-                            }
-                            break;
-                        default:
-                            typeName = "Unknown";
+        bool firstTransaction = true;
+        Money runningBalance; // Track running balance
+
+        for (const std::string& line : Database::getInstance()->getTransactionHistory(accountNumber, from, to)) {
+            // Parse using colons as separators
+            RecordTokenizer fields(line);
+            fields.next();  // account number
+            std::string_view timestamp = fields.next();
+            std::string_view typeStr = fields.next();
+            std::string_view amountStr = fields.next();
+            std::string_view relatedAccountStr = fields.rest(); // This might be empty for deposits/withdrawals
+
+            if (timestamp.empty() || typeStr.empty() || amountStr.empty()) {
+                continue;
+            }
+
+            if (!firstTransaction) {
+                result += ",";
+            }
+
+            Money amount = Money::parse(amountStr);
+            int typeInt = RecordTokenizer::toInt(typeStr);
+
+            // Update running balance based on transaction type
+            if (typeInt == static_cast<int>(TransactionType::DEPOSIT) || 
+                (typeInt == static_cast<int>(TransactionType::TRANSFER))) {
+                runningBalance += amount;
+            } else if (typeInt == static_cast<int>(TransactionType::WITHDRAWAL)) {
+                runningBalance -= amount; // amount is already negative for withdrawals/transfer out
+            }
+
+            std::string typeName;
+            std::string relatedAccount = "null";
+
+            switch (typeInt) {
+                case static_cast<int>(TransactionType::DEPOSIT):
+                    typeName = "Deposit";
+                    break;
+                case static_cast<int>(TransactionType::WITHDRAWAL):
+                    typeName = "Withdrawal";
+                    break;
+                case static_cast<int>(TransactionType::TRANSFER):
+                    // Determine if this is a transfer in or out based on amount
+                    if (amount > Money()) {
+                        typeName = "Transfer In";
+                        if (!relatedAccountStr.empty()) {
+                            relatedAccount = "\"From " + std::string(relatedAccountStr) + "\"";
+                        }
+                    } else {
+                        typeName = "Transfer Out";
+                        if (!relatedAccountStr.empty()) {
+                            relatedAccount = "\"To " + std::string(relatedAccountStr) + "\"";
+                        }
                     }
-                    
-                    result += "{";
-                    result += "\"timestamp\":\"" + timestamp + "\",";
-                    result += "\"type\":\"" + typeName + "\",";
-                    result += "\"amount\":" + std::to_string(amount) + ",";
-                    result += "\"relatedAccount\":" + relatedAccount + ",";
-                    result += "\"balance\":" + std::to_string(runningBalance);
-                    result += "}";
-                    
-                    std::cerr << "Added transaction to result with balance: " << runningBalance << std::endl;
-                    firstTransaction = false;
-                } else {
-                    std::cerr << "Skipping line - missing required fields" << std::endl;
-                }
+                    break;
+                default:
+                    typeName = "Unknown";
             }
-            
-            std::cerr << "Processed " << lineCount << " lines total" << std::endl;
-        } else {
-            std::cerr << "Failed to open transaction file" << std::endl;
+
+            result += "{";
+            result += "\"timestamp\":\"";
+            result += timestamp;
+            result += "\",";
+            result += "\"type\":\"" + typeName + "\",";
+            result += "\"amount\":" + amount.toString() + ",";
+            result += "\"relatedAccount\":" + relatedAccount + ",";
+            result += "\"balance\":" + runningBalance.toString();
+            result += "}";
+
+            firstTransaction = false;
         }
         
         result += "]";
-        std::cerr << "Final result: " << result << std::endl;
         return result;
     } catch (const std::exception& e) {
-        std::cerr << "Exception in getTransactions: " << e.what() << std::endl;
+        errors << "Exception in getTransactions: " << e.what() << std::endl;
         return "[]";
     }
 }
@@ -838,27 +844,28 @@ std::string BankApp::getUserDetails(const std::string& username) {
     }
 }
 
-bool BankApp::updateProfile(const std::string& username, const std::string& name, const std::string& phone) {
+bool BankApp::updateProfile(const std::string& username, const std::string& name, const std::string& phone,
+                            std::ostream& errors) {
     try {
         // Validate input
         if (!isValidName(name)) {
-            std::cerr << "Invalid name format" << std::endl;
+            errors << "Invalid name format" << std::endl;
             return false;
         }
         if (!isValidPhone(phone)) {
-            std::cerr << "Invalid phone number format" << std::endl;
+            errors << "Invalid phone number format" << std::endl;
             return false;
         }
         
         int customerId = Database::getInstance()->getCustomerIdByUsername(username);
         if (customerId == -1) {
-            std::cerr << "User not found" << std::endl;
+            errors << "User not found" << std::endl;
             return false;
         }
         
         Customer* customer = Database::getInstance()->findCustomer(customerId);
         if (!customer) {
-            std::cerr << "Customer not found" << std::endl;
+            errors << "Customer not found" << std::endl;
             return false;
         }
         
@@ -866,39 +873,132 @@ bool BankApp::updateProfile(const std::string& username, const std::string& name
         customer->setName(name);
         customer->setPhone(phone);
         
-        // Save changes to database
-        Database::getInstance()->saveAll();
+        // Record the change in the database journal
+        Database::getInstance()->updateCustomer(customer);
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Error updating profile: " << e.what() << std::endl;
+        errors << "Error updating profile: " << e.what() << std::endl;
         return false;
     }
 }
 
-bool BankApp::changePassword(const std::string& username, const std::string& currentPassword, const std::string& newPassword) {
+bool BankApp::changePassword(const std::string& username, const std::string& currentPassword, const std::string& newPassword,
+                             std::ostream& errors) {
     try {
         // Validate new password
         if (!isValidPassword(newPassword)) {
-            std::cerr << "Invalid new password format" << std::endl;
+            errors << "Invalid new password format" << std::endl;
             return false;
         }
         
         // Verify current password
         int customerId;
         if (!Database::getInstance()->authenticate(username, currentPassword, customerId)) {
-            std::cerr << "Current password is incorrect" << std::endl;
+            errors << "Current password is incorrect" << std::endl;
             return false;
         }
         
         // Change password in database
-        if (Database::getInstance()->changePassword(customerId, currentPassword, newPassword)) {
+        if (Database::getInstance()->changePassword(customerId, currentPassword, newPassword, errors)) {
             return true;
         } else {
-            std::cerr << "Failed to update password in database" << std::endl;
+            errors << "Failed to update password in database" << std::endl;
             return false;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error changing password: " << e.what() << std::endl;
+        errors << "Error changing password: " << e.what() << std::endl;
         return false;
     }
-} 
\ No newline at end of file
+} 
+std::string BankApp::compactTransactions(uint64_t bytesPerSecond, std::ostream& errors) {
+    try {
+        Compactor::Stats stats = Database::getInstance()->compactTransactions(bytesPerSecond);
+
+        std::stringstream json;
+        json << "{\"compacted\":" << (stats.compacted ? "true" : "false")
+             << ",\"segmentsRewritten\":" << stats.segmentsRewritten
+             << ",\"bytesBefore\":" << stats.bytesBefore
+             << ",\"bytesAfter\":" << stats.bytesAfter
+             << ",\"bytesReclaimed\":" << stats.bytesReclaimed()
+             << ",\"linesDropped\":" << stats.linesDropped
+             << ",\"accountsDropped\":" << stats.accountsDropped
+             << ",\"seconds\":" << std::fixed << std::setprecision(3) << stats.seconds << "}";
+        return json.str();
+    } catch (const std::exception& e) {
+        errors << "Error compacting transactions: " << e.what() << std::endl;
+        return "";
+    }
+}
+
+void BankApp::startBackgroundCompaction(unsigned int intervalSeconds, uint64_t bytesPerSecond) {
+    Database::getInstance()->startBackgroundCompaction(intervalSeconds, bytesPerSecond);
+}
+
+std::string BankApp::getEngineStats() {
+    Database* db = Database::getInstance();
+    const char* engine = "locks";
+    switch (db->getEngine()) {
+        case Database::Engine::SEQUENCER:
+            engine = "sequencer";
+            break;
+        case Database::Engine::OPTIMISTIC:
+            engine = "optimistic";
+            break;
+        default:
+            break;
+    }
+    Account::ChangeStats changes = Account::changeStats();
+    Sequencer* sequencer = db->getSequencer();
+
+    std::stringstream json;
+    json << "{\"engine\":\"" << engine << "\""
+         << ",\"balanceChanges\":" << changes.changes
+         << ",\"casRetries\":" << changes.retries
+         << ",\"retryRate\":" << std::fixed << std::setprecision(4)
+         << (changes.changes ? static_cast<double>(changes.retries) / changes.changes : 0.0)
+         << ",\"sequencerBatches\":" << (sequencer ? sequencer->getBatchCount() : 0)
+         << ",\"sequencerCommands\":" << (sequencer ? sequencer->getCommandCount() : 0) << "}";
+    return json.str();
+}
+
+std::string BankApp::runMonthEnd(unsigned int threads, std::ostream& errors) {
+    try {
+        Database::MonthEndStats stats = Database::getInstance()->runMonthEnd(threads);
+
+        std::stringstream json;
+        json << "{\"period\":" << stats.period
+             << ",\"accounts\":" << stats.accounts
+             << ",\"updated\":" << stats.updated
+             << ",\"failed\":" << stats.failures.size()
+             << ",\"seconds\":" << std::fixed << std::setprecision(3) << stats.seconds
+             << ",\"accountsPerSecond\":" << std::setprecision(0)
+             << (stats.seconds > 0 ? stats.accounts / stats.seconds : 0.0)
+             << ",\"failures\":[";
+        for (size_t i = 0; i < stats.failures.size(); i++) {
+            std::string reason;
+            for (char c : stats.failures[i].second) {
+                if (c == '"' || c == '\\') {
+                    reason += '\\';
+                }
+                reason += c;
+            }
+            json << (i ? "," : "") << "{\"account\":" << stats.failures[i].first
+                 << ",\"error\":\"" << reason << "\"}";
+        }
+        json << "]}";
+        return json.str();
+    } catch (const std::exception& e) {
+        errors << "Error running month-end: " << e.what() << std::endl;
+        return "";
+    }
+}
+
+bool BankApp::convertSnapshot(bool binary, std::ostream& errors) {
+    try {
+        Database::getInstance()->convertSnapshot(binary);
+        return true;
+    } catch (const std::exception& e) {
+        errors << "Error converting data: " << e.what() << std::endl;
+        return false;
+    }
+}
@@ -0,0 +1,90 @@
+#include "../include/BloomFilter.h"
+#include "../include/RecordTokenizer.h"
+#include <charconv>
+#include <cstdio>
+#include <sstream>
+
+namespace {
+
+uint64_t mix(uint64_t value) {
+    // splitmix64 finaliser
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+} // namespace
+
+BloomFilter::BloomFilter(size_t expectedAccounts) : hashes(7) {
+    // ~10 bits per account with 7 hashes gives about 1% false positives
+    size_t bits = expectedAccounts * 10;
+    if (bits < 256) {
+        bits = 256;
+    }
+    words.assign((bits + 63) / 64, 0);
+}
+
+void BloomFilter::add(int accountNumber) {
+    uint64_t hash = mix(static_cast<uint64_t>(static_cast<uint32_t>(accountNumber)));
+    uint64_t h1 = hash & 0xffffffffULL;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (unsigned int i = 0; i < hashes; i++) {
+        uint64_t bit = (h1 + i * h2) % bitCount();
+        words[bit / 64] |= 1ULL << (bit % 64);
+    }
+}
+
+bool BloomFilter::mayContain(int accountNumber) const {
+    uint64_t hash = mix(static_cast<uint64_t>(static_cast<uint32_t>(accountNumber)));
+    uint64_t h1 = hash & 0xffffffffULL;
+    uint64_t h2 = (hash >> 32) | 1;
+    for (unsigned int i = 0; i < hashes; i++) {
+        uint64_t bit = (h1 + i * h2) % bitCount();
+        if (!(words[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::string BloomFilter::serialize() const {
+    std::ostringstream out;
+    out << bitCount() << "/" << hashes << "/";
+    char hex[17];
+    for (uint64_t word : words) {
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(word));
+        out << hex;
+    }
+    return out.str();
+}
+
+bool BloomFilter::parse(std::string_view text, BloomFilter& filter) {
+    RecordTokenizer fields(text, '/');
+    std::string_view bitsField = fields.next();
+    std::string_view hashesField = fields.next();
+    std::string_view hex = fields.rest();
+    uint64_t bits = 0;
+    unsigned int hashCount = 0;
+    try {
+        bits = RecordTokenizer::toUnsigned(bitsField);
+        hashCount = static_cast<unsigned int>(RecordTokenizer::toInt(hashesField));
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (bits == 0 || bits % 64 != 0 || hashCount == 0 || hex.size() != bits / 4) {
+        return false;
+    }
+
+    std::vector<uint64_t> parsed(bits / 64);
+    for (size_t i = 0; i < parsed.size(); i++) {
+        const char* chunk = hex.data() + i * 16;
+        std::from_chars_result result = std::from_chars(chunk, chunk + 16, parsed[i], 16);
+        if (result.ec != std::errc() || result.ptr != chunk + 16) {
+            return false;
+        }
+    }
+    filter.words.swap(parsed);
+    filter.hashes = hashCount;
+    return true;
+}
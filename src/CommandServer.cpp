@@ -0,0 +1,190 @@
+#include "../include/CommandServer.h"
+#include "../include/Commands.h"
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+// Minimal streambuf over a connected socket so a connection can be served
+// with the same code as stdin/stdout
+class FdStreamBuf : public std::streambuf {
+private:
+    int fd;
+    char inBuffer[4096];
+    char outBuffer[4096];
+
+    bool flushOutput() {
+        const char* data = pbase();
+        std::ptrdiff_t remaining = pptr() - pbase();
+        while (remaining > 0) {
+            ssize_t written = ::write(fd, data, static_cast<size_t>(remaining));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            data += written;
+            remaining -= written;
+        }
+        setp(outBuffer, outBuffer + sizeof(outBuffer));
+        return true;
+    }
+
+protected:
+    int_type underflow() override {
+        ssize_t n;
+        do {
+            n = ::read(fd, inBuffer, sizeof(inBuffer));
+        } while (n < 0 && errno == EINTR);
+        if (n <= 0) {
+            return traits_type::eof();
+        }
+        setg(inBuffer, inBuffer, inBuffer + n);
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int_type overflow(int_type ch) override {
+        if (!flushOutput()) {
+            return traits_type::eof();
+        }
+        if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(ch);
+            pbump(1);
+        }
+        return traits_type::not_eof(ch);
+    }
+
+    int sync() override {
+        return flushOutput() ? 0 : -1;
+    }
+
+public:
+    explicit FdStreamBuf(int fd) : fd(fd) {
+        setg(inBuffer, inBuffer, inBuffer);
+        setp(outBuffer, outBuffer + sizeof(outBuffer));
+    }
+};
+#endif
+
+std::vector<std::string> splitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    std::string::size_type start = 0;
+    while (true) {
+        std::string::size_type tab = line.find('\t', start);
+        if (tab == std::string::npos) {
+            fields.push_back(line.substr(start));
+            break;
+        }
+        fields.push_back(line.substr(start, tab - start));
+        start = tab + 1;
+    }
+    return fields;
+}
+
+} // namespace
+
+CommandServer::CommandServer(BankApp* app) : app(app) {
+    if (!app) {
+        throw std::invalid_argument("BankApp cannot be null");
+    }
+}
+
+void CommandServer::handleRequest(const std::string& line, std::ostream& out) {
+    int exitCode;
+    std::ostringstream commandOut;
+    std::ostringstream commandErr;
+    try {
+        exitCode = runCommand(app, splitFields(line), commandOut, commandErr);
+    } catch (const std::exception& e) {
+        commandErr << "Error: " << e.what() << std::endl;
+        exitCode = 1;
+    }
+    std::string outText = commandOut.str();
+    std::string errText = commandErr.str();
+
+    out << exitCode << " " << outText.size() << " " << errText.size() << "\n"
+        << outText << errText;
+    out.flush();
+}
+
+void CommandServer::serve(std::istream& in, std::ostream& out) {
+    std::string line;
+    while (std::getline(in, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty()) {
+            continue;
+        }
+        handleRequest(line, out);
+        if (!out.good()) {
+            break;
+        }
+    }
+}
+
+int CommandServer::serveStdio() {
+    serve(std::cin, std::cout);
+    return 0;
+}
+
+int CommandServer::serveSocket(const std::string& socketPath) {
+#ifdef _WIN32
+    (void)socketPath;
+    std::cerr << "Error: Unix domain sockets are not supported on this platform" << std::endl;
+    return 1;
+#else
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.empty() || socketPath.size() >= sizeof(addr.sun_path)) {
+        std::cerr << "Error: Invalid socket path: " << socketPath << std::endl;
+        return 1;
+    }
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error: Failed to create socket: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+
+    // Remove a stale socket left behind by a previous run
+    ::unlink(socketPath.c_str());
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listenFd, 16) < 0) {
+        std::cerr << "Error: Failed to listen on " << socketPath << ": " << std::strerror(errno) << std::endl;
+        ::close(listenFd);
+        return 1;
+    }
+
+    std::cerr << "Serving on " << socketPath << std::endl;
+    while (true) {
+        int clientFd = ::accept(listenFd, nullptr, nullptr);
+        if (clientFd < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+
+        FdStreamBuf buffer(clientFd);
+        std::iostream stream(&buffer);
+        serve(stream, stream);
+        ::close(clientFd);
+    }
+
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+    return 1;
+#endif
+}
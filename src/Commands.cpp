@@ -0,0 +1,242 @@
+#include "../include/Commands.h"
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+int runCommand(BankApp* app, const std::vector<std::string>& args, std::ostream& out, std::ostream& err) {
+    if (args.empty()) {
+        err << "Error: No command given" << std::endl;
+        return 1;
+    }
+
+    const std::string& command = args[0];
+    size_t argc = args.size();
+
+    if (command == "register" && argc == 5) {
+        std::string name = args[1];
+        std::string phone = args[2];
+        std::string username = args[3];
+        std::string password = args[4];
+        
+        // Validate input
+        if (!app->isValidName(name)) {
+            err << "Error: Invalid name format" << std::endl;
+            return 1;
+        }
+        if (!app->isValidPhone(phone)) {
+            err << "Error: Invalid phone number format" << std::endl;
+            return 1;
+        }
+        if (!app->isValidUsername(username, err)) {
+            err << "Error: Invalid username format" << std::endl;
+            return 1;
+        }
+        if (!app->isValidPassword(password)) {
+            err << "Error: Invalid password format" << std::endl;
+            return 1;
+        }
+        
+        // Perform registration
+        if (app->registerCustomer(name, phone, username, password)) {
+            out << "Registration successful" << std::endl;
+            return 0;
+        } else {
+            err << "Registration failed" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "login" && argc == 3) {
+        std::string username = args[1];
+        std::string password = args[2];
+        
+        int customerId;
+        if (app->authenticateCustomer(username, password, customerId)) {
+            out << "Login successful" << std::endl;
+            return 0;
+        } else {
+            err << "Invalid username or password" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "create-account" && argc == 5) {
+        std::string username = args[1];
+        std::string password = args[2];
+        std::string accountType = args[3];
+        Money initialBalance = Money::parse(args[4]);
+        
+        int accountNumber = app->createAccount(username, password, accountType, initialBalance);
+        if (accountNumber > 0) {
+            out << "Account created successfully. Account number: " << accountNumber << std::endl;
+            return 0;
+        } else {
+            err << "Failed to create account. Error code: " << accountNumber << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "deposit" && argc == 4) {
+        int accountNumber = std::stoi(args[1]);
+        Money amount = Money::parse(args[2]);
+        std::string password = args[3];
+        
+        if (app->deposit(accountNumber, amount, password, err)) {
+            out << "Deposit successful" << std::endl;
+            return 0;
+        } else {
+            // err << "Deposit failed" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "withdraw" && argc == 4) {
+        int accountNumber = std::stoi(args[1]);
+        Money amount = Money::parse(args[2]);
+        std::string password = args[3];
+        
+        if (app->withdraw(accountNumber, amount, password, err)) {
+            out << "Withdrawal successful" << std::endl;
+            return 0;
+        } else {
+            // err << "Withdrawal failed" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "transfer" && argc == 5) {
+        int fromAccount = std::stoi(args[1]);
+        int toAccount = std::stoi(args[2]);
+        Money amount = Money::parse(args[3]);
+        std::string password = args[4];
+        
+        if (app->transfer(fromAccount, toAccount, amount, password, err)) {
+            out << "Transfer successful" << std::endl;
+            return 0;
+        } else {
+            // err << "Transfer failed" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "get-accounts" && argc == 2) {
+        std::string username = args[1];
+        std::string accounts = app->getAccounts(username);
+        out << accounts << std::endl;
+        return 0;
+    }
+    else if (command == "get-account" && argc == 2) {
+        int accountNumber = std::stoi(args[1]);
+        std::string account = app->getAccountDetails(accountNumber);
+        out << account << std::endl;
+        return 0;
+    }
+    else if (command == "get-transactions" && argc >= 2 && argc <= 4) {
+        int accountNumber = std::stoi(args[1]);
+        // Optional range: timestamps or date prefixes such as 2024-01-31
+        std::string from = argc >= 3 ? args[2] : "";
+        std::string to = argc == 4 ? args[3] : "";
+        std::string transactions = app->getTransactions(accountNumber, from, to, err);
+        out << transactions << std::endl;
+        return 0;
+    }
+    else if (command == "get-user" && argc == 2) {
+        std::string username = args[1];
+        std::string userDetails = app->getUserDetails(username);
+        out << userDetails << std::endl;
+        return 0;
+    }
+    else if (command == "update-profile" && argc == 4) {
+        std::string username = args[1];
+        std::string name = args[2];
+        std::string phone = args[3];
+        
+        if (app->updateProfile(username, name, phone, err)) {
+            out << "Profile updated successfully" << std::endl;
+            return 0;
+        } else {
+            err << "Failed to update profile" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "change-password" && argc == 4) {
+        std::string username = args[1];
+        std::string currentPassword = args[2];
+        std::string newPassword = args[3];
+        
+        if (app->changePassword(username, currentPassword, newPassword, err)) {
+            out << "Password changed successfully" << std::endl;
+            return 0;
+        } else {
+            err << "Failed to change password" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "close-account" && argc == 3) {
+        int accountNumber = std::stoi(args[1]);
+        std::string password = args[2];
+        
+        if (app->closeAccount(accountNumber, password, err)) {
+            out << "Account closed successfully" << std::endl;
+            return 0;
+        } else {
+            err << "Failed to close account" << std::endl;
+            return 1;
+        }
+    }
+    else if (command == "compact" && (argc == 1 || (argc == 3 && args[1] == "--rate"))) {
+        // Optional throttle in KB/s
+        uint64_t bytesPerSecond = argc == 3 ? std::stoull(args[2]) * 1024 : 0;
+
+        std::string stats = app->compactTransactions(bytesPerSecond, err);
+        if (stats.empty()) {
+            err << "Failed to compact transactions" << std::endl;
+            return 1;
+        }
+        out << stats << std::endl;
+        return 0;
+    }
+    else if (command == "convert" && (argc == 1 || (argc == 2 && (args[1] == "binary" || args[1] == "text")))) {
+        bool binary = argc == 1 || args[1] == "binary";
+        if (!app->convertSnapshot(binary, err)) {
+            err << "Failed to convert data" << std::endl;
+            return 1;
+        }
+        out << "Data converted to " << (binary ? "binary snapshot" : "text files") << std::endl;
+        return 0;
+    }
+    else if (command == "month-end" && (argc == 1 || (argc == 3 && args[1] == "--threads"))) {
+        // Default: one thread per core
+        unsigned int threads = argc == 3 ? static_cast<unsigned int>(std::stoul(args[2])) : 0;
+
+        std::string stats = app->runMonthEnd(threads, err);
+        if (stats.empty()) {
+            err << "Failed to run month-end" << std::endl;
+            return 1;
+        }
+        out << stats << std::endl;
+        return 0;
+    }
+    else if (command == "engine-stats" && argc == 1) {
+        // Counters of this process, so only meaningful from a long-running server
+        out << app->getEngineStats() << std::endl;
+        return 0;
+    }
+    else {
+        err << "Usage:" << std::endl;
+        err << "  register <name> <phone> <username> <password>" << std::endl;
+        err << "  login <username> <password>" << std::endl;
+        err << "  create-account <username> <password> <type> <balance>" << std::endl;
+        err << "  deposit <account> <amount> <password>" << std::endl;
+        err << "  withdraw <account> <amount> <password>" << std::endl;
+        err << "  transfer <from> <to> <amount> <password>" << std::endl;
+        err << "  get-accounts <username>" << std::endl;
+        err << "  get-account <account>" << std::endl;
+        err << "  get-transactions <account> [from] [to]" << std::endl;
+        err << "  get-user <username>" << std::endl;
+        err << "  update-profile <username> <name> <phone>" << std::endl;
+        err << "  change-password <username> <current-password> <new-password>" << std::endl;
+        err << "  close-account <account> <password>" << std::endl;
+        err << "  compact [--rate <KB/s>]" << std::endl;
+        err << "  convert [binary|text]" << std::endl;
+        err << "  month-end [--threads <n>]" << std::endl;
+        err << "  engine-stats (serve only)" << std::endl;
+        err << "  serve [--socket <path>]" << std::endl;
+        err << "  http [port]" << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,206 @@
+#include "../include/Compactor.h"
+#include "../include/LineScanner.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+// Sleeps as needed to keep the processed byte count under a rate
+class Compactor::Throttle {
+private:
+    uint64_t bytesPerSecond;
+    uint64_t bytes;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit Throttle(uint64_t bytesPerSecond)
+        : bytesPerSecond(bytesPerSecond), bytes(0), start(std::chrono::steady_clock::now()) {
+    }
+
+    void consume(uint64_t count) {
+        bytes += count;
+        if (bytesPerSecond == 0) {
+            return;
+        }
+        auto due = start + std::chrono::microseconds(bytes * 1000000 / bytesPerSecond);
+        if (due > std::chrono::steady_clock::now()) {
+            std::this_thread::sleep_until(due);
+        }
+    }
+};
+
+namespace {
+
+uint64_t fileSize(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return 0;
+    }
+    std::streamoff size = file.tellg();
+    return size > 0 ? static_cast<uint64_t>(size) : 0;
+}
+
+std::string directoryOf(const std::string& path) {
+    std::string::size_type slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+} // namespace
+
+Compactor::Compactor(GroupCommitLog& log, TransactionIndex& index)
+    // Tombstones may predate this process, so the first background run checks
+    : log(log), index(index), stopping(false), closures(1) {
+}
+
+Compactor::~Compactor() {
+    stopBackground();
+}
+
+void Compactor::noteClosure() {
+    std::lock_guard<std::mutex> lock(backgroundMutex);
+    closures++;
+}
+
+Compactor::Stats Compactor::run(uint64_t bytesPerSecond) {
+    std::lock_guard<std::mutex> runLock(runMutex);
+    auto started = std::chrono::steady_clock::now();
+    Stats stats;
+    Throttle throttle(bytesPerSecond);
+
+    // Footers list the closed accounts of sealed segments
+    std::unordered_set<int> closed = index.closedAccounts();
+    if (!closed.empty()) {
+        // Only sealed segments are rewritten. The active one is left to grow
+        // to the seal size: sealing it early for a tombstone, which is never
+        // dropped, would only produce ever more small segments.
+        if (index.activeHasAny(closed) && index.needsSeal()) {
+            index.seal(log);
+        }
+        std::unordered_set<int> dropped;
+        for (unsigned int id : index.segmentIds()) {
+            if (index.segmentHasReclaimable(id, closed)) {
+                compactSegment(id, closed, throttle, stats, dropped);
+            }
+        }
+        stats.accountsDropped = dropped.size();
+    }
+
+    stats.compacted = stats.segmentsRewritten > 0;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+void Compactor::compactSegment(unsigned int id, const std::unordered_set<int>& closed, Throttle& throttle, Stats& stats,
+                               std::unordered_set<int>& droppedAccounts) {
+    const std::string path = index.segmentPath(id);
+    const std::string compactedPath = path + ".compact";
+    const std::string compactedIndexPath = index.segmentIndexPath(id) + ".compact";
+
+    bool readable = std::ifstream(path, std::ios::binary).is_open();
+    std::ofstream out(compactedPath, std::ios::binary | std::ios::trunc);
+    std::ofstream indexOut(compactedIndexPath, std::ios::trunc);
+    if (!readable || !out.is_open() || !indexOut.is_open()) {
+        throw std::runtime_error("Failed to open files for compaction of " + path);
+    }
+
+    SegmentFooter footer;
+    uint64_t written = 0;
+    uint64_t chunkBytes = 0;
+    uint64_t dropped = 0;
+    std::unordered_set<int> segmentAccounts;
+    LineScanner::scanFile(path, 0, UINT64_MAX, [&](std::string_view line, uint64_t) {
+        chunkBytes += line.size() + 1;
+        int accountNumber = TransactionIndex::accountOf(line);
+        if (accountNumber < 0) {
+            return; // the old footer
+        }
+        if (closed.count(accountNumber) && !TransactionIndex::isClosure(line)) {
+            dropped++;
+            segmentAccounts.insert(accountNumber);
+        } else {
+            out << line << '\n';
+            indexOut << accountNumber << ":" << written << ":" << line.size() + 1 << "\n";
+            footer.include(line);
+            written += line.size() + 1;
+        }
+        if (chunkBytes >= THROTTLE_CHUNK) {
+            out.flush();
+            if (!out.good()) {
+                throw std::runtime_error("Failed to write compacted segment");
+            }
+            throttle.consume(chunkBytes);
+            chunkBytes = 0;
+        }
+    });
+    throttle.consume(chunkBytes);
+
+    footer.seal();
+    out << footer.toLine() << '\n';
+    out.close();
+    indexOut.close();
+    if (!out.good() || !indexOut.good()) {
+        throw std::runtime_error("Failed to write compacted segment");
+    }
+    if (dropped == 0) {
+        // A Bloom filter false positive; keep the original
+        std::remove(compactedPath.c_str());
+        std::remove(compactedIndexPath.c_str());
+        return;
+    }
+
+    uint64_t before = fileSize(path);
+    GroupCommitLog::syncFile(compactedPath);
+    // Held back like a seal, so no process holds on to a replaced segment
+    log.exclusive([&] { index.replaceSegment(id, compactedPath, compactedIndexPath); });
+    GroupCommitLog::syncDirectory(directoryOf(path));
+
+    stats.segmentsRewritten++;
+    stats.linesDropped += dropped;
+    droppedAccounts.insert(segmentAccounts.begin(), segmentAccounts.end());
+    stats.bytesBefore += before;
+    stats.bytesAfter += fileSize(path);
+}
+
+void Compactor::startBackground(unsigned int intervalSeconds, uint64_t bytesPerSecond) {
+    std::lock_guard<std::mutex> lock(backgroundMutex);
+    if (background.joinable() || intervalSeconds == 0) {
+        return;
+    }
+    stopping = false;
+    background = std::thread(&Compactor::backgroundLoop, this, intervalSeconds, bytesPerSecond);
+}
+
+void Compactor::stopBackground() {
+    {
+        std::lock_guard<std::mutex> lock(backgroundMutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    if (background.joinable()) {
+        background.join();
+    }
+}
+
+void Compactor::backgroundLoop(unsigned int intervalSeconds, uint64_t bytesPerSecond) {
+    std::unique_lock<std::mutex> lock(backgroundMutex);
+    while (!stopping) {
+        wakeup.wait_for(lock, std::chrono::seconds(intervalSeconds), [this] { return stopping; });
+        if (stopping || closures == 0) {
+            continue;
+        }
+        closures = 0;
+        lock.unlock();
+        try {
+            Stats stats = run(bytesPerSecond);
+            if (stats.compacted) {
+                std::fprintf(stderr, "Compaction reclaimed %llu bytes in %zu segment(s) (%llu -> %llu) in %.3f s\n",
+                             static_cast<unsigned long long>(stats.bytesReclaimed()), stats.segmentsRewritten,
+                             static_cast<unsigned long long>(stats.bytesBefore),
+                             static_cast<unsigned long long>(stats.bytesAfter), stats.seconds);
+            }
+        } catch (const std::exception& e) {
+            std::fprintf(stderr, "Compaction failed: %s\n", e.what());
+        }
+        lock.lock();
+    }
+}
@@ -1,44 +1,33 @@
 #include "../include/CurrentAccount.h"
 #include <stdexcept>
 
-CurrentAccount::CurrentAccount(int accNo, double initialBalance, Customer* owner, double maintenanceFee)
+CurrentAccount::CurrentAccount(int accNo, Money initialBalance, Customer* owner, Money maintenanceFee)
     : Account(accNo, initialBalance, owner, AccountType::CURRENT), maintenanceFee(maintenanceFee) {
-    if (maintenanceFee < 0) {
+    if (maintenanceFee < Money()) {
         throw std::invalid_argument("Maintenance fee cannot be negative");
     }
 }
 
-bool CurrentAccount::deposit(double amount) {
-    if (amount <= 0) {
-        return false;
-    }
-    try {
-        updateBalance(getBalance() + amount);
-        return true;
-    } catch (const std::exception&) {
+bool CurrentAccount::deposit(Money amount) {
+    if (amount <= Money()) {
         return false;
     }
+    return changeBalance(amount);
 }
 
-bool CurrentAccount::withdraw(double amount) {
-    if (amount <= 0 || amount > getBalance()) {
-        return false;
-    }
-    try {
-        updateBalance(getBalance() - amount);
-        return true;
-    } catch (const std::exception&) {
+bool CurrentAccount::withdraw(Money amount) {
+    if (amount <= Money()) {
         return false;
     }
+    return changeBalance(-amount);
 }
 
 void CurrentAccount::applyMonthlyUpdate() {
-    if (getBalance() < maintenanceFee) {
+    if (!changeBalance(-maintenanceFee)) {
         throw std::runtime_error("Insufficient balance for maintenance fee");
     }
-    updateBalance(getBalance() - maintenanceFee);
 }
 
-double CurrentAccount::calculateInterest() const {
-    return 0.0; // Current accounts don't earn interest
+Money CurrentAccount::calculateInterest() const {
+    return Money(); // Current accounts don't earn interest
 } 
\ No newline at end of file
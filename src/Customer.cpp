@@ -20,16 +20,21 @@ void Customer::addAccount(std::unique_ptr<Account> account) {
 }
 
 bool Customer::removeAccount(int accountNumber) {
+    return takeAccount(accountNumber) != nullptr;
+}
+
+std::unique_ptr<Account> Customer::takeAccount(int accountNumber) {
     auto it = std::find_if(accounts.begin(), accounts.end(),
         [accountNumber](const auto& account) {
             return account->getAccountNumber() == accountNumber;
         });
     
-    if (it != accounts.end()) {
-        accounts.erase(it);
-        return true;
+    if (it == accounts.end()) {
+        return nullptr;
     }
-    return false;
+    std::unique_ptr<Account> account = std::move(*it);
+    accounts.erase(it);
+    return account;
 }
 
 const std::vector<std::unique_ptr<Account>>& Customer::getAccounts() const {
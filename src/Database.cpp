@@ -3,27 +3,99 @@
 #include "../include/CurrentAccount.h"
 #include "../include/AuditableSavingsAccount.h"
 #include "../include/Transaction.h"
+#include "../include/Snapshot.h"
+#include "../include/RecordTokenizer.h"
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <iomanip>
+#include <limits>
+#include <chrono>
+#include <ctime>
 #include <sys/stat.h>
 
-// Initialize static members
-Database* Database::instance = nullptr;
-// std::mutex Database::mutex;  // Temporarily commented out for compilation
+// Calls fn with a view of each line of a chunk, without its newline
+template <typename Fn>
+static void forEachLine(std::string_view chunk, Fn fn) {
+    while (!chunk.empty()) {
+        size_t newline = chunk.find('\n');
+        fn(chunk.substr(0, newline));
+        chunk.remove_prefix(newline == std::string_view::npos ? chunk.size() : newline + 1);
+    }
+}
+
+// BANK_LAZY_LOAD=0 loads everything up front
+static bool lazyLoadEnabled() {
+    const char* value = std::getenv("BANK_LAZY_LOAD");
+    return !(value && std::string(value) == "0");
+}
+
+// Sealing renames the active history away; appenders in other processes
+// coordinate with it through a lock file that stays put
+static GroupCommitLog::Options historyLogOptions(const std::string& dataDir) {
+    GroupCommitLog::Options options = GroupCommitLog::optionsFromEnvironment();
+    options.lockPath = dataDir + "/transactions.lock";
+    return options;
+}
+
+static bool optimisticEnabled() {
+    const char* value = std::getenv("BANK_ENGINE");
+    return value && std::string(value) == "optimistic";
+}
 
-Database::Database(const std::string& dataDir) : dataDir(dataDir) {
+// Initialize static members
+std::atomic<Database*> Database::instance{nullptr};
+std::mutex Database::mutex;
+
+Database::Database(const std::string& dataDir)
+    : dataDir(dataDir), binarySnapshot(false), lazy(false), imageStale(false), dirtyTables(0),
+      accountStore(dataDir + "/accounts.dat"),
+      journal(dataDir + "/journal.log"),
+      transactionLog(dataDir + "/transactions.txt", historyLogOptions(dataDir)),
+      transactionIndex(dataDir + "/transactions.txt", dataDir + "/transactions.idx"),
+      compactor(transactionLog, transactionIndex), optimistic(false), unlockedAccesses(0) {
     createDataDirectory();
-    loadAll();
+    if (Sequencer::enabledFromEnvironment()) {
+        sequencer = std::make_unique<Sequencer>(
+            [this](const std::vector<Sequencer::Command*>& batch) { applySequenced(batch); });
+    }
+    // The shared image needs lazy lookups to read it in place
+    if (SharedImage::enabledFromEnvironment() && lazyLoadEnabled()) {
+        sharedImage = std::make_unique<SharedImage>(dataDir);
+        if (!sharedImage->isAvailable()) {
+            sharedImage.reset();
+        }
+    }
+    if (!attachImage()) {
+        loadAll();
+        recoverJournal();
+        if (sharedImage) {
+            // Stamped before loading, except accounts.dat, which loading may create
+            imageSources.accountStore = SharedImage::stamp(getAccountStorePath());
+            publishImage();
+        }
+    }
+    if (!sequencer && optimisticEnabled()) {
+        optimistic = claimBalances();
+        if (!optimistic) {
+            std::cerr << "Warning: another process is changing balances; "
+                      << "BANK_ENGINE=optimistic falls back to account locks" << std::endl;
+        }
+    }
 }
 
 Database* Database::getInstance(const std::string& dataDir) {
-    // std::lock_guard<std::mutex> lock(mutex);
-    if (instance == nullptr) {
-        instance = new Database(dataDir);
+    // Called on every request, so the lock is only taken before creation
+    Database* existing = instance.load(std::memory_order_acquire);
+    if (existing) {
+        return existing;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!instance.load(std::memory_order_relaxed)) {
+        instance.store(new Database(dataDir), std::memory_order_release);
     }
-    return instance;
+    return instance.load(std::memory_order_relaxed);
 }
 
 void Database::createDataDirectory() {
@@ -79,7 +151,16 @@ std::string Database::getCounterFilePath() const {
     return dataDir + "/counters.txt";
 }
 
+std::string Database::getSnapshotFilePath() const {
+    return dataDir + "/snapshot.bin";
+}
+
+std::string Database::getAccountStorePath() const {
+    return dataDir + "/accounts.dat";
+}
+
 bool Database::addCustomer(std::unique_ptr<Customer> customer, const std::string& username, const std::string& password) {
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
     if (usernameExists(username)) {
         return false;
     }
@@ -88,17 +169,31 @@ bool Database::addCustomer(std::unique_ptr<Customer> customer, const std::string
         // If customer is nullptr, we're just adding authentication data
         if (customer) {
             int customerId = customer->getId();
-            usernameToCustomerId[username] = customerId;
-            usernamePasswords[username] = password;
-            customers[customerId] = std::move(customer);
+            Customer* added = customer.get();
+            {
+                std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+                erasedUsers.erase(username);
+            }
+            {
+                std::unique_lock<std::shared_mutex> usernameLock(usernameMutex);
+                usernameToCustomerId[username] = customerId;
+                usernamePasswords[username] = password;
+            }
+            customers.set(customerId, std::move(customer));
+
+            journalCustomer(added);
+            journalUser(username);
+            commitJournal();
         }
         
-        saveAll(); // Save all data after adding customer
         return true;
     } catch (const std::exception& e) {
-        if (customer) {
-            customers.erase(customer->getId());
-            usernameToCustomerId.erase(username);
+        journal.rollback();
+        std::unique_lock<std::shared_mutex> usernameLock(usernameMutex);
+        auto it = usernameToCustomerId.find(username);
+        if (it != usernameToCustomerId.end()) {
+            customers.erase(it->second);
+            usernameToCustomerId.erase(it);
             usernamePasswords.erase(username);
         }
         throw std::runtime_error("Failed to save customer data: " + std::string(e.what()));
@@ -106,47 +201,48 @@ bool Database::addCustomer(std::unique_ptr<Customer> customer, const std::string
 }
 
 Customer* Database::findCustomer(int customerId) const {
-    auto it = customers.find(customerId);
-    return it != customers.end() ? it->second.get() : nullptr;
+    Customer* customer = customers.read(customerId, [](const std::unique_ptr<Customer>* found) {
+        return found ? found->get() : nullptr;
+    });
+    if (customer || !lazy) {
+        return customer;
+    }
+    std::shared_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+    return faultCustomer(customerId);
 }
 
-bool Database::removeCustomer(int customerId) {
-    auto it = customers.find(customerId);
-    if (it == customers.end()) {
-    return false;
+void Database::updateCustomer(const Customer* customer) {
+    if (!customer) {
+        throw std::invalid_argument("Customer cannot be null");
+    }
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    journalCustomer(customer);
+    commitJournal();
 }
 
-    try {
-        // Remove all associated accounts
-        for (const auto& account : it->second->getAccounts()) {
-            removeAccount(account->getAccountNumber());
-        }
-        
-        // Remove from maps
-        customers.erase(it);
+bool Database::removeCustomer(int customerId) {
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    Customer* customer = findCustomer(customerId);
+    if (!customer) {
+        return false;
+    }
 
-        std::string username;
-        
-        // Remove from auth data
-        for (auto it = usernameToCustomerId.begin(); it != usernameToCustomerId.end();) {
-            if (it->second == customerId) {
-                username = it->first;
-                it = usernameToCustomerId.erase(it);
-            } else {
-                ++it;
-            }
+    try {
+        // Remove all associated accounts (collect first: removal edits the list)
+        std::vector<int> accountNumbers;
+        for (const auto& account : customer->getAccounts()) {
+            accountNumbers.push_back(account->getAccountNumber());
         }
-
-        for (auto it = usernamePasswords.begin(); it != usernamePasswords.end();) {
-            if (it->first == username) {
-                it = usernamePasswords.erase(it);
-            } else {
-                ++it;
-            }
+        for (int accountNumber : accountNumbers) {
+            removeAccount(accountNumber);
         }
         
-        // Save changes
-        saveAll();
+        // Remove from maps and auth data
+        eraseCustomer(customerId);
+        
+        // Record the removal
+        journalRecord("DELCUSTOMER:" + std::to_string(customerId));
+        commitJournal();
         return true;
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to remove customer: " + std::string(e.what()));
@@ -155,24 +251,30 @@ bool Database::removeCustomer(int customerId) {
 
 bool Database::addAccount(std::unique_ptr<Account> account, const std::string& password) {
     int accountNumber = account->getAccountNumber();
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
     
     try {
         // Store the pointer BEFORE moving the account
         Account* accountPtr = account.get();
         
-        accounts[accountNumber] = accountPtr;
+        accounts.set(accountNumber, accountPtr);
         
-        accountPasswords[accountNumber] = password;
+        accountPasswords.set(accountNumber, password);
         
-        // Now move the account to the customer
+        // Now move the account to the customer, whose list others may be reading
         Customer* owner = account->getOwner();
         
-        owner->addAccount(std::move(account));
+        customers.update(owner->getId(), [&](std::unique_ptr<Customer>&) {
+            owner->addAccount(std::move(account));
+        });
         
-        saveAll(); // Save all data after adding account
+        journalAccount(accountPtr);
+        journalRecord("ACCOUNTAUTH:" + std::to_string(accountNumber) + ":" + password);
+        commitJournal();
         
         return true;
     } catch (const std::exception& e) {
+        journal.rollback();
         accounts.erase(accountNumber);
         accountPasswords.erase(accountNumber);
         throw std::runtime_error("Failed to add account: " + std::string(e.what()));
@@ -180,53 +282,43 @@ bool Database::addAccount(std::unique_ptr<Account> account, const std::string& p
 }
 
 Account* Database::findAccount(int accountNumber) const {
-    auto it = accounts.find(accountNumber);
-    if (it != accounts.end()) {
-        return it->second;
-    } else {
+    Account* account = nullptr;
+    if (accounts.get(accountNumber, account) || !lazy) {
+        return account;
+    }
+
+    std::shared_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+    if (erasedAccounts.count(accountNumber)) {
+        return nullptr;
+    }
+    // Faulting in the owner brings in all of its accounts
+    AccountStore::Slot slot;
+    if (!accountStore.read(accountNumber, slot) || !faultCustomer(slot.ownerId)) {
         return nullptr;
     }
+    accounts.get(accountNumber, account);
+    return account;
 }
 
 bool Database::removeAccount(int accountNumber) {
-    auto it = accounts.find(accountNumber);
-    auto it2 = accountPasswords.find(accountNumber);
-    if (it == accounts.end() || it2 == accountPasswords.end()) {
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    if (!findAccount(accountNumber) || !lookupAccountPassword(accountNumber)) {
         return false;
     }
 
     try {
-        // 1. Get the account and its owner before removing
-        Account* account = it->second;
-        Customer* owner = account->getOwner();
-        
-        // 2. Remove from customer's account list
-        if (owner) {
-            owner->removeAccount(accountNumber);
-        }
+        // 1-3. Remove from the owner's account list and the database maps
+        eraseAccount(accountNumber);
 
-        // 3. Remove from database maps
-        accounts.erase(it);
-        accountPasswords.erase(it2);
+        // 4. Record the removal before hiding the history, so a crash in
+        //    between leaves the history of a deleted account, never a live
+        //    account without its history
+        journalRecord("DELACCOUNT:" + std::to_string(accountNumber));
+        commitJournal();
 
-        // 4. Clean up transaction history
-        std::ifstream transFile(getTransactionFilePath());
-        std::ofstream tempFile(getTransactionFilePath() + ".tmp");
-        std::string line;
-        
-        while (std::getline(transFile, line)) {
-            std::stringstream ss(line);
-            int accNum;
-            ss >> accNum;
-            if (accNum != accountNumber) {
-                tempFile << line << std::endl;
-            }
-        }
-        
-        transFile.close();
-        tempFile.close();
-        std::remove(getTransactionFilePath().c_str());
-        std::rename((getTransactionFilePath() + ".tmp").c_str(), getTransactionFilePath().c_str());
+        // Hide the transaction history with a tombstone; compaction reclaims
+        // the space later instead of rewriting the whole file now
+        saveClosure(accountNumber);
 
         // 5. Clean up account file
         // std::ifstream accFile(getAccountFilePath());
@@ -265,14 +357,49 @@ bool Database::removeAccount(int accountNumber) {
         // std::experimental::filesystem::remove(getAuthFilePath());
         // std::experimental::filesystem::rename(getAuthFilePath() + ".tmp", getAuthFilePath());
 
-        // 7. Save all remaining changes
-        //saveAll();
         return true;
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to remove account: " + std::string(e.what()));
     }
 }
 
+AccountStore::Lock Database::lockAccounts(const std::vector<int>& accountNumbers) {
+    AccountStore::Lock lock(accountStore, accountNumbers);
+    // Another process may have changed them since they were loaded
+    for (int number : accountNumbers) {
+        Account* account = findAccount(number);
+        AccountStore::Slot slot;
+        if (account && accountStore.read(number, slot)) {
+            reloadBalance(account, slot);
+        }
+    }
+    return lock;
+}
+
+void Database::reloadBalance(Account* account, const AccountStore::Slot& slot) {
+    balanceVersions.update(slot.number, [&](uint64_t& version) {
+        if (slot.version > version) {
+            account->updateBalance(Money::fromMinor(slot.balance), slot.accruedPeriod);
+            version = slot.version;
+        }
+    });
+}
+
+bool Database::claimBalances() {
+    if (!accountStore.claimSoleWriter()) {
+        return false;
+    }
+    // Balances other processes changed before the claim; none can change
+    // them from now on
+    for (const AccountStore::Slot& slot : accountStore.readAll()) {
+        Account* account = nullptr;
+        if (accounts.get(slot.number, account) && account) {
+            reloadBalance(account, slot);
+        }
+    }
+    return true;
+}
+
 bool Database::addTransaction(int accountNumber, std::unique_ptr<ITransaction> transaction) {
     Account* account = findAccount(accountNumber);
     if (!account) {
@@ -282,22 +409,391 @@ bool Database::addTransaction(int accountNumber, std::unique_ptr<ITransaction> t
     try {
         saveTransaction(account, transaction.get());      // Save before moving
         // account->addTransaction(std::move(transaction));  // Move after saving
+
+        const Transfer* transfer = dynamic_cast<const Transfer*>(transaction.get());
+        if (!transfer) {
+            // One balance changed: a single write of its slot persists it
+            writeAccountSlot(account);
+            return true;
+        }
+
+        // A transfer changes two slots, which must not be torn apart by a
+        // crash, so both balances go through the journal instead
+        std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+        journalBalance(account);
+        int otherAccount = transfer->getFromAccount() == accountNumber ? transfer->getToAccount()
+                                                                       : transfer->getFromAccount();
+        if (Account* other = findAccount(otherAccount)) {
+            journalBalance(other);
+        }
+        commitJournal();
         return true;
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to add transaction: " + std::string(e.what()));
     }
 }
 
+Database::TransferResult Database::transfer(int fromAccount, int toAccount, Money amount) {
+    if (fromAccount == toAccount) {
+        throw std::invalid_argument("Cannot transfer to the same account");
+    }
+    AccountStore::Lock lock = lockAccounts({fromAccount, toAccount});
+    Account* from = findAccount(fromAccount);
+    Account* to = findAccount(toAccount);
+    if (!from || !to) {
+        return TransferResult::NO_ACCOUNT;
+    }
+    uint32_t fromPeriod;
+    uint32_t toPeriod;
+    Money fromBalance = from->getBalance(fromPeriod);
+    Money toBalance = to->getBalance(toPeriod);
+    if (!from->withdraw(amount)) {
+        return TransferResult::INSUFFICIENT_FUNDS;
+    }
+    to->deposit(amount);
+
+    auto undo = [&]() {
+        from->updateBalance(fromBalance, fromPeriod);
+        to->updateBalance(toBalance, toPeriod);
+    };
+
+    try {
+        Transfer transaction(from, to, amount);
+        saveTransaction(from, &transaction);
+    } catch (...) {
+        undo();
+        throw;
+    }
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    try {
+        journalBalance(from);
+        journalBalance(to);
+        commitJournal();
+    } catch (...) {
+        // Once both records are committed the transfer stands, even if
+        // writing through its slots failed afterwards
+        if (journal.hasPending()) {
+            journal.rollback();
+            undo();
+        }
+        throw;
+    }
+    return TransferResult::DONE;
+}
+
+void Database::applySequenced(const std::vector<Sequencer::Command*>& batch) {
+    std::vector<int> accountNumbers;
+    for (const Sequencer::Command* command : batch) {
+        accountNumbers.push_back(command->account);
+        if (command->kind == Sequencer::Kind::TRANSFER) {
+            accountNumbers.push_back(command->toAccount);
+        }
+    }
+    // Other processes and lock-based callers are kept out until the whole
+    // batch is persisted
+    AccountStore::Lock lock = lockAccounts(accountNumbers);
+
+    // Each changed account's balance before the batch, to put back if it
+    // cannot be persisted
+    std::unordered_map<Account*, std::pair<Money, uint32_t>> before;
+    std::vector<std::pair<int, std::string>> lines;
+    for (Sequencer::Command* command : batch) {
+        Account* account = findAccount(command->account);
+        Account* to = command->kind == Sequencer::Kind::TRANSFER ? findAccount(command->toAccount) : nullptr;
+        if (!account || (command->kind == Sequencer::Kind::TRANSFER && !to)) {
+            command->result = Sequencer::Result::NO_ACCOUNT;
+            continue;
+        }
+        uint32_t accountPeriod;
+        uint32_t toPeriod = 0;
+        Money accountBalance = account->getBalance(accountPeriod);
+        Money toBalance = to ? to->getBalance(toPeriod) : Money();
+
+        std::unique_ptr<ITransaction> transaction;
+        switch (command->kind) {
+            case Sequencer::Kind::DEPOSIT:
+                if (account->deposit(command->amount)) {
+                    transaction = std::make_unique<Deposit>(account, command->amount);
+                }
+                break;
+            case Sequencer::Kind::WITHDRAWAL:
+                if (account->withdraw(command->amount)) {
+                    transaction = std::make_unique<Withdrawal>(account, command->amount);
+                }
+                break;
+            case Sequencer::Kind::TRANSFER:
+                if (to != account && account->withdraw(command->amount)) {
+                    to->deposit(command->amount);
+                    transaction = std::make_unique<Transfer>(account, to, command->amount);
+                }
+                break;
+        }
+        if (!transaction) {
+            command->result = Sequencer::Result::REJECTED;
+            continue;
+        }
+        command->result = Sequencer::Result::DONE;
+        before.emplace(account, std::make_pair(accountBalance, accountPeriod));
+        if (to) {
+            before.emplace(to, std::make_pair(toBalance, toPeriod));
+        }
+        for (auto& line : historyLines(account, transaction.get())) {
+            lines.push_back(std::move(line));
+        }
+    }
+    if (before.empty()) {
+        return;
+    }
+
+    auto undo = [&]() {
+        for (const auto& entry : before) {
+            entry.first->updateBalance(entry.second.first, entry.second.second);
+        }
+    };
+    try {
+        appendHistory(lines);
+    } catch (const std::exception& e) {
+        undo();
+        throw std::runtime_error("Failed to save transactions: " + std::string(e.what()));
+    }
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    try {
+        for (const auto& entry : before) {
+            journalBalance(entry.first);
+        }
+        commitJournal();
+    } catch (...) {
+        // As in transfer(), committed changes stand
+        if (journal.hasPending()) {
+            journal.rollback();
+            undo();
+        }
+        throw;
+    }
+}
+
+Database::Engine Database::getEngine() const {
+    if (sequencer) {
+        return Engine::SEQUENCER;
+    }
+    return optimistic ? Engine::OPTIMISTIC : Engine::LOCKS;
+}
+
+Sequencer::Result Database::changeOptimistically(Sequencer::Kind kind, int accountNumber, int toAccount,
+                                                 Money amount) {
+    UnlockedAccess access(*this);
+    Account* account = findAccount(accountNumber);
+    Account* to = kind == Sequencer::Kind::TRANSFER ? findAccount(toAccount) : nullptr;
+    if (!account || (kind == Sequencer::Kind::TRANSFER && !to)) {
+        return Sequencer::Result::NO_ACCOUNT;
+    }
+
+    std::unique_ptr<ITransaction> transaction;
+    switch (kind) {
+        case Sequencer::Kind::DEPOSIT:
+            if (account->deposit(amount)) {
+                transaction = std::make_unique<Deposit>(account, amount);
+            }
+            break;
+        case Sequencer::Kind::WITHDRAWAL:
+            if (account->withdraw(amount)) {
+                transaction = std::make_unique<Withdrawal>(account, amount);
+            }
+            break;
+        case Sequencer::Kind::TRANSFER:
+            if (amount > Money() && Account::transferBetween(*account, *to, amount)) {
+                transaction = std::make_unique<Transfer>(account, to, amount);
+            }
+            break;
+    }
+    if (!transaction) {
+        // Closed since it was looked up
+        bool closed = account->isClosed() || (to && to->isClosed());
+        return closed ? Sequencer::Result::NO_ACCOUNT : Sequencer::Result::REJECTED;
+    }
+
+    if (!to) {
+        // As with addTransaction(): the history line, then the slot
+        saveTransaction(account, transaction.get());
+        writeAccountSlot(account);
+        return Sequencer::Result::DONE;
+    }
+
+    // Other changes may have come in meanwhile, so a failed transfer is
+    // compensated with the opposite transfer rather than by restoring the
+    // balances it saw
+    auto undo = [&]() {
+        Account::transferBetween(*to, *account, amount);
+    };
+    try {
+        saveTransaction(account, transaction.get());
+    } catch (...) {
+        undo();
+        throw;
+    }
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    try {
+        journalBalance(account);
+        journalBalance(to);
+        commitJournal();
+    } catch (...) {
+        // As in transfer(), committed changes stand
+        if (journal.hasPending()) {
+            journal.rollback();
+            undo();
+        }
+        throw;
+    }
+    return Sequencer::Result::DONE;
+}
+
+std::vector<std::string> Database::getTransactionHistory(int accountNumber, const std::string& from,
+                                                        const std::string& to) const {
+    return transactionIndex.lines(accountNumber, from, to);
+}
+
+Database::MonthEndStats Database::runMonthEnd(unsigned int threads) {
+    auto started = std::chrono::steady_clock::now();
+    MonthEndStats stats;
+
+    // Accounts are updated without their locks, so other processes must
+    // keep out; claiming the table also reloads what they changed before
+    bool claimed = !optimistic;
+    if (claimed && !claimBalances()) {
+        throw std::runtime_error("Balances are being changed by another process; month-end needs the account table to itself");
+    }
+    struct Release {
+        AccountStore& store;
+        bool claimed;
+        ~Release() {
+            if (claimed) {
+                store.releaseSoleWriter();
+            }
+        }
+    } release{accountStore, claimed};
+    UnlockedAccess access(*this);
+    ParallelLoader workers(threads ? threads : std::max(std::thread::hardware_concurrency(), 1u));
+
+    // Savings interest is not applied here: advancing the interest period
+    // below accrues it for every savings account at once. Only the other
+    // accounts are visited.
+    if (lazy) {
+        // Found through their slots' types, without faulting in the owners
+        // of savings accounts; holding the journal keeps a checkpoint from
+        // replacing the snapshot meanwhile
+        std::vector<int> owners;
+        for (const AccountStore::Slot& slot : accountStore.readAll()) {
+            if (!Account::accruesLazily(static_cast<AccountType>(slot.type))) {
+                owners.push_back(slot.ownerId);
+            }
+        }
+        std::sort(owners.begin(), owners.end());
+        owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+        // Faulting a customer in brings its accounts with it
+        std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+        const size_t FAULT_CHUNK = 4096;
+        workers.run((owners.size() + FAULT_CHUNK - 1) / FAULT_CHUNK, [&](size_t chunk) {
+            size_t end = std::min(owners.size(), (chunk + 1) * FAULT_CHUNK);
+            for (size_t i = chunk * FAULT_CHUNK; i < end; i++) {
+                findCustomer(owners[i]);
+            }
+        });
+    }
+    std::vector<Account*> open;
+    accounts.forEach([&](int, Account* account) {
+        if (account && !account->isClosed() && !Account::accruesLazily(account->getType())) {
+            open.push_back(account);
+        }
+    });
+    std::sort(open.begin(), open.end(), [](const Account* a, const Account* b) {
+        return a->getAccountNumber() < b->getAccountNumber();
+    });
+    stats.accounts = open.size();
+
+    // Contiguous chunks, each collecting its own failures, so the workers
+    // share nothing but the accounts they update
+    const size_t CHUNK = 4096;
+    size_t chunkCount = (open.size() + CHUNK - 1) / CHUNK;
+    std::vector<Money> deltas(open.size());
+    std::vector<std::vector<std::pair<int, std::string>>> failures(chunkCount);
+    workers.run(chunkCount, [&](size_t chunk) {
+        size_t end = std::min(open.size(), (chunk + 1) * CHUNK);
+        for (size_t i = chunk * CHUNK; i < end; i++) {
+            Account* account = open[i];
+            Money before = account->getBalance();
+            try {
+                account->applyMonthlyUpdate();
+                deltas[i] = account->getBalance() - before;
+            } catch (const std::exception& e) {
+                failures[chunk].emplace_back(account->getAccountNumber(), e.what());
+            }
+        }
+    });
+    for (auto& chunk : failures) {
+        for (auto& failure : chunk) {
+            stats.failures.push_back(std::move(failure));
+        }
+    }
+
+    // Changes made in the meantime stay, so a failed commit takes back only
+    // what the batch added
+    auto undo = [&]() {
+        for (size_t i = 0; i < open.size(); i++) {
+            if (deltas[i] != Money()) {
+                open[i]->changeBalance(-deltas[i]);
+            }
+        }
+    };
+    std::vector<Account*> changed;
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    stats.period = *accountStore.interestPeriodSource() + 1;
+    try {
+        for (size_t i = 0; i < open.size(); i++) {
+            if (deltas[i] != Money()) {
+                journalBalance(open[i]);
+                changed.push_back(open[i]);
+            }
+        }
+        stats.updated = changed.size();
+        // The new period commits with the batch, so a crash cannot keep
+        // one without the other
+        journalRecord("PERIOD:" + std::to_string(stats.period));
+        journal.commit();
+    } catch (...) {
+        if (journal.hasPending()) {
+            journal.rollback();
+            undo();
+        }
+        throw;
+    }
+    // Committed: the period, which every process sees at once, then the
+    // slots in bulk and the usual checkpoint
+    accountStore.setInterestPeriod(stats.period);
+    writeSlotsInBulk(changed);
+    commitJournal();
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    return stats;
+}
+
+Compactor::Stats Database::compactTransactions(uint64_t bytesPerSecond) {
+    return compactor.run(bytesPerSecond);
+}
+
+void Database::startBackgroundCompaction(unsigned int intervalSeconds, uint64_t bytesPerSecond) {
+    compactor.startBackground(intervalSeconds, bytesPerSecond);
+}
+
 void Database::getTransactions(int accountNumber, std::ostream& out) const {
     std::ifstream file(getTransactionFilePath());
     if (!file.is_open()) {
         out << "No transaction history found." << std::endl;
         return;
     }
+    file.close();
 
-    std::string line;
     bool foundTransactions = false;
-    double runningBalance = 0.0; // Track running balance
+    Money runningBalance; // Track running balance
     
     // Header
     out << "\n┌─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─┐" << std::endl;
@@ -306,22 +802,17 @@ void Database::getTransactions(int accountNumber, std::ostream& out) const {
     out << "│ Timestamp           │ Type            │ Amount         │ Balance        │ Related Account │" << std::endl;
     out << "├─────────────────────┼─────────────────┼────────────────┼────────────────┼─────────────────┤" << std::endl;
     
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string accNumStr, timestamp, type, amountStr, relatedAccountStr;
-        
+    for (const std::string& line : getTransactionHistory(accountNumber)) {
         // Parse using colons as separators
-        std::getline(ss, accNumStr, ':');
-        std::getline(ss, timestamp, ':');
-        std::getline(ss, type, ':');
-        std::getline(ss, amountStr, ':');
-        std::getline(ss, relatedAccountStr); // This might be empty for deposits/withdrawals
-        
-        int accNum = std::stoi(accNumStr);
-        if (accNum != accountNumber) continue;
+        RecordTokenizer fields(line);
+        fields.next();  // account number
+        std::string_view timestamp = fields.next();
+        std::string_view type = fields.next();
+        std::string_view amountStr = fields.next();
+        std::string_view relatedAccountStr = fields.rest(); // This might be empty for deposits/withdrawals
         
         if (!timestamp.empty() && !type.empty() && !amountStr.empty()) {
-            double amountValue = std::stod(amountStr);
+            Money amountValue = Money::parse(amountStr);
             foundTransactions = true;
             
             // Update running balance based on transaction type
@@ -340,9 +831,9 @@ void Database::getTransactions(int accountNumber, std::ostream& out) const {
             int relatedWidth = 16;
             
             // Determine transaction type display
-            std::string typeDisplay = type;
+            std::string typeDisplay(type);
             if (type == "2") { // Transfer transaction
-                if (amountValue > 0) {
+                if (amountValue > Money()) {
                     typeDisplay = "Transfer In";
                 } else {
                     typeDisplay = "Transfer Out";
@@ -354,20 +845,20 @@ void Database::getTransactions(int accountNumber, std::ostream& out) const {
             }
 
             // Add related account information for transfers
+            std::string relatedDisplay = "-";
             if (type == "2" && !relatedAccountStr.empty()) {
-                if (amountValue > 0) {
-                    relatedAccountStr = "From " + relatedAccountStr;
+                if (amountValue > Money()) {
+                    relatedDisplay = "From " + std::string(relatedAccountStr);
                 } else {
-                    relatedAccountStr = "To " + relatedAccountStr;
+                    relatedDisplay = "To " + std::string(relatedAccountStr);
                 }
             }
-            else relatedAccountStr = "-";
             
             out << vertical << std::left << std::setw(timestampWidth) << timestamp
                 << vertical << std::setw(typeWidth) << typeDisplay
-                << vertical << "$" << std::setw(amountWidth) << std::fixed << std::setprecision(2) << (amountValue < 0 ? -amountValue : amountValue)
+                << vertical << "$" << std::setw(amountWidth) << std::fixed << std::setprecision(2) << (amountValue < Money() ? -amountValue : amountValue)
                 << vertical << "$" << std::setw(balanceWidth) << std::fixed << std::setprecision(2) << runningBalance
-                << vertical << std::setw(relatedWidth) << relatedAccountStr
+                << vertical << std::setw(relatedWidth) << relatedDisplay
                 << vertical;
             out << std::endl;
         }
@@ -381,6 +872,8 @@ void Database::getTransactions(int accountNumber, std::ostream& out) const {
 }
 
 bool Database::authenticate(const std::string& username, const std::string& password, int& customerId) const {
+    lookupUser(username);
+    std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
     auto it = usernameToCustomerId.find(username);
     if (it == usernameToCustomerId.end()) {
         return false;
@@ -396,103 +889,102 @@ bool Database::authenticate(const std::string& username, const std::string& pass
     return password == it2->second;
 }
 
-bool Database::changePassword(int customerId, const std::string& oldPassword, const std::string& newPassword) {
+bool Database::changePassword(int customerId, const std::string& oldPassword, const std::string& newPassword,
+                              std::ostream& errors) {
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
     try {
         // First, find the username for this customer ID
-        std::string username;
-        for (const auto& pair : usernameToCustomerId) {
-            if (pair.second == customerId) {
-                username = pair.first;
-                break;
-            }
-        }
+        std::string username = usernameOf(customerId);
         
         if (username.empty()) {
-            std::cerr << "Username not found for customer ID: " << customerId << std::endl;
+            errors << "Username not found for customer ID: " << customerId << std::endl;
             return false;
         }
         
         // Verify the old password matches what's in memory
-        auto it = usernamePasswords.find(username);
-        if (it == usernamePasswords.end() || it->second != oldPassword) {
-            std::cerr << "Old password verification failed for username: " << username << std::endl;
-            return false;
-        }
-        
-        // Update the file
-        std::ifstream file(getAuthFilePath());
-        if (!file.is_open()) {
-            std::cerr << "Failed to open auth file for reading" << std::endl;
-            return false;
-        }
-        
-        std::vector<std::string> lines;
-        std::string line;
-        bool found = false;
-        
-        while (std::getline(file, line)) {
-            std::stringstream ss(line);
-            std::string type, fileUsername, storedPassword, storedId;
-            std::getline(ss, type, ':');
-            
-            if (type == "CUSTOMER") {
-                std::getline(ss, fileUsername, ':');
-                std::getline(ss, storedPassword, ':');
-                std::getline(ss, storedId);
-                
-                if (fileUsername == username) {
-                    if (storedPassword != oldPassword) {
-                        std::cerr << "Password mismatch in file for username: " << username << std::endl;
-                        return false;
-                    }
-                    lines.push_back("CUSTOMER:" + username + ":" + newPassword + ":" + storedId);
-                    found = true;
-                } else {
-                    lines.push_back(line);
-                }
-            } else {
-                // Keep non-CUSTOMER lines as they are (ACCOUNT lines)
-                lines.push_back(line);
+        {
+            std::unique_lock<std::shared_mutex> usernameLock(usernameMutex);
+            auto it = usernamePasswords.find(username);
+            if (it == usernamePasswords.end() || it->second != oldPassword) {
+                errors << "Old password verification failed for username: " << username << std::endl;
+                return false;
             }
-        }
-
-        if (!found) {
-            std::cerr << "Customer record not found in auth file for username: " << username << std::endl;
-            return false;
-        }
 
-        // Write the updated data back to file
-        std::ofstream outFile(getAuthFilePath());
-        if (!outFile.is_open()) {
-            std::cerr << "Failed to open auth file for writing" << std::endl;
-            return false;
-        }
-        
-        for (const auto& l : lines) {
-            outFile << l << std::endl;
+            // Update the in-memory data structure and journal the change
+            it->second = newPassword;
         }
+        journalUser(username);
+        commitJournal();
         
-        // Update the in-memory data structure
-        usernamePasswords[username] = newPassword;
-        
-        std::cerr << "Password successfully changed for username: " << username << std::endl;
+        errors << "Password successfully changed for username: " << username << std::endl;
         return true;
     } catch (const std::exception& e) {
-        std::cerr << "Exception in changePassword: " << e.what() << std::endl;
+        errors << "Exception in changePassword: " << e.what() << std::endl;
         return false;
     }
 }
 
 bool Database::usernameExists(const std::string& username) const {
-    return usernameToCustomerId.find(username) != usernameToCustomerId.end();
+    return lookupUser(username);
 }
 
 void Database::saveAll() {
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    if (!checkpoint()) {
+        throw std::runtime_error("Failed to save all data: another process checkpointed the journal "
+                                 "after this one read it; restart to checkpoint");
+    }
+}
+
+bool Database::checkpoint() {
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
     try {
-        saveCustomer(nullptr); // Save all customers
-        saveAccount(nullptr);  // Save all accounts
-        saveAuthData();
-        saveCounters();
+        // No other process can commit until the journal is truncated
+        Journal::CheckpointLock lock(journal);
+        if (!journal.startsWithApplied()) {
+            // The snapshot files hold changes this process never saw, and
+            // writing its tables would undo them; the records it committed
+            // stay in the journal for the next process that loads
+            saveAccountSlots();
+            return false;
+        }
+        // Take in what other processes committed since this one read it
+        recoverJournal(journal.appliedBytes(), journal.appliedHash());
+
+        bool changed = dirtyTables != 0 || !dirtyAccounts.empty() || journal.getRecordCount() != 0;
+        if (lazy && !binarySnapshot && dirtyTables != 0) {
+            // Text files are written from the caches alone
+            loadAllLazily();
+            lazy = false;
+        }
+        saveAccountSlots();
+        if (binarySnapshot) {
+            if (dirtyTables != 0) {
+                saveSnapshot();
+            }
+        } else {
+            if (dirtyTables & DIRTY_CUSTOMERS) {
+                saveCustomer(nullptr); // Save all customers
+            }
+            if (dirtyTables & DIRTY_AUTH) {
+                saveAuthData();
+            }
+            if (dirtyTables & DIRTY_COUNTERS) {
+                saveCounters();
+            }
+        }
+        GroupCommitLog::syncDirectory(dataDir);
+        dirtyTables = 0;
+        freeRetiredAccounts();
+
+        // Everything in the journal is now part of the snapshot files
+        journal.reset();
+
+        if (sharedImage && changed) {
+            imageSources = SharedImage::stampFiles(snapshotFilePaths(), getAccountStorePath());
+            publishImage();
+        }
+        return true;
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to save all data: " + std::string(e.what()));
     }
@@ -500,184 +992,414 @@ void Database::saveAll() {
 
 void Database::loadAll() {
     try {
-        loadCustomers();
-        loadAccounts();
-        // loadTransactions();
-        loadAuthData();
-        loadCounters();
+        if (sharedImage) {
+            imageSources = SharedImage::stampFiles(snapshotFilePaths(), getAccountStorePath());
+        }
+        binarySnapshot = std::ifstream(getSnapshotFilePath()).is_open();
+        // Accounts come from accounts.dat once it exists, whatever the format
+        bool haveAccountStore = accountStore.open();
+        // Of several processes starting on older files, the first to get the
+        // lock migrates them; the others wait and then load its accounts.dat
+        std::unique_ptr<Journal::CheckpointLock> migrationLock;
+        if (!haveAccountStore) {
+            migrationLock = std::make_unique<Journal::CheckpointLock>(journal);
+            haveAccountStore = accountStore.open();
+        }
+        Account::setPeriodSource(accountStore.interestPeriodSource());
+        if (binarySnapshot) {
+            if (!snapshot.open(getSnapshotFilePath())) {
+                throw std::runtime_error("Failed to open " + getSnapshotFilePath());
+            }
+            lazy = haveAccountStore && snapshot.isSorted() && lazyLoadEnabled();
+            if (lazy) {
+                // Records are faulted in from the snapshot and accounts.dat on first use
+                nextCustomerId = snapshot.nextCustomerId();
+                nextAccountNumber = snapshot.nextAccountNumber();
+                return;
+            }
+            loadSnapshot(!haveAccountStore);
+        } else {
+            loadCustomers();
+            if (!haveAccountStore) {
+                loadAccounts();
+            }
+            // loadTransactions();
+            loadAuthData();
+            loadCounters();
+        }
+        if (haveAccountStore) {
+            loadAccountStore();
+        } else {
+            migrateAccounts();
+        }
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to load data: " + std::string(e.what()));
     }
 }
 
+void Database::convertSnapshot(bool binary) {
+    std::lock_guard<std::recursive_mutex> journalLock(journalMutex);
+    if (lazy && !binary) {
+        loadAllLazily();
+        lazy = false;
+        std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+        snapshot.close();
+    }
+    binarySnapshot = binary;
+    dirtyTables = DIRTY_ALL;
+    saveAll();
+    // Only once the new format is durable
+    if (binary) {
+        removeTextSnapshot();
+    } else {
+        std::remove(getSnapshotFilePath().c_str());
+    }
+    GroupCommitLog::syncDirectory(dataDir);
+    if (sharedImage) {
+        // The image published by saveAll() still names the removed files
+        imageSources = SharedImage::stampFiles(snapshotFilePaths(), getAccountStorePath());
+        publishImage();
+    }
+}
+
 void Database::saveCustomer(const Customer* customer) {
     (void)customer; // Suppress unused parameter warning
     try {
-        std::ofstream file(getCustomerFilePath());
+        std::string tempPath = getCustomerFilePath() + ".tmp";
+        std::ofstream file(tempPath);
         if (!file.is_open()) {
             throw std::runtime_error("Failed to open customer file for writing");
         }
         
-        for (const auto& pair : customers) {
-            int id = pair.first;
-            const Customer* cust = pair.second.get();
-            file << id << ":" << cust->getName() << ":" << cust->getPhone() << std::endl;
-        }
+        customers.forEach([&](int id, const std::unique_ptr<Customer>& cust) {
+            file << id << ":" << cust->getName() << ":" << cust->getPhone() << "\n";
+        });
+        file.close();
+        replaceFile(tempPath, getCustomerFilePath());
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to save customer data: " + std::string(e.what()));
     }
 }
 
-void Database::saveAccount(const Account* account) {
-    (void)account; // Suppress unused parameter warning
-    try {
-        std::ofstream file(getAccountFilePath());
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open account file for writing");
+void Database::saveAccountSlots() {
+    // Slots are written through at every commit, so this mostly syncs them
+    writeThroughSlots();
+    // Processes sharing an image also rely on each other's unsynced writes
+    if (!dirtyAccounts.empty() || sharedImage) {
+        accountStore.sync();
+        dirtyAccounts.clear();
+    }
+}
+
+void Database::writeThroughSlots() {
+    // Changed and new accounts get their current state, removed ones a free
+    // slot; a slot another process has since moved past is left alone
+    for (int number : unwrittenSlots) {
+        Account* account = findAccount(number);
+        balanceVersions.update(number, [&](uint64_t& version) {
+            if (!account) {
+                accountStore.release(number);
+                return;
+            }
+            AccountStore::Slot current;
+            AccountStore::Slot slot = makeSlot(account, version);
+            if (!accountStore.read(number, current) || current.version < slot.version) {
+                accountStore.write(slot);
+            }
+        });
+    }
+    unwrittenSlots.clear();
+}
+
+void Database::writeAccountSlot(const Account* account) {
+    balanceVersions.update(account->getAccountNumber(), [&](uint64_t& version) {
+        // A change that lost the race with closing the account must not
+        // bring back a slot its removal released
+        if (!account->isClosed()) {
+            accountStore.write(makeSlot(account, ++version));
         }
-        
-        for (const auto& pair : accounts) {
-            int number = pair.first;
-            Account* acc = pair.second;
-            file << number << ":" << acc->getOwner()->getId() << ":" 
-                 << acc->getBalance() << ":" << static_cast<int>(acc->getType()) << std::endl;
+    });
+    // Shared with the threads writing other accounts' slots meanwhile
+    accountStore.syncWrites();
+}
+
+void Database::writeSlotsInBulk(const std::vector<Account*>& changed) {
+    // No other process can have moved these slots on, so unlike
+    // writeThroughSlots() nothing is read back first
+    std::vector<AccountStore::Slot> slots;
+    std::vector<const Account*> written;
+    slots.reserve(changed.size());
+    written.reserve(changed.size());
+    for (const Account* account : changed) {
+        balanceVersions.update(account->getAccountNumber(), [&](uint64_t& version) {
+            // A closed account's slot is released by its removal
+            if (!account->isClosed()) {
+                slots.push_back(makeSlot(account, version));
+                written.push_back(account);
+            }
+        });
+    }
+    // Slots in between go back as read, so savings accounts (which month-end
+    // leaves alone) do not split the writes up
+    std::vector<AccountStore::Slot> gaps;
+    accountStore.write(slots, &gaps);
+
+    for (size_t i = 0; i < slots.size(); i++) {
+        // A change this process made meanwhile may have been overwritten
+        balanceVersions.update(slots[i].number, [&](uint64_t& version) {
+            if (version != slots[i].version && !written[i]->isClosed()) {
+                accountStore.write(makeSlot(written[i], version));
+            }
+        });
+        unwrittenSlots.erase(slots[i].number);
+    }
+    for (const AccountStore::Slot& gap : gaps) {
+        // Likewise for a slot written back as read; new and removed
+        // accounts' slots change only under the journal lock, held here
+        uint64_t version = 0;
+        Account* account = nullptr;
+        if (!balanceVersions.get(gap.number, version) || version <= gap.version ||
+            !accounts.get(gap.number, account) || !account) {
+            continue;
         }
-    } catch (const std::exception& e) {
-        throw std::runtime_error("Failed to save account data: " + std::string(e.what()));
+        balanceVersions.update(gap.number, [&](uint64_t& current) {
+            if (!account->isClosed()) {
+                accountStore.write(makeSlot(account, current));
+            }
+        });
     }
 }
 
+AccountStore::Slot Database::makeSlot(const Account* account, uint64_t version) const {
+    AccountStore::Slot slot{};
+    slot.number = account->getAccountNumber();
+    slot.ownerId = account->getOwner()->getId();
+    uint32_t period;
+    slot.balance = account->getBalance(period).toMinor();
+    slot.type = static_cast<int32_t>(account->getType());
+    slot.state = AccountStore::OPEN;
+    slot.accruedPeriod = static_cast<uint16_t>(period);
+    slot.version = version;
+    return slot;
+}
+
+uint64_t Database::nextBalanceVersion(int accountNumber) {
+    return balanceVersions.update(accountNumber, [](uint64_t& version) { return ++version; });
+}
+
 void Database::saveTransaction(const Account* account, const ITransaction* transaction) {
     try {
         // Ensure the data directory exists
         createDataDirectory();
-        
-        // Open file in append mode
-        std::ofstream file(getTransactionFilePath(), std::ios::app);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open transaction file for writing");
-        }
-
-        if (static_cast<int>(transaction->getType()) == 2) {
-            saveTransferTransaction(transaction);
-            return;
-        }
-        
-        file << account->getAccountNumber() << ":" 
-             << transaction->getTimestamp() << ":"
-             << static_cast<int>(transaction->getType()) << ":"
-             << transaction->getAmount() << std::endl;
-             
-        if (!file.good()) {
-            throw std::runtime_error("Failed to write transaction data");
-        }
+        appendHistory(historyLines(account, transaction));
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to save transaction: " + std::string(e.what()));
     }
 }
 
-void Database::saveTransferTransaction(const ITransaction* transaction) {
-    std::ofstream file(getTransactionFilePath(), std::ios::app);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open transaction file for writing");
-    }
+std::vector<std::pair<int, std::string>> Database::historyLines(const Account* account,
+                                                                const ITransaction* transaction) const {
+    std::vector<std::pair<int, std::string>> lines;
     const Transfer* transfer = dynamic_cast<const Transfer*>(transaction);
+    std::string prefix = ":" + transaction->getTimestamp() + ":" +
+                         std::to_string(static_cast<int>(transaction->getType())) + ":";
+    if (!transfer) {
+        lines.emplace_back(account->getAccountNumber(),
+                           std::to_string(account->getAccountNumber()) + prefix +
+                           transaction->getAmount().toString() + "\n");
+        return lines;
+    }
 
     //save in format accountNumber:timestamp:type:amount:toAccountNumber
-    file << transfer->getFromAccount() << ":"
-         << transaction->getTimestamp() << ":"
-         << static_cast<int>(transaction->getType()) << ":"
-         << (-1 * transaction->getAmount()) << ":"
-         << transfer->getToAccount() << std::endl;
+    std::string fromLine = std::to_string(transfer->getFromAccount()) + prefix +
+                           (-transaction->getAmount()).toString() + ":" +
+                           std::to_string(transfer->getToAccount()) + "\n";
+    std::string toLine = std::to_string(transfer->getToAccount()) + prefix +
+                         transaction->getAmount().toString() + ":" +
+                         std::to_string(transfer->getFromAccount()) + "\n";
+
+    lines.emplace_back(transfer->getFromAccount(), std::move(fromLine));
+    lines.emplace_back(transfer->getToAccount(), std::move(toLine));
+    return lines;
+}
 
-    file << transfer->getToAccount() << ":"
-         << transaction->getTimestamp() << ":"
-         << static_cast<int>(transaction->getType()) << ":"
-         << transaction->getAmount() << ":"
-         << transfer->getFromAccount() << std::endl;
+void Database::appendHistory(const std::vector<std::pair<int, std::string>>& lines) {
+    // One append, so the lines (both sides of a transfer, say) are never
+    // split across batches; blocks until they are durable, sharing the sync
+    // with concurrent writers
+    std::string text;
+    for (const auto& line : lines) {
+        text += line.second;
+    }
+    if (text.empty()) {
+        return;
+    }
+    uint64_t offset = transactionLog.append(text);
+    for (const auto& line : lines) {
+        transactionIndex.record(line.first, offset, line.second.size());
+        offset += line.second.size();
+    }
+    rotateHistory();
+}
+
+void Database::saveClosure(int accountNumber) {
+    auto now = std::chrono::system_clock::now();
+    auto now_time_t = std::chrono::system_clock::to_time_t(now);
+    std::tm local = localTime(now_time_t);
+    std::stringstream ss;
+    ss << accountNumber << ":"
+       << std::put_time(&local, "%Y-%m-%d %H-%M-%S") << ":"
+       << TransactionIndex::CLOSED_TYPE << "\n";
+
+    std::string text = ss.str();
+    uint64_t offset = transactionLog.append(text);
+    transactionIndex.record(accountNumber, offset, text.size());
+    compactor.noteClosure();
+    rotateHistory();
+}
+
+void Database::rotateHistory() {
+    if (transactionIndex.needsSeal()) {
+        transactionIndex.seal(transactionLog);
+    }
 }
 
 void Database::loadCustomers() {
-    std::ifstream file(getCustomerFilePath());
-    if (!file.is_open()) {
+    std::string contents;
+    if (!ParallelLoader::readFile(getCustomerFilePath(), contents)) {
         return;
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string id, name, phone;
-        std::getline(ss, id, ':');
-        std::getline(ss, name, ':');
-        std::getline(ss, phone);
-        
-        auto customer = std::make_unique<Customer>(std::stoi(id), name, phone);
-        customers[customer->getId()] = std::move(customer);
+    // Parse chunks in parallel, then index them in file order
+    std::vector<std::string_view> chunks = ParallelLoader::splitLines(contents, loader.chunkCount(contents.size()));
+    std::vector<std::vector<std::unique_ptr<Customer>>> parsed(chunks.size());
+    loader.run(chunks.size(), [&](size_t i) {
+        forEachLine(chunks[i], [&](std::string_view line) {
+            RecordTokenizer fields(line);
+            int id = RecordTokenizer::toInt(fields.next());
+            std::string_view name = fields.next();
+            std::string_view phone = fields.rest();
+
+            parsed[i].push_back(std::make_unique<Customer>(id, std::string(name), std::string(phone)));
+        });
+    });
+
+    size_t total = 0;
+    for (const auto& chunk : parsed) {
+        total += chunk.size();
+    }
+    customers.reserve(total);
+    for (auto& chunk : parsed) {
+        for (auto& customer : chunk) {
+            int customerId = customer->getId();
+            customers.set(customerId, std::move(customer));
+        }
     }
 }
 
 void Database::loadAccounts() {
-    std::ifstream file(getAccountFilePath());
-    if (!file.is_open()) {
+    std::string contents;
+    if (!ParallelLoader::readFile(getAccountFilePath(), contents)) {
         std::cerr << "Failed to open account file: " << getAccountFilePath() << std::endl;
         return;
     }
 
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string accountNumber, ownerId, balance, type;
-        std::getline(ss, accountNumber, ':');
-        std::getline(ss, ownerId, ':');
-        std::getline(ss, balance, ':');
-        std::getline(ss, type);
-        
-        Customer* owner = findCustomer(std::stoi(ownerId));
-        if (!owner) {
-            continue;
+    // Owners are only looked up here; they are linked to their accounts
+    // afterwards on this thread, in file order
+    std::vector<std::string_view> chunks = ParallelLoader::splitLines(contents, loader.chunkCount(contents.size()));
+    std::vector<std::vector<std::unique_ptr<Account>>> parsed(chunks.size());
+    loader.run(chunks.size(), [&](size_t i) {
+        forEachLine(chunks[i], [&](std::string_view line) {
+            // Blank lines are the free slots of the fixed-width layout
+            if (line.find_first_not_of(' ') == std::string_view::npos) {
+                return;
+            }
+
+            RecordTokenizer fields(line);
+            int accountNumber = RecordTokenizer::toInt(fields.next());
+            int ownerId = RecordTokenizer::toInt(fields.next());
+            Money balance = Money::parse(fields.next());
+            int type = RecordTokenizer::toInt(fields.rest());
+
+            Customer* owner = findCustomer(ownerId);
+            if (!owner) {
+                return;
+            }
+            std::unique_ptr<Account> account = makeAccount(accountNumber, balance, owner, type, 0);
+            if (account) {
+                parsed[i].push_back(std::move(account));
+            }
+        });
+    });
+
+    for (auto& chunk : parsed) {
+        for (auto& account : chunk) {
+            linkAccount(std::move(account), 0);
         }
-        
-        std::unique_ptr<Account> account;
-        switch (std::stoi(type)) {
-            case static_cast<int>(AccountType::SAVINGS):
-                account = std::make_unique<SavingsAccount>(
-                    std::stoi(accountNumber),
-                    std::stod(balance),
-                    owner,
-                    SavingsAccount::getDefaultInterestRate(),
-                    AccountType::SAVINGS
-                );
-                break;
-            case static_cast<int>(AccountType::CURRENT):
-                account = std::make_unique<CurrentAccount>(
-                    std::stoi(accountNumber),
-                    std::stod(balance),
-                    owner
-                );
-                break;
-            case static_cast<int>(AccountType::AUDITABLE_SAVINGS):
-                account = std::make_unique<AuditableSavingsAccount>(
-                    std::stoi(accountNumber),
-                    std::stod(balance),
-                    owner
-                );
-                break;
-            default:
+    }
+}
+
+void Database::loadAccountStore() {
+    std::vector<AccountStore::Slot> slots = accountStore.readAll();
+    accounts.reserve(slots.size());
+    balanceVersions.reserve(slots.size());
+
+    size_t chunkCount = loader.chunkCount(slots.size() * AccountStore::SLOT_SIZE);
+    size_t perChunk = slots.size() / chunkCount + 1;
+    std::vector<std::vector<std::unique_ptr<Account>>> parsed(chunkCount);
+    loader.run(chunkCount, [&](size_t i) {
+        size_t end = std::min(slots.size(), (i + 1) * perChunk);
+        for (size_t j = i * perChunk; j < end; j++) {
+            const AccountStore::Slot& slot = slots[j];
+            Customer* owner = findCustomer(slot.ownerId);
+            if (!owner) {
                 continue;
+            }
+            std::unique_ptr<Account> account =
+                makeAccount(slot.number, Money::fromMinor(slot.balance), owner, slot.type, slot.accruedPeriod);
+            if (account) {
+                parsed[i].push_back(std::move(account));
+            }
+        }
+    });
+
+    // Slots are in account-number order, so versions can be matched up
+    // by walking them alongside the accounts
+    size_t slotIndex = 0;
+    for (auto& chunk : parsed) {
+        for (auto& account : chunk) {
+            while (slots[slotIndex].number != account->getAccountNumber()) {
+                slotIndex++;
+            }
+            linkAccount(std::move(account), slots[slotIndex].version);
         }
-        
-        // Store the pointer BEFORE moving the account
-        Account* accountPtr = account.get();
-        int accNumber = accountPtr->getAccountNumber();
-        
-        // Add to customer's accounts (this moves the account)
-        owner->addAccount(std::move(account));
-        
-        // Add to accounts map
-        accounts[accNumber] = accountPtr;
     }
 }
 
+void Database::linkAccount(std::unique_ptr<Account> account, uint64_t version) {
+    Customer* owner = account->getOwner();
+    int accountNumber = account->getAccountNumber();
+    accounts.set(accountNumber, account.get());
+    balanceVersions.set(accountNumber, version);
+    owner->addAccount(std::move(account));
+}
+
+void Database::migrateAccounts() {
+    // Accounts loaded from accounts.txt or an older snapshot move to
+    // accounts.dat before anything can be written to a slot
+    std::vector<AccountStore::Slot> slots;
+    slots.reserve(accounts.size());
+    accounts.forEach([&](int number, Account* account) {
+        uint64_t version = 0;
+        balanceVersions.get(number, version);
+        slots.push_back(makeSlot(account, version));
+    });
+    accountStore.create(slots);
+    Account::setPeriodSource(accountStore.interestPeriodSource());
+    GroupCommitLog::syncDirectory(dataDir);
+    std::remove(getAccountFilePath().c_str());
+}
+
 // void Database::loadTransactions() {
 //     std::ifstream file(getTransactionFilePath());
 //     if (!file.is_open()) {
@@ -722,61 +1444,86 @@ void Database::loadAccounts() {
 // }
 
 void Database::saveAuthData() {
-    std::ofstream file(getAuthFilePath());
+    std::string tempPath = getAuthFilePath() + ".tmp";
+    std::ofstream file(tempPath);
     if (!file.is_open()) {
         throw std::runtime_error("Failed to open auth file for writing");
     }
     
     // Save customer auth data in form of customer :username : password  : customerId
-    for (const auto& pair : usernameToCustomerId) {
-        const std::string& username = pair.first;
-        int customerId = pair.second;
-        file << "CUSTOMER:" << username << ":" << usernamePasswords[username] << ":" << customerId << std::endl;
+    {
+        std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
+        for (const auto& pair : usernameToCustomerId) {
+            const std::string& username = pair.first;
+            int customerId = pair.second;
+            // at(), not [], which would insert under a shared lock
+            file << "CUSTOMER:" << username << ":" << usernamePasswords.at(username) << ":" << customerId << "\n";
+        }
     }
     
     // Save account authentication data
-    for (const auto& pair : accountPasswords) {
-        int accountNumber = pair.first;
-        const std::string& password = pair.second;
-        file << "ACCOUNT:" << accountNumber << ":" << password << std::endl;
-    }
+    accountPasswords.forEach([&](int accountNumber, const std::string& password) {
+        file << "ACCOUNT:" << accountNumber << ":" << password << "\n";
+    });
+    file.close();
+    replaceFile(tempPath, getAuthFilePath());
 }
 
 void Database::loadAuthData() {
-    std::ifstream file(getAuthFilePath());
-    if (!file.is_open()) {
+    std::string contents;
+    if (!ParallelLoader::readFile(getAuthFilePath(), contents)) {
         return;
     }
-    
-    std::string line;
-    while (std::getline(file, line)) {
-        //customer :username : password  : customerId
-        std::stringstream ss(line);
-        std::string type, username, password, customerId;
-        std::getline(ss, type, ':');
-        std::getline(ss, username, ':');
-        
-        if (type == "CUSTOMER") {
-            std::getline(ss, password, ':');
-            std::getline(ss, customerId);
-            if (!username.empty() && !customerId.empty()) {
-                usernameToCustomerId[username] = std::stoi(customerId);
-                usernamePasswords[username] = password;  // Also store the password
+
+    struct UserEntry {
+        std::string username;
+        std::string password;
+        int customerId;
+    };
+    struct AuthChunk {
+        std::vector<UserEntry> users;
+        std::vector<std::pair<int, std::string>> accountPasswords;
+    };
+
+    std::vector<std::string_view> chunks = ParallelLoader::splitLines(contents, loader.chunkCount(contents.size()));
+    std::vector<AuthChunk> parsed(chunks.size());
+    loader.run(chunks.size(), [&](size_t i) {
+        forEachLine(chunks[i], [&](std::string_view line) {
+            //customer :username : password  : customerId
+            RecordTokenizer fields(line);
+            std::string_view type = fields.next();
+            std::string_view username = fields.next();
+
+            if (type == "CUSTOMER") {
+                std::string_view password = fields.next();
+                std::string_view customerId = fields.rest();
+                if (!username.empty() && !customerId.empty()) {
+                    parsed[i].users.push_back(UserEntry{std::string(username), std::string(password),
+                                                        RecordTokenizer::toInt(customerId)});
+                }
+            } else if (type == "ACCOUNT") {
+                parsed[i].accountPasswords.emplace_back(RecordTokenizer::toInt(username), std::string(fields.rest()));
             }
-        } else if (type == "ACCOUNT") {
-            std::getline(ss, password);
-            accountPasswords[std::stoi(username)] = password;
+        });
+    });
+
+    for (auto& chunk : parsed) {
+        for (auto& user : chunk.users) {
+            usernameToCustomerId[user.username] = user.customerId;
+            usernamePasswords[user.username] = std::move(user.password);  // Also store the password
+        }
+        for (auto& entry : chunk.accountPasswords) {
+            accountPasswords.set(entry.first, std::move(entry.second));
         }
     }
 }
 
 bool Database::verifyPassword(int accountNumber, const std::string& password) {
     Database* db = getInstance();
-    auto it = db->accountPasswords.find(accountNumber);
-    if (it == db->accountPasswords.end()) {
-    return false;
-    }
-    return it->second == password;
+    db->lookupAccountPassword(accountNumber);
+    return db->accountPasswords.read(accountNumber, [&](const std::string* stored) {
+        return stored && *stored == password;
+    });
 }
 
 Account* Database::getAccount(int accountNumber) {
@@ -786,11 +1533,14 @@ Account* Database::getAccount(int accountNumber) {
 
 void Database::saveCounters() const {
     try {
-        std::ofstream file(getCounterFilePath());
+        std::string tempPath = getCounterFilePath() + ".tmp";
+        std::ofstream file(tempPath);
         if (!file.is_open()) {
             throw std::runtime_error("Failed to open counter file for writing");
         }
         file << nextCustomerId << ":" << nextAccountNumber << std::endl;
+        file.close();
+        replaceFile(tempPath, getCounterFilePath());
     } catch (const std::exception& e) {
         throw std::runtime_error("Failed to save counters: " + std::string(e.what()));
     }
@@ -808,11 +1558,11 @@ void Database::loadCounters() {
 
         std::string line;
         if (std::getline(file, line)) {
-            std::stringstream ss(line);
-            std::string customerIdStr, accountNumberStr;
-            if (std::getline(ss, customerIdStr, ':') && std::getline(ss, accountNumberStr)) {
-                nextCustomerId = std::stoi(customerIdStr);
-                nextAccountNumber = std::stoi(accountNumberStr);
+            RecordTokenizer fields(line);
+            std::string_view customerIdStr = fields.next();
+            if (fields.hasMore()) {
+                nextCustomerId = RecordTokenizer::toInt(customerIdStr);
+                nextAccountNumber = RecordTokenizer::toInt(fields.rest());
             } else {
                 throw std::runtime_error("Invalid counter file format");
             }
@@ -826,71 +1576,712 @@ void Database::loadCounters() {
     }
 }
 
+void Database::saveSnapshot() {
+    Snapshot::Writer writer;
+    fillSnapshot(writer);
+
+    std::string tempPath = getSnapshotFilePath() + ".tmp";
+    writer.write(tempPath);
+    replaceFile(tempPath, getSnapshotFilePath());
+
+    if (lazy) {
+        // The new snapshot already leaves out everything removed
+        std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+        snapshot.open(getSnapshotFilePath());
+        erasedCustomers.clear();
+        erasedUsers.clear();
+        erasedAccounts.clear();
+    }
+}
+
+void Database::fillSnapshot(Snapshot::Writer& writer) {
+    if (lazy) {
+        // Records never faulted in are copied over from the mapped snapshot
+        for (size_t i = 0; i < snapshot.customerCount(); i++) {
+            const Snapshot::CustomerRecord& record = snapshot.customer(i);
+            if (!customers.contains(record.id) && !erasedCustomers.count(record.id)) {
+                writer.addCustomer(record.id, snapshot.text(record.name), snapshot.text(record.phone),
+                                   snapshot.customerAccounts(i));
+            }
+        }
+        for (size_t i = 0; i < snapshot.userCount(); i++) {
+            const Snapshot::UserRecord& record = snapshot.user(i);
+            std::string username(snapshot.text(record.username));
+            std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
+            if (!usernameToCustomerId.count(username) && !erasedUsers.count(username)) {
+                writer.addUser(username, record.customerId, snapshot.text(record.password));
+            }
+        }
+        for (size_t i = 0; i < snapshot.accountAuthCount(); i++) {
+            const Snapshot::AccountAuthRecord& record = snapshot.accountAuth(i);
+            if (!accountPasswords.contains(record.accountNumber) && !erasedAccounts.count(record.accountNumber)) {
+                writer.addAccountPassword(record.accountNumber, snapshot.text(record.password));
+            }
+        }
+    }
+    customers.forEach([&](int id, const std::unique_ptr<Customer>& customer) {
+        std::vector<int> accountNumbers;
+        for (const auto& account : customer->getAccounts()) {
+            accountNumbers.push_back(account->getAccountNumber());
+        }
+        writer.addCustomer(id, customer->getName(), customer->getPhone(), accountNumbers);
+    });
+    // Balances live in accounts.dat
+    {
+        std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
+        for (const auto& pair : usernameToCustomerId) {
+            writer.addUser(pair.first, pair.second, usernamePasswords.at(pair.first));
+        }
+    }
+    accountPasswords.forEach([&](int accountNumber, const std::string& password) {
+        writer.addAccountPassword(accountNumber, password);
+    });
+    writer.setCounters(nextCustomerId, nextAccountNumber);
+}
+
+void Database::loadSnapshot(bool withAccounts) {
+    // Eager load of the snapshot mapped by loadAll()
+
+    customers.reserve(snapshot.customerCount());
+    for (size_t i = 0; i < snapshot.customerCount(); i++) {
+        const Snapshot::CustomerRecord& record = snapshot.customer(i);
+        customers.set(record.id, std::make_unique<Customer>(record.id, std::string(snapshot.text(record.name)),
+                                                            std::string(snapshot.text(record.phone))));
+    }
+
+    // Written by versions that kept accounts in the snapshot
+    for (size_t i = 0; withAccounts && i < snapshot.accountCount(); i++) {
+        const Snapshot::AccountRecord& record = snapshot.account(i);
+        Customer* owner = findCustomer(record.ownerId);
+        if (!owner) {
+            continue;
+        }
+        std::unique_ptr<Account> account = makeAccount(record.number, Money::fromDouble(record.balance), owner, record.type, 0);
+        if (!account) {
+            continue;
+        }
+        accounts.set(record.number, account.get());
+        owner->addAccount(std::move(account));
+    }
+
+    usernameToCustomerId.reserve(snapshot.userCount());
+    usernamePasswords.reserve(snapshot.userCount());
+    for (size_t i = 0; i < snapshot.userCount(); i++) {
+        const Snapshot::UserRecord& record = snapshot.user(i);
+        std::string username(snapshot.text(record.username));
+        usernameToCustomerId[username] = record.customerId;
+        usernamePasswords[username] = std::string(snapshot.text(record.password));
+    }
+
+    accountPasswords.reserve(snapshot.accountAuthCount());
+    for (size_t i = 0; i < snapshot.accountAuthCount(); i++) {
+        const Snapshot::AccountAuthRecord& record = snapshot.accountAuth(i);
+        accountPasswords.set(record.accountNumber, std::string(snapshot.text(record.password)));
+    }
+
+    nextCustomerId = snapshot.nextCustomerId();
+    nextAccountNumber = snapshot.nextAccountNumber();
+
+    // Older snapshots are rewritten sorted at the next checkpoint
+    if (!snapshot.isSorted()) {
+        dirtyTables |= DIRTY_ALL;
+    }
+    snapshot.close();
+}
+
+void Database::loadAllLazily() {
+    for (size_t i = 0; i < snapshot.customerCount(); i++) {
+        findCustomer(snapshot.customer(i).id);
+    }
+    for (size_t i = 0; i < snapshot.userCount(); i++) {
+        lookupUser(std::string(snapshot.text(snapshot.user(i).username)));
+    }
+    for (size_t i = 0; i < snapshot.accountAuthCount(); i++) {
+        lookupAccountPassword(snapshot.accountAuth(i).accountNumber);
+    }
+}
+
+Customer* Database::faultCustomer(int customerId) const {
+    // The caller holds snapshotMutex shared
+    size_t index;
+    if (erasedCustomers.count(customerId) || !snapshot.findCustomer(customerId, index)) {
+        return nullptr;
+    }
+    // Under the shard's lock, so two threads cannot both fault it in
+    return customers.update(customerId, [&](std::unique_ptr<Customer>& cached) {
+        if (cached) {
+            return cached.get();
+        }
+        const Snapshot::CustomerRecord& record = snapshot.customer(index);
+        cached = std::make_unique<Customer>(customerId, std::string(snapshot.text(record.name)),
+                                            std::string(snapshot.text(record.phone)));
+        Customer* owner = cached.get();
+
+        // Accounts come with their owner, so its account list is complete
+        for (int number : snapshot.customerAccounts(index)) {
+            AccountStore::Slot slot;
+            if (erasedAccounts.count(number) || accounts.contains(number) ||
+                !accountStore.read(number, slot) || slot.ownerId != customerId) {
+                continue;
+            }
+            std::unique_ptr<Account> account = makeAccount(number, Money::fromMinor(slot.balance), owner, slot.type, slot.accruedPeriod);
+            if (!account) {
+                continue;
+            }
+            accounts.set(number, account.get());
+            balanceVersions.set(number, slot.version);
+            owner->addAccount(std::move(account));
+        }
+        return owner;
+    });
+}
+
+bool Database::lookupUser(const std::string& username) const {
+    {
+        std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
+        if (usernameToCustomerId.count(username)) {
+            return true;
+        }
+    }
+    if (!lazy) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+    size_t index;
+    if (erasedUsers.count(username) || !snapshot.findUser(username, index)) {
+        return false;
+    }
+    const Snapshot::UserRecord& record = snapshot.user(index);
+    std::unique_lock<std::shared_mutex> usernameLock(usernameMutex);
+    // Another thread may have cached it, or changed its password, meanwhile
+    if (usernameToCustomerId.emplace(username, record.customerId).second) {
+        usernamePasswords[username] = std::string(snapshot.text(record.password));
+    }
+    return true;
+}
+
+bool Database::lookupAccountPassword(int accountNumber) const {
+    if (accountPasswords.contains(accountNumber)) {
+        return true;
+    }
+    if (!lazy) {
+        return false;
+    }
+    std::shared_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+    size_t index;
+    if (erasedAccounts.count(accountNumber) || !snapshot.findAccountAuth(accountNumber, index)) {
+        return false;
+    }
+    accountPasswords.insert(accountNumber, std::string(snapshot.text(snapshot.accountAuth(index).password)));
+    return true;
+}
+
+std::string Database::usernameOf(int customerId) const {
+    {
+        std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
+        for (const auto& pair : usernameToCustomerId) {
+            if (pair.second == customerId) {
+                return pair.first;
+            }
+        }
+    }
+    if (!lazy) {
+        return "";
+    }
+    // Usernames are sorted by name, not customer, so this one is a scan
+    std::string username;
+    {
+        std::shared_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+        for (size_t i = 0; i < snapshot.userCount() && username.empty(); i++) {
+            const Snapshot::UserRecord& record = snapshot.user(i);
+            if (record.customerId == customerId) {
+                username = std::string(snapshot.text(record.username));
+            }
+        }
+    }
+    return !username.empty() && lookupUser(username) ? username : "";
+}
+
+void Database::removeTextSnapshot() {
+    std::remove(getCustomerFilePath().c_str());
+    std::remove(getAccountFilePath().c_str());
+    std::remove(getAuthFilePath().c_str());
+    std::remove(getCounterFilePath().c_str());
+}
+
+std::vector<std::string> Database::snapshotFilePaths() const {
+    // The binary snapshot comes first; attachImage() relies on it
+    return {getSnapshotFilePath(), getCustomerFilePath(), getAuthFilePath(), getCounterFilePath()};
+}
+
 int Database::getNextCustomerId() {
     Database* db = getInstance();
+    std::lock_guard<std::recursive_mutex> journalLock(db->journalMutex);
     return db->nextCustomerId;
 }
 
 int Database::getNextAccountNumber() {
     Database* db = getInstance();
+    std::lock_guard<std::recursive_mutex> journalLock(db->journalMutex);
     return db->nextAccountNumber;
 }
 
 void Database::incrementCustomerId() {
     Database* db = getInstance();
+    std::lock_guard<std::recursive_mutex> journalLock(db->journalMutex);
     db->nextCustomerId++;
-    db->saveCounters();
+    db->journalCounters();
+    db->commitJournal();
 }
 
 void Database::incrementAccountNumber() {
     Database* db = getInstance();
+    std::lock_guard<std::recursive_mutex> journalLock(db->journalMutex);
     db->nextAccountNumber++;
-    db->saveCounters();
+    db->journalCounters();
+    db->commitJournal();
+}
+
+int Database::takeCustomerId() {
+    Database* db = getInstance();
+    std::lock_guard<std::recursive_mutex> journalLock(db->journalMutex);
+    int customerId = db->nextCustomerId;
+    incrementCustomerId();
+    return customerId;
+}
+
+int Database::takeAccountNumber() {
+    Database* db = getInstance();
+    std::lock_guard<std::recursive_mutex> journalLock(db->journalMutex);
+    int accountNumber = db->nextAccountNumber;
+    incrementAccountNumber();
+    return accountNumber;
 }
 
 
-std::unique_ptr<Account> Database::createSavingsAccount(int customerId, double initialBalance) {
+std::unique_ptr<Account> Database::createSavingsAccount(int customerId, Money initialBalance) {
     Customer* customer = findCustomer(customerId);
     if (!customer) {
         throw std::runtime_error("Customer not found");
     }
     
-    int accountNumber = getNextAccountNumber();
-    incrementAccountNumber();
+    int accountNumber = takeAccountNumber();
     return std::make_unique<SavingsAccount>(accountNumber, initialBalance, customer, SavingsAccount::getDefaultInterestRate(), AccountType::SAVINGS);
 }
 
-std::unique_ptr<Account> Database::createCurrentAccount(int customerId, double initialBalance) {
+std::unique_ptr<Account> Database::createCurrentAccount(int customerId, Money initialBalance) {
     Customer* customer = findCustomer(customerId);
     if (!customer) {
         throw std::runtime_error("Customer not found");
     }
     
-    int accountNumber = getNextAccountNumber();
-    incrementAccountNumber();
+    int accountNumber = takeAccountNumber();
     return std::make_unique<CurrentAccount>(accountNumber, initialBalance, customer);
 }
 
-std::unique_ptr<Account> Database::createAuditableSavingsAccount(int customerId, double initialBalance) {
+std::unique_ptr<Account> Database::createAuditableSavingsAccount(int customerId, Money initialBalance) {
     Customer* customer = findCustomer(customerId);
     if (!customer) {
         throw std::runtime_error("Customer not found");
     }
     
-    int accountNumber = getNextAccountNumber();
-    incrementAccountNumber();
+    int accountNumber = takeAccountNumber();
     return std::make_unique<AuditableSavingsAccount>(accountNumber, initialBalance, customer);
 }
 
 int Database::getCustomerIdByUsername(const std::string& username) const {
+    lookupUser(username);
+    std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
     auto it = usernameToCustomerId.find(username);
     return it != usernameToCustomerId.end() ? it->second : -1;
 }
 
+void Database::replaceFile(const std::string& tempPath, const std::string& path) const {
+    // The data must be on disk before the rename makes it the snapshot
+    GroupCommitLog::syncFile(tempPath);
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    if (std::rename(tempPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to replace " + path);
+    }
+}
+
+void Database::journalCustomer(const Customer* customer) {
+    journalRecord("CUSTOMER:" + std::to_string(customer->getId()) + ":" +
+                   customer->getName() + ":" + customer->getPhone());
+}
+
+void Database::journalAccount(const Account* account) {
+    uint64_t version = nextBalanceVersion(account->getAccountNumber());
+    uint32_t period;
+    Money balance = account->getBalance(period);
+    journalRecord("ACCOUNT:" + std::to_string(account->getAccountNumber()) + ":" +
+                   std::to_string(account->getOwner()->getId()) + ":" +
+                   balance.toString() + ":" +
+                   std::to_string(static_cast<int>(account->getType())) + ":" + std::to_string(version) + ":" +
+                   std::to_string(period));
+}
+
+void Database::journalBalance(const Account* account) {
+    std::string record;
+    balanceVersions.update(account->getAccountNumber(), [&](uint64_t& version) {
+        uint32_t period;
+        Money balance = account->getBalance(period);
+        record = "BALANCE:" + std::to_string(account->getAccountNumber()) + ":" + balance.toString() + ":" +
+                 std::to_string(++version) + ":" + std::to_string(period);
+    });
+    journalRecord(record);
+}
+
+void Database::journalUser(const std::string& username) {
+    std::shared_lock<std::shared_mutex> usernameLock(usernameMutex);
+    // Password last so it may contain the separator
+    journalRecord("USER:" + username + ":" + std::to_string(usernameToCustomerId.at(username)) + ":" +
+                   usernamePasswords.at(username));
+}
+
+void Database::journalCounters() {
+    journalRecord("COUNTERS:" + std::to_string(nextCustomerId) + ":" + std::to_string(nextAccountNumber));
+}
+
+void Database::journalRecord(const std::string& record) {
+    journal.append(record);
+    markDirty(record);
+}
+
+void Database::markDirty(const std::string& record) {
+    RecordTokenizer fields(record);
+    std::string_view kind = fields.next();
+    std::string_view tail = fields.rest();
+    auto accountNumber = [&]() { return RecordTokenizer::toInt(tail); };
+
+    // Balances and the interest period reach other processes through
+    // accounts.dat; everything else needs a new shared image
+    if (kind != "BALANCE" && kind != "PERIOD") {
+        imageStale = true;
+    }
+
+    if (kind == "CUSTOMER") {
+        dirtyTables |= DIRTY_CUSTOMERS;
+    } else if (kind == "DELCUSTOMER") {
+        // Also drops the customer's login; eraseCustomer() marks its accounts
+        dirtyTables |= DIRTY_CUSTOMERS | DIRTY_AUTH;
+    } else if (kind == "ACCOUNT" || kind == "BALANCE") {
+        markAccountDirty(accountNumber());
+        if (kind == "ACCOUNT" && binarySnapshot) {
+            dirtyTables |= DIRTY_CUSTOMERS;  // the binary snapshot lists each customer's accounts
+        }
+    } else if (kind == "DELACCOUNT") {
+        markAccountDirty(accountNumber());
+        dirtyTables |= DIRTY_AUTH;
+        if (binarySnapshot) {
+            dirtyTables |= DIRTY_CUSTOMERS;
+        }
+    } else if (kind == "USER" || kind == "ACCOUNTAUTH") {
+        dirtyTables |= DIRTY_AUTH;
+    } else if (kind == "COUNTERS") {
+        dirtyTables |= DIRTY_COUNTERS;
+    }
+}
+
+void Database::commitJournal() {
+    journal.commit();
+    writeThroughSlots();
+    if (journal.getRecordCount() >= CHECKPOINT_THRESHOLD) {
+        checkpoint();
+    } else if (sharedImage) {
+        refreshImage();
+    }
+}
+
+void Database::recoverJournal(uint64_t from, uint64_t prefixHash) {
+    // Records hold absolute values, so replaying them over a snapshot that
+    // already contains some of them (a crash mid-checkpoint) is harmless
+    std::vector<std::string> records = journal.readCommitted(from, prefixHash);
+    for (const auto& record : records) {
+        try {
+            applyJournalRecord(record);
+        } catch (const std::exception& e) {
+            throw std::runtime_error("Failed to replay journal record '" + record + "': " + e.what());
+        }
+    }
+}
+
+void Database::applyJournalRecord(const std::string& record) {
+    // Replayed changes are not in the snapshot files until the next checkpoint
+    markDirty(record);
+
+    RecordTokenizer fields(record);
+    std::string_view kind = fields.next();
+
+    if (kind == "CUSTOMER") {
+        int customerId = RecordTokenizer::toInt(fields.next());
+        std::string name(fields.next());
+        std::string phone(fields.rest());
+        findCustomer(customerId);
+        customers.update(customerId, [&](std::unique_ptr<Customer>& customer) {
+            if (customer) {
+                customer->setName(name);
+                customer->setPhone(phone);
+            } else {
+                customer = std::make_unique<Customer>(customerId, name, phone);
+            }
+        });
+    } else if (kind == "DELCUSTOMER") {
+        eraseCustomer(RecordTokenizer::toInt(fields.rest()));
+    } else if (kind == "ACCOUNT") {
+        int accountNumber = RecordTokenizer::toInt(fields.next());
+        int ownerId = RecordTokenizer::toInt(fields.next());
+        std::string_view balance = fields.next();
+        int type = RecordTokenizer::toInt(fields.next());
+        std::string_view version = fields.next();
+        std::string_view period = fields.rest();
+        if (Account* existing = findAccount(accountNumber)) {
+            applyJournaledBalance(existing, balance, version, period);
+            return;
+        }
+        Customer* owner = findCustomer(ownerId);
+        if (!owner) {
+            throw std::runtime_error("Owner not found");
+        }
+        // The slot may hold a later balance that could not be loaded
+        // before its owner was replayed
+        Money openingBalance = Money::parse(balance);
+        uint64_t openingVersion = version.empty() ? 0 : RecordTokenizer::toUnsigned(version);
+        uint32_t openingPeriod = journaledPeriod(period);
+        AccountStore::Slot slot;
+        if (accountStore.read(accountNumber, slot) && slot.version > openingVersion) {
+            openingBalance = Money::fromMinor(slot.balance);
+            openingVersion = slot.version;
+            openingPeriod = slot.accruedPeriod;
+        }
+        std::unique_ptr<Account> account = makeAccount(accountNumber, openingBalance, owner, type, openingPeriod);
+        if (!account) {
+            throw std::runtime_error("Unknown account type");
+        }
+        accounts.set(accountNumber, account.get());
+        balanceVersions.set(accountNumber, openingVersion);
+        customers.update(ownerId, [&](std::unique_ptr<Customer>&) {
+            owner->addAccount(std::move(account));
+        });
+    } else if (kind == "DELACCOUNT") {
+        eraseAccount(RecordTokenizer::toInt(fields.rest()));
+    } else if (kind == "BALANCE") {
+        int accountNumber = RecordTokenizer::toInt(fields.next());
+        std::string_view balance = fields.next();
+        std::string_view version = fields.next();
+        std::string_view period = fields.rest();
+        if (Account* account = findAccount(accountNumber)) {
+            applyJournaledBalance(account, balance, version, period);
+        }
+    } else if (kind == "PERIOD") {
+        // Month-end stores the period in accounts.dat right after committing
+        // it; a crash in between leaves that to replay
+        uint32_t period = journaledPeriod(fields.rest());
+        if (period > *accountStore.interestPeriodSource()) {
+            accountStore.setInterestPeriod(period);
+        }
+    } else if (kind == "USER") {
+        std::string username(fields.next());
+        int customerId = RecordTokenizer::toInt(fields.next());
+        {
+            std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+            erasedUsers.erase(username);
+        }
+        std::unique_lock<std::shared_mutex> usernameLock(usernameMutex);
+        usernameToCustomerId[username] = customerId;
+        usernamePasswords[username] = std::string(fields.rest());
+    } else if (kind == "ACCOUNTAUTH") {
+        int accountNumber = RecordTokenizer::toInt(fields.next());
+        accountPasswords.set(accountNumber, std::string(fields.rest()));
+    } else if (kind == "COUNTERS") {
+        nextCustomerId = RecordTokenizer::toInt(fields.next());
+        nextAccountNumber = RecordTokenizer::toInt(fields.rest());
+    } else {
+        throw std::runtime_error("Unknown record type");
+    }
+}
+
+uint32_t Database::journaledPeriod(std::string_view period) {
+    // Records from before lazy interest carry none; no month-end had
+    // advanced the period then
+    return period.empty() ? 0 : static_cast<uint32_t>(RecordTokenizer::toUnsigned(period));
+}
+
+void Database::applyJournaledBalance(Account* account, std::string_view balance, std::string_view version,
+                                     std::string_view period) {
+    // Records from before versioning carry none and always apply
+    uint64_t journaled = version.empty() ? 0 : RecordTokenizer::toUnsigned(version);
+    balanceVersions.update(account->getAccountNumber(), [&](uint64_t& current) {
+        if (!version.empty()) {
+            if (journaled <= current) {
+                return;  // the slot was written after this record
+            }
+            current = journaled;
+        }
+        account->updateBalance(Money::parse(balance), journaledPeriod(period));
+    });
+}
+
+std::unique_ptr<Account> Database::makeAccount(int accountNumber, Money balance, Customer* owner, int type,
+                                               uint32_t period) {
+    std::unique_ptr<Account> account;
+    switch (type) {
+        case static_cast<int>(AccountType::SAVINGS):
+            account = std::make_unique<SavingsAccount>(
+                accountNumber,
+                balance,
+                owner,
+                SavingsAccount::getDefaultInterestRate(),
+                AccountType::SAVINGS
+            );
+            break;
+        case static_cast<int>(AccountType::CURRENT):
+            account = std::make_unique<CurrentAccount>(accountNumber, balance, owner);
+            break;
+        case static_cast<int>(AccountType::AUDITABLE_SAVINGS):
+            account = std::make_unique<AuditableSavingsAccount>(accountNumber, balance, owner);
+            break;
+        default:
+            return nullptr;
+    }
+    // Loaded balances are as of the period they were stored in
+    account->updateBalance(balance, period);
+    return account;
+}
+
+void Database::eraseAccount(int accountNumber) {
+    Account* account = findAccount(accountNumber);
+    if (lazy) {
+        std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+        erasedAccounts.insert(accountNumber);
+    }
+    if (account) {
+        Customer* owner = account->getOwner();
+        accounts.erase(accountNumber);
+        // The customer owns the Account object, so this must come last
+        if (owner) {
+            std::unique_ptr<Account> removed;
+            customers.update(owner->getId(), [&](std::unique_ptr<Customer>&) {
+                removed = owner->takeAccount(accountNumber);
+            });
+            if (removed) {
+                std::lock_guard<std::mutex> lock(retiredMutex);
+                retiredAccounts.push_back(std::move(removed));
+            }
+            freeRetiredAccounts();
+        }
+    }
+    accountPasswords.erase(accountNumber);
+}
+
+void Database::freeRetiredAccounts() {
+    // Anyone who finds no access in flight here looks the account up after
+    // it left the maps, so cannot find it
+    std::lock_guard<std::mutex> lock(retiredMutex);
+    if (unlockedAccesses.load() == 0) {
+        retiredAccounts.clear();
+    }
+}
+
+void Database::eraseCustomer(int customerId) {
+    Customer* customer = findCustomer(customerId);
+    if (!customer) {
+        return;
+    }
+
+    // Drop index entries for any accounts still owned by the customer
+    std::vector<int> accountNumbers;
+    for (const auto& account : customer->getAccounts()) {
+        accountNumbers.push_back(account->getAccountNumber());
+    }
+    for (int accountNumber : accountNumbers) {
+        accounts.erase(accountNumber);
+        accountPasswords.erase(accountNumber);
+        markAccountDirty(accountNumber);
+    }
+    std::string username = usernameOf(customerId);
+    if (lazy) {
+        std::unique_lock<std::shared_mutex> snapshotLock(snapshotMutex);
+        erasedAccounts.insert(accountNumbers.begin(), accountNumbers.end());
+        erasedCustomers.insert(customerId);
+        erasedUsers.insert(username);
+    }
+    customers.erase(customerId);
+
+    std::unique_lock<std::shared_mutex> usernameLock(usernameMutex);
+    usernameToCustomerId.erase(username);
+    usernamePasswords.erase(username);
+}
+
+void Database::markAccountDirty(int accountNumber) {
+    dirtyAccounts.insert(accountNumber);
+    unwrittenSlots.insert(accountNumber);
+}
+
+bool Database::attachImage() {
+    if (!sharedImage) {
+        return false;
+    }
+    SharedImage::Sources sources = SharedImage::stampFiles(snapshotFilePaths(), getAccountStorePath());
+    const char* data = nullptr;
+    size_t size = 0;
+    if (!sharedImage->attach(journal.getPath(), sources, data, size) || !accountStore.open()) {
+        return false;
+    }
+    Account::setPeriodSource(accountStore.interestPeriodSource());
+
+    // Read in place like a lazily loaded snapshot, balances from accounts.dat
+    snapshot.openImage(data, size, "shared image of " + dataDir);
+    binarySnapshot = sources.files[0].exists != 0;
+    lazy = true;
+    nextCustomerId = snapshot.nextCustomerId();
+    nextAccountNumber = snapshot.nextAccountNumber();
+    imageSources = sources;
+    if (sources.journalBytes != 0) {
+        // Journal records the image includes are not in the snapshot files
+        // yet, and the next checkpoint truncates the journal
+        dirtyTables = DIRTY_ALL;
+    }
+
+    // Only what was committed after the image was published
+    recoverJournal(sources.journalBytes, sources.journalHash);
+    refreshImage();
+    return true;
+}
+
+void Database::publishImage() {
+    // The image has no balances, so accounts.dat must be current first
+    writeThroughSlots();
+    Snapshot::Writer writer;
+    fillSnapshot(writer);
+    imageSources.journalBytes = journal.appliedBytes();
+    imageSources.journalHash = journal.appliedHash();
+    sharedImage->publish(imageSources, writer.serialize());
+    imageStale = false;
+}
+
+void Database::refreshImage() {
+    if (!imageStale) {
+        // Only balances changed, and accounts.dat has them now
+        if (sharedImage->extend(journal.appliedBytes(), journal.appliedHash())) {
+            imageSources.journalBytes = journal.appliedBytes();
+        }
+    } else if (journal.appliedBytes() >= imageSources.journalBytes + IMAGE_TAIL_BYTES) {
+        // Other changes are replayed from the journal by whoever attaches,
+        // until that tail gets long enough to be worth a new image
+        publishImage();
+    }
+}
+
 Database::~Database() {
+    sequencer.reset();
     try {
-        saveAll();
+        checkpoint();
     } catch (const std::exception& e) {
         std::cerr << "Error saving data: " << e.what() << std::endl;
     }
+    // The source is unmapped with accounts.dat
+    Account::setPeriodSource(nullptr);
 } 
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "../include/FileLock.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifndef _WIN32
+#ifdef F_OFD_SETLKW
+constexpr int WAIT_COMMAND = F_OFD_SETLKW;
+constexpr int SET_COMMAND = F_OFD_SETLK;
+#else
+constexpr int WAIT_COMMAND = F_SETLKW;
+constexpr int SET_COMMAND = F_SETLK;
+#endif
+
+// False if command is SET_COMMAND and a conflicting lock is held
+bool setLock(int fd, short type, uint64_t offset, uint64_t length, int command) {
+    struct flock range;
+    std::memset(&range, 0, sizeof(range));  // OFD locks require l_pid == 0
+    range.l_type = type;
+    range.l_whence = SEEK_SET;
+    range.l_start = static_cast<off_t>(offset);
+    range.l_len = static_cast<off_t>(length);
+    while (fcntl(fd, command, &range) != 0) {
+        if (command == SET_COMMAND && type != F_UNLCK && (errno == EAGAIN || errno == EACCES)) {
+            return false;
+        }
+        if (errno != EINTR) {
+            throw std::runtime_error("Failed to lock bytes " + std::to_string(offset) + "+" +
+                                     std::to_string(length) + ": " + std::strerror(errno));
+        }
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+void FileLock::lockShared(int fd, uint64_t offset, uint64_t length) {
+#ifndef _WIN32
+    setLock(fd, F_RDLCK, offset, length, WAIT_COMMAND);
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+#endif
+}
+
+void FileLock::lockExclusive(int fd, uint64_t offset, uint64_t length) {
+#ifndef _WIN32
+    setLock(fd, F_WRLCK, offset, length, WAIT_COMMAND);
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+#endif
+}
+
+bool FileLock::tryLockShared(int fd, uint64_t offset, uint64_t length) {
+#ifndef _WIN32
+    return setLock(fd, F_RDLCK, offset, length, SET_COMMAND);
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+    return true;
+#endif
+}
+
+bool FileLock::tryLockExclusive(int fd, uint64_t offset, uint64_t length) {
+#ifndef _WIN32
+    return setLock(fd, F_WRLCK, offset, length, SET_COMMAND);
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+    return true;
+#endif
+}
+
+void FileLock::unlock(int fd, uint64_t offset, uint64_t length) {
+#ifndef _WIN32
+    setLock(fd, F_UNLCK, offset, length, SET_COMMAND);
+#else
+    (void)fd;
+    (void)offset;
+    (void)length;
+#endif
+}
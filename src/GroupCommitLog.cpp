@@ -0,0 +1,357 @@
+#include "../include/GroupCommitLog.h"
+#include "../include/FileLock.h"
+#include <stdexcept>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+namespace {
+
+int openAppend(const std::string& path) {
+#ifdef _WIN32
+    return _open(path.c_str(), _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY, 0644);
+#else
+    return ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+#endif
+}
+
+void closeDescriptor(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+// Appends with as few write calls as the kernel allows; a regular file
+// takes the whole buffer at once unless the disk is full
+bool writeAll(int fd, const std::string& buffer) {
+    size_t written = 0;
+    while (written < buffer.size()) {
+#ifdef _WIN32
+        int n = _write(fd, buffer.data() + written, static_cast<unsigned>(buffer.size() - written));
+#else
+        ssize_t n = ::write(fd, buffer.data() + written, buffer.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+#endif
+        if (n <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+uint64_t currentPosition(int fd) {
+#ifdef _WIN32
+    __int64 position = _lseeki64(fd, 0, SEEK_CUR);
+#else
+    off_t position = ::lseek(fd, 0, SEEK_CUR);
+#endif
+    return position >= 0 ? static_cast<uint64_t>(position) : 0;
+}
+
+// Flush a file's data to stable storage
+int syncDescriptor(int fd) {
+#if defined(_WIN32)
+    return _commit(fd);
+#elif defined(__APPLE__)
+    return fsync(fd);
+#else
+    return fdatasync(fd);
+#endif
+}
+
+size_t envSize(const char* name, size_t fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    try {
+        return static_cast<size_t>(std::stoul(value));
+    } catch (const std::exception&) {
+        return fallback;
+    }
+}
+
+} // namespace
+
+GroupCommitLog::Options GroupCommitLog::optionsFromEnvironment() {
+    Options options;
+    options.maxBatchRecords = envSize("BANK_GROUP_COMMIT_MAX_BATCH", options.maxBatchRecords);
+    if (options.maxBatchRecords == 0) {
+        options.maxBatchRecords = 1;
+    }
+    options.maxWait = std::chrono::microseconds(envSize("BANK_GROUP_COMMIT_MAX_WAIT_US", 0));
+    const char* fsyncSetting = std::getenv("BANK_FSYNC");
+    options.sync = !(fsyncSetting && std::string(fsyncSetting) == "0");
+    return options;
+}
+
+GroupCommitLog::GroupCommitLog(const std::string& path, Options options)
+    : path(path), options(options), fd(-1), lockFd(-1), flushing(false), stopping(false),
+      batches(0), records(0) {
+}
+
+GroupCommitLog::~GroupCommitLog() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    pendingChanged.notify_all();
+    if (flusher.joinable()) {
+        flusher.join();
+    }
+    closeFile();
+    if (lockFd >= 0) {
+        closeDescriptor(lockFd);
+    }
+}
+
+uint64_t GroupCommitLog::append(const std::string& data) {
+    Waiter waiter;
+    std::unique_lock<std::mutex> lock(mutex);
+    if (stopping) {
+        throw std::runtime_error("Log is shutting down: " + path);
+    }
+    // The flusher thread only exists once something is written
+    if (!flusher.joinable()) {
+        flusher = std::thread(&GroupCommitLog::flusherLoop, this);
+    }
+    pending.push_back(Entry{data, &waiter});
+    pendingChanged.notify_one();
+
+    batchDone.wait(lock, [&waiter] { return waiter.done; });
+    if (!waiter.error.empty()) {
+        throw std::runtime_error(waiter.error);
+    }
+    return waiter.offset;
+}
+
+void GroupCommitLog::flusherLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        pendingChanged.wait(lock, [this] { return stopping || !pending.empty(); });
+        if (pending.empty()) {
+            break; // stopping with nothing left to write
+        }
+
+        // Optionally hold the batch open for more writers
+        if (options.maxWait.count() > 0 && pending.size() < options.maxBatchRecords && !stopping) {
+            pendingChanged.wait_for(lock, options.maxWait, [this] {
+                return stopping || pending.size() >= options.maxBatchRecords;
+            });
+        }
+
+        std::vector<Entry> batch;
+        if (pending.size() <= options.maxBatchRecords) {
+            batch.swap(pending);
+        } else {
+            batch.assign(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(options.maxBatchRecords));
+            pending.erase(pending.begin(), pending.begin() + static_cast<std::ptrdiff_t>(options.maxBatchRecords));
+        }
+        flushing = true;
+
+        // Write and sync without the lock so new appends queue up behind us
+        lock.unlock();
+        std::string error;
+        uint64_t offset = 0;
+        writeBatch(batch, offset, error);
+        lock.lock();
+
+        for (Entry& entry : batch) {
+            entry.waiter->offset = offset;
+            entry.waiter->error = error;
+            entry.waiter->done = true;
+            offset += entry.data.size();
+        }
+        flushing = false;
+        batches++;
+        records += batch.size();
+        batchDone.notify_all();
+    }
+}
+
+int GroupCommitLog::lockDescriptor() {
+#ifndef _WIN32
+    // Opened on first use: the data directory may not exist at construction
+    if (lockFd < 0 && !options.lockPath.empty()) {
+        lockFd = ::open(options.lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (lockFd < 0) {
+            throw std::runtime_error("Failed to open " + options.lockPath + ": " + std::strerror(errno));
+        }
+    }
+#endif
+    return lockFd;
+}
+
+bool GroupCommitLog::replaced() const {
+#ifdef _WIN32
+    return false;
+#else
+    struct stat opened;
+    struct stat current;
+    if (::fstat(fd, &opened) != 0 || ::stat(path.c_str(), &current) != 0) {
+        return true;
+    }
+    return opened.st_ino != current.st_ino || opened.st_dev != current.st_dev;
+#endif
+}
+
+void GroupCommitLog::writeBatch(const std::vector<Entry>& batch, uint64_t& offset, std::string& error) {
+    int locked = -1;
+    try {
+        locked = lockDescriptor();
+        if (locked >= 0) {
+            FileLock::lockShared(locked, 0, 0);
+        }
+    } catch (const std::exception& e) {
+        error = e.what();
+        return;
+    }
+    writeLocked(batch, offset, error, locked >= 0);
+    if (locked >= 0) {
+        try {
+            FileLock::unlock(locked, 0, 0);
+        } catch (const std::exception&) {
+            // Released anyway when the log is closed
+        }
+    }
+    // Syncing the descriptor still covers the data if the file has been
+    // renamed since
+    if (error.empty() && options.sync && syncDescriptor(fd) != 0) {
+        error = "Failed to sync " + path + ": " + std::strerror(errno);
+    }
+}
+
+void GroupCommitLog::writeLocked(const std::vector<Entry>& batch, uint64_t& offset, std::string& error,
+                                 bool mayBeReplaced) {
+    if (fd >= 0 && mayBeReplaced && replaced()) {
+        closeFile(); // another process sealed it; append to the new one
+    }
+    if (fd < 0) {
+        fd = openAppend(path);
+        if (fd < 0) {
+            error = "Failed to open " + path + ": " + std::strerror(errno);
+            return;
+        }
+    }
+
+    std::string buffer;
+    for (const Entry& entry : batch) {
+        buffer += entry.data;
+    }
+
+    if (!writeAll(fd, buffer)) {
+        error = "Failed to write " + path + ": " + std::strerror(errno);
+        return;
+    }
+    // In append mode the position ends up right after our own write, even if
+    // another process appended to the file in the meantime
+    offset = currentPosition(fd) - buffer.size();
+}
+
+void GroupCommitLog::waitIdle(std::unique_lock<std::mutex>& lock) {
+    batchDone.wait(lock, [this] { return pending.empty() && !flushing; });
+}
+
+void GroupCommitLog::closeFile() {
+    if (fd >= 0) {
+        closeDescriptor(fd);
+        fd = -1;
+    }
+}
+
+void GroupCommitLog::truncate() {
+    std::unique_lock<std::mutex> lock(mutex);
+    waitIdle(lock);
+    closeFile();
+    std::FILE* emptied = std::fopen(path.c_str(), "wb");
+    if (!emptied) {
+        throw std::runtime_error("Failed to truncate " + path);
+    }
+    if (options.sync) {
+        syncDescriptor(fileno(emptied));
+    }
+    std::fclose(emptied);
+}
+
+void GroupCommitLog::close() {
+    std::unique_lock<std::mutex> lock(mutex);
+    waitIdle(lock);
+    closeFile();
+}
+
+void GroupCommitLog::exclusive(const std::function<void()>& fn) {
+    std::unique_lock<std::mutex> lock(mutex);
+    waitIdle(lock);
+    closeFile();
+    int locked = lockDescriptor();
+    if (locked < 0) {
+        fn();
+        return;
+    }
+    FileLock::lockExclusive(locked, 0, 0);
+    try {
+        fn();
+    } catch (...) {
+        FileLock::unlock(locked, 0, 0);
+        throw;
+    }
+    FileLock::unlock(locked, 0, 0);
+}
+
+void GroupCommitLog::syncFile(const std::string& path) {
+    if (!optionsFromEnvironment().sync) {
+        return;
+    }
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open " + path + " for sync");
+    }
+    int result = ::fsync(fd);
+    ::close(fd);
+    if (result != 0) {
+        throw std::runtime_error("Failed to sync " + path);
+    }
+#else
+    (void)path;
+#endif
+}
+
+void GroupCommitLog::syncDirectory(const std::string& path) {
+    if (!optionsFromEnvironment().sync) {
+        return;
+    }
+#ifndef _WIN32
+    // Makes renames inside the directory durable; best effort
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+uint64_t GroupCommitLog::getBatchCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return batches;
+}
+
+uint64_t GroupCommitLog::getRecordCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return records;
+}
@@ -0,0 +1,994 @@
+#include "../include/HttpServer.h"
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <chrono>
+#include <ctime>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+namespace {
+
+const size_t MAX_HEADER_BYTES = 16 * 1024;
+const size_t MAX_BODY_BYTES = 1024 * 1024;
+// Input buffered per connection; enough for one request of the largest size
+const size_t MAX_INPUT_BYTES = MAX_HEADER_BYTES + 4 + MAX_BODY_BYTES;
+const int MAX_EVENTS = 64;
+
+volatile std::sig_atomic_t stopRequested = 0;
+
+void handleStopSignal(int) {
+    stopRequested = 1;
+}
+
+std::string toLower(std::string text) {
+    for (char& c : text) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return text;
+}
+
+std::string trim(const std::string& text) {
+    const char* whitespace = " \t\r\n";
+    std::string::size_type start = text.find_first_not_of(whitespace);
+    if (start == std::string::npos) {
+        return "";
+    }
+    std::string::size_type end = text.find_last_not_of(whitespace);
+    return text.substr(start, end - start + 1);
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+std::string urlDecode(const std::string& text) {
+    std::string result;
+    result.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '+') {
+            result += ' ';
+        } else if (text[i] == '%' && i + 2 < text.size() &&
+                   hexValue(text[i + 1]) >= 0 && hexValue(text[i + 2]) >= 0) {
+            result += static_cast<char>(hexValue(text[i + 1]) * 16 + hexValue(text[i + 2]));
+            i += 2;
+        } else {
+            result += text[i];
+        }
+    }
+    return result;
+}
+
+std::map<std::string, std::string> parseQuery(const std::string& query) {
+    std::map<std::string, std::string> params;
+    std::stringstream ss(query);
+    std::string pair;
+    while (std::getline(ss, pair, '&')) {
+        if (pair.empty()) continue;
+        std::string::size_type eq = pair.find('=');
+        if (eq == std::string::npos) {
+            params[urlDecode(pair)] = "";
+        } else {
+            params[urlDecode(pair.substr(0, eq))] = urlDecode(pair.substr(eq + 1));
+        }
+    }
+    return params;
+}
+
+void appendUtf8(std::string& out, unsigned int codePoint) {
+    if (codePoint < 0x80) {
+        out += static_cast<char>(codePoint);
+    } else if (codePoint < 0x800) {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    } else {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Parses a flat JSON object such as {"accountNumber":10001,"password":"x"}.
+// String values are unescaped; numbers and literals are kept as their text.
+// null values are treated as absent.
+bool parseJsonObject(const std::string& text, std::map<std::string, std::string>& fields) {
+    size_t pos = 0;
+    auto skipSpace = [&]() {
+        while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos;
+    };
+    auto parseString = [&](std::string& out) -> bool {
+        if (pos >= text.size() || text[pos] != '"') return false;
+        ++pos;
+        while (pos < text.size() && text[pos] != '"') {
+            char c = text[pos++];
+            if (c != '\\') {
+                out += c;
+                continue;
+            }
+            if (pos >= text.size()) return false;
+            char esc = text[pos++];
+            switch (esc) {
+                case '"': out += '"'; break;
+                case '\\': out += '\\'; break;
+                case '/': out += '/'; break;
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    if (pos + 4 > text.size()) return false;
+                    unsigned int codePoint = 0;
+                    for (int i = 0; i < 4; ++i) {
+                        int v = hexValue(text[pos++]);
+                        if (v < 0) return false;
+                        codePoint = codePoint * 16 + static_cast<unsigned int>(v);
+                    }
+                    appendUtf8(out, codePoint);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        if (pos >= text.size()) return false;
+        ++pos;
+        return true;
+    };
+
+    skipSpace();
+    if (pos >= text.size() || text[pos] != '{') return false;
+    ++pos;
+    skipSpace();
+    if (pos < text.size() && text[pos] == '}') {
+        ++pos;
+    } else {
+        while (true) {
+            skipSpace();
+            std::string key;
+            if (!parseString(key)) return false;
+            skipSpace();
+            if (pos >= text.size() || text[pos] != ':') return false;
+            ++pos;
+            skipSpace();
+
+            std::string value;
+            if (pos < text.size() && text[pos] == '"') {
+                if (!parseString(value)) return false;
+                fields[key] = value;
+            } else {
+                size_t start = pos;
+                while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+                       !std::isspace(static_cast<unsigned char>(text[pos]))) {
+                    ++pos;
+                }
+                value = text.substr(start, pos - start);
+                if (value.empty() || value[0] == '{' || value[0] == '[') return false;
+                if (value != "null") {
+                    fields[key] = value;
+                }
+            }
+
+            skipSpace();
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                break;
+            }
+            return false;
+        }
+    }
+    skipSpace();
+    return pos == text.size();
+}
+
+std::string jsonString(const std::string& text) {
+    std::string result = "\"";
+    for (char c : text) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    std::ostringstream escaped;
+                    escaped << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c);
+                    result += escaped.str();
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result + "\"";
+}
+
+HttpResponse jsonResponse(int status, const std::string& body) {
+    HttpResponse response;
+    response.status = status;
+    response.body = body;
+    return response;
+}
+
+HttpResponse messageResponse(const std::string& message) {
+    return jsonResponse(200, "{\"message\":" + jsonString(message) + "}");
+}
+
+HttpResponse errorResponse(int status, const std::string& error) {
+    return jsonResponse(status, "{\"error\":" + jsonString(error) + "}");
+}
+
+const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 204: return "No Content";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 404: return "Not Found";
+        case 413: return "Payload Too Large";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        default: return "Unknown";
+    }
+}
+
+std::string serializeResponse(const HttpResponse& response, bool keepAlive) {
+    std::string out = "HTTP/1.1 " + std::to_string(response.status) + " " + statusText(response.status) + "\r\n";
+    if (!response.body.empty()) {
+        out += "Content-Type: application/json; charset=utf-8\r\n";
+    }
+    out += "Content-Length: " + std::to_string(response.body.size()) + "\r\n";
+    out += "Access-Control-Allow-Origin: *\r\n";
+    if (response.status == 204) {
+        out += "Access-Control-Allow-Methods: GET,HEAD,PUT,PATCH,POST,DELETE\r\n";
+        out += "Access-Control-Allow-Headers: Content-Type\r\n";
+    }
+    out += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    out += response.body;
+    return out;
+}
+
+bool hasField(const HttpRequest& request, const std::string& name) {
+    auto it = request.json.find(name);
+    return it != request.json.end() && !it->second.empty();
+}
+
+std::string field(const HttpRequest& request, const std::string& name) {
+    auto it = request.json.find(name);
+    return it != request.json.end() ? it->second : "";
+}
+
+std::string queryParam(const HttpRequest& request, const std::string& name) {
+    auto it = request.query.find(name);
+    return it != request.query.end() ? it->second : "";
+}
+
+// What an API call wrote to its errors stream, as the message of the response
+std::string errorText(const std::ostringstream& errors, const std::string& fallback) {
+    std::string text = trim(errors.str());
+    return text.empty() ? fallback : text;
+}
+
+bool isValidUsernameFormat(const std::string& username) {
+    if (username.size() < 4) return false;
+    for (char c : username) {
+        if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_') return false;
+    }
+    return true;
+}
+
+std::string currentTimestamp() {
+    auto now = std::chrono::system_clock::now();
+    auto time = std::chrono::system_clock::to_time_t(now);
+    std::stringstream ss;
+    std::tm local = localTime(time);
+    ss << std::put_time(&local, "%Y-%m-%d %H:%M:%S");
+    return ss.str();
+}
+
+// BANK_HTTP_LOG=1 logs every request to stderr
+bool requestLoggingEnabled() {
+    const char* value = std::getenv("BANK_HTTP_LOG");
+    return value && std::string(value) == "1";
+}
+
+} // namespace
+
+HttpServer::HttpServer(BankApp* app, int port)
+    : app(app), port(port), listenFd(-1), epollFd(-1), completionFd(-1), nextSerial(0),
+      logRequests(requestLoggingEnabled()) {
+    if (!app) {
+        throw std::invalid_argument("BankApp cannot be null");
+    }
+    if (port <= 0 || port > 65535) {
+        throw std::invalid_argument("Invalid port: " + std::to_string(port));
+    }
+}
+
+HttpServer::~HttpServer() {
+    pool.reset();  // workers still running write to completionFd
+#ifdef __linux__
+    for (auto& pair : connections) {
+        ::close(pair.first);
+    }
+    if (listenFd >= 0) ::close(listenFd);
+    if (epollFd >= 0) ::close(epollFd);
+    if (completionFd >= 0) ::close(completionFd);
+#endif
+}
+
+HttpResponse HttpServer::route(const HttpRequest& request) {
+    const std::string& method = request.method;
+    const std::string& path = request.path;
+
+    if (method == "OPTIONS") {
+        return jsonResponse(204, "");
+    }
+
+    const std::string transactionsPrefix = "/api/transactions/";
+    const std::string accountsPrefix = "/api/accounts/";
+
+    if (path == "/api/auth/login" && method == "POST") return handleLogin(request);
+    if (path == "/api/auth/register" && method == "POST") return handleRegister(request);
+    if (path == "/api/accounts" && method == "GET") return handleGetAccounts(request);
+    if (path == "/api/accounts" && method == "POST") return handleCreateAccount(request);
+    if (path == "/api/transactions/deposit" && method == "POST") return handleDeposit(request);
+    if (path == "/api/transactions/withdraw" && method == "POST") return handleWithdraw(request);
+    if (path == "/api/transactions/transfer" && method == "POST") return handleTransfer(request);
+    if (path == "/api/user/profile" && method == "GET") return handleGetProfile(request);
+    if (path == "/api/user/profile" && method == "PUT") return handleUpdateProfile(request);
+    if (path == "/api/user/change-password" && method == "PUT") return handleChangePassword(request);
+    if (path == "/api/server/workers" && method == "GET") return handleGetWorkers();
+    if (path == "/api/server/engine" && method == "GET") return handleGetEngine();
+
+    if (path.compare(0, transactionsPrefix.size(), transactionsPrefix) == 0 && method == "GET") {
+        std::string accountNumber = urlDecode(path.substr(transactionsPrefix.size()));
+        if (!accountNumber.empty() && accountNumber.find('/') == std::string::npos) {
+            return handleGetTransactions(request, accountNumber);
+        }
+    }
+    if (path.compare(0, accountsPrefix.size(), accountsPrefix) == 0) {
+        std::string accountNumber = urlDecode(path.substr(accountsPrefix.size()));
+        if (!accountNumber.empty() && accountNumber.find('/') == std::string::npos) {
+            if (method == "GET") return handleGetAccount(accountNumber);
+            if (method == "DELETE") return handleCloseAccount(request, accountNumber);
+        }
+    }
+
+    return errorResponse(404, "Cannot " + method + " " + path);
+}
+
+HttpResponse HttpServer::handleLogin(const HttpRequest& request) {
+    if (!hasField(request, "username") || !hasField(request, "password")) {
+        return errorResponse(400, "Username and password are required");
+    }
+    std::string username = field(request, "username");
+
+    // One call for authentication and the profile instead of two processes
+    int customerId;
+    if (!app->authenticateCustomer(username, field(request, "password"), customerId)) {
+        return errorResponse(401, "Invalid username or password");
+    }
+
+    std::string userDetails = app->getUserDetails(username);
+    return jsonResponse(200, "{\"message\":\"Login successful\",\"user\":" + userDetails + "}");
+}
+
+HttpResponse HttpServer::handleRegister(const HttpRequest& request) {
+    if (!hasField(request, "name") || !hasField(request, "phone") ||
+        !hasField(request, "username") || !hasField(request, "password")) {
+        return errorResponse(400, "All fields are required");
+    }
+    std::string name = field(request, "name");
+    std::string phone = field(request, "phone");
+    std::string username = field(request, "username");
+    std::string password = field(request, "password");
+
+    if (!app->isValidPhone(phone)) {
+        return errorResponse(400, "Phone number must be 10 digits");
+    }
+    if (!isValidUsernameFormat(username)) {
+        return errorResponse(400, "Username must be at least 4 characters and contain only letters, numbers, and underscores");
+    }
+    if (!app->isValidPassword(password)) {
+        return errorResponse(400, "Password must be at least 6 characters and include uppercase, lowercase, and numbers");
+    }
+
+    if (!app->isValidName(name)) {
+        return errorResponse(400, "Error: Invalid name format");
+    }
+    std::ostringstream errors;  // the response gives the format message only
+    if (!app->isValidUsername(username, errors)) {
+        return errorResponse(400, "Error: Invalid username format");
+    }
+    if (!app->registerCustomer(name, phone, username, password)) {
+        return errorResponse(400, "Registration failed");
+    }
+
+    return jsonResponse(200, "{\"message\":\"Registration successful\",\"user\":{\"name\":" + jsonString(name) +
+                             ",\"username\":" + jsonString(username) + ",\"phone\":" + jsonString(phone) + "}}");
+}
+
+HttpResponse HttpServer::handleGetAccounts(const HttpRequest& request) {
+    std::string username = queryParam(request, "username");
+    if (username.empty()) {
+        return errorResponse(400, "Username is required");
+    }
+    std::string accounts = app->getAccounts(username);
+    return jsonResponse(200, "{\"accounts\":" + accounts + "}");
+}
+
+HttpResponse HttpServer::handleCreateAccount(const HttpRequest& request) {
+    if (!hasField(request, "username") || !hasField(request, "type") ||
+        !hasField(request, "initialBalance") || !hasField(request, "password")) {
+        return errorResponse(400, "All fields are required");
+    }
+    Money initialBalance = Money::parse(field(request, "initialBalance"));
+
+    int accountNumber = app->createAccount(field(request, "username"), field(request, "password"),
+                                           field(request, "type"), initialBalance);
+    if (accountNumber <= 0) {
+        return errorResponse(400, "Failed to create account. Error code: " + std::to_string(accountNumber));
+    }
+    return jsonResponse(200, "{\"message\":\"Account created successfully\",\"accountNumber\":" +
+                             std::to_string(accountNumber) + "}");
+}
+
+HttpResponse HttpServer::handleDeposit(const HttpRequest& request) {
+    if (!hasField(request, "accountNumber") || !hasField(request, "amount") || !hasField(request, "password")) {
+        return errorResponse(400, "All fields are required");
+    }
+    int accountNumber = std::stoi(field(request, "accountNumber"));
+    Money amount = Money::parse(field(request, "amount"));
+
+    std::ostringstream errors;
+    if (app->deposit(accountNumber, amount, field(request, "password"), errors)) {
+        return messageResponse("Deposit successful");
+    }
+    return errorResponse(400, errorText(errors, "Deposit failed"));
+}
+
+HttpResponse HttpServer::handleWithdraw(const HttpRequest& request) {
+    if (!hasField(request, "accountNumber") || !hasField(request, "amount") || !hasField(request, "password")) {
+        return errorResponse(400, "All fields are required");
+    }
+    int accountNumber = std::stoi(field(request, "accountNumber"));
+    Money amount = Money::parse(field(request, "amount"));
+
+    std::ostringstream errors;
+    if (app->withdraw(accountNumber, amount, field(request, "password"), errors)) {
+        return messageResponse("Withdrawal successful");
+    }
+    return errorResponse(400, errorText(errors, "Withdrawal failed"));
+}
+
+HttpResponse HttpServer::handleTransfer(const HttpRequest& request) {
+    if (!hasField(request, "fromAccount") || !hasField(request, "toAccount") ||
+        !hasField(request, "amount") || !hasField(request, "password")) {
+        return errorResponse(400, "All fields are required");
+    }
+    int fromAccount = std::stoi(field(request, "fromAccount"));
+    int toAccount = std::stoi(field(request, "toAccount"));
+    Money amount = Money::parse(field(request, "amount"));
+
+    std::ostringstream errors;
+    if (app->transfer(fromAccount, toAccount, amount, field(request, "password"), errors)) {
+        return messageResponse("Transfer successful");
+    }
+    return errorResponse(400, errorText(errors, "Transfer failed"));
+}
+
+HttpResponse HttpServer::handleGetTransactions(const HttpRequest& request, const std::string& accountNumber) {
+    int number = std::stoi(accountNumber);
+    auto from = request.query.find("from");
+    auto to = request.query.find("to");
+    std::ostringstream errors;  // an unknown account is an empty statement
+    std::string transactions = app->getTransactions(number,
+                                                    from != request.query.end() ? from->second : "",
+                                                    to != request.query.end() ? to->second : "", errors);
+    return jsonResponse(200, "{\"transactions\":" + transactions + "}");
+}
+
+HttpResponse HttpServer::handleGetAccount(const std::string& accountNumber) {
+    int number = std::stoi(accountNumber);
+    return jsonResponse(200, app->getAccountDetails(number));
+}
+
+HttpResponse HttpServer::handleCloseAccount(const HttpRequest& request, const std::string& accountNumber) {
+    if (!hasField(request, "password")) {
+        return errorResponse(400, "Account number and password are required");
+    }
+    int number = std::stoi(accountNumber);
+
+    std::ostringstream errors;
+    if (app->closeAccount(number, field(request, "password"), errors)) {
+        return messageResponse("Account closed successfully");
+    }
+    return errorResponse(400, errorText(errors, "Failed to close account"));
+}
+
+HttpResponse HttpServer::handleGetProfile(const HttpRequest& request) {
+    std::string username = queryParam(request, "username");
+    if (username.empty()) {
+        return errorResponse(400, "Username is required");
+    }
+    return jsonResponse(200, app->getUserDetails(username));
+}
+
+HttpResponse HttpServer::handleUpdateProfile(const HttpRequest& request) {
+    if (!hasField(request, "username") || !hasField(request, "name") || !hasField(request, "phone")) {
+        return errorResponse(400, "Username, name, and phone are required");
+    }
+    if (!app->isValidPhone(field(request, "phone"))) {
+        return errorResponse(400, "Phone number must be 10 digits");
+    }
+
+    std::ostringstream errors;
+    if (app->updateProfile(field(request, "username"), field(request, "name"), field(request, "phone"), errors)) {
+        return messageResponse("Profile updated successfully");
+    }
+    return errorResponse(400, errorText(errors, "Failed to update profile"));
+}
+
+HttpResponse HttpServer::handleChangePassword(const HttpRequest& request) {
+    if (!hasField(request, "username") || !hasField(request, "currentPassword") || !hasField(request, "newPassword")) {
+        return errorResponse(400, "Username, current password, and new password are required");
+    }
+    if (!app->isValidPassword(field(request, "newPassword"))) {
+        return errorResponse(400, "New password must be at least 6 characters and include uppercase, lowercase, and numbers");
+    }
+
+    std::ostringstream errors;
+    if (app->changePassword(field(request, "username"), field(request, "currentPassword"),
+                            field(request, "newPassword"), errors)) {
+        return messageResponse("Password changed successfully");
+    }
+    return errorResponse(400, errorText(errors, "Failed to change password"));
+}
+
+HttpResponse HttpServer::handleGetWorkers() {
+    if (!pool) {
+        return errorResponse(404, "No worker pool");
+    }
+    std::ostringstream json;
+    json << "{\"workers\":" << pool->size() << ",\"longTaskLimit\":" << pool->longTaskLimit()
+         << ",\"perWorker\":[";
+    std::vector<WorkStealingPool::WorkerStats> stats = pool->stats();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        json << (i ? "," : "") << "{\"queued\":" << stats[i].queued << ",\"executed\":" << stats[i].executed
+             << ",\"stolen\":" << stats[i].stolen << "}";
+    }
+    json << "]}";
+    return jsonResponse(200, json.str());
+}
+
+HttpResponse HttpServer::handleGetEngine() {
+    return jsonResponse(200, app->getEngineStats());
+}
+
+#ifdef __linux__
+
+bool HttpServer::openListener() {
+    listenFd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        std::cerr << "Error: Failed to create socket: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    int enable = 1;
+    ::setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+
+    sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 ||
+        ::listen(listenFd, SOMAXCONN) < 0) {
+        std::cerr << "Error: Failed to listen on port " << port << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0) {
+        std::cerr << "Error: Failed to create epoll instance: " << std::strerror(errno) << std::endl;
+        return false;
+    }
+
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    return ::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) == 0;
+}
+
+void HttpServer::acceptConnections() {
+    while (true) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "Error: accept failed: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        int enable = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.fd = fd;
+        if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ::close(fd);
+            continue;
+        }
+
+        Connection conn;
+        conn.fd = fd;
+        conn.serial = ++nextSerial;
+        conn.interest = event.events;
+        connections[fd] = std::move(conn);
+    }
+}
+
+bool HttpServer::handleReadable(Connection& conn) {
+    char buffer[16 * 1024];
+    // The rest stays in the socket until the buffered requests are handled
+    while (conn.input.size() < MAX_INPUT_BYTES) {
+        ssize_t n = ::recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            conn.input.append(buffer, static_cast<size_t>(n));
+            continue;
+        }
+        if (n == 0) {
+            conn.peerClosed = true;
+            break;
+        }
+        if (errno == EINTR) continue;
+        if (errno == EAGAIN || errno == EWOULDBLOCK) break;
+        return false;
+    }
+
+    processInput(conn);
+    return handleWritable(conn);
+}
+
+bool HttpServer::handleWritable(Connection& conn) {
+    while (!conn.output.empty()) {
+        ssize_t n = ::send(conn.fd, conn.output.data(), conn.output.size(), MSG_NOSIGNAL);
+        if (n > 0) {
+            conn.output.erase(0, static_cast<size_t>(n));
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        return false;
+    }
+
+    // A peer that half-closed after its last requests still gets the answers
+    if (conn.output.empty() && (conn.closeAfterWrite || conn.peerClosed) && !conn.busy) {
+        return false;
+    }
+    updateInterest(conn);
+    return true;
+}
+
+void HttpServer::updateInterest(Connection& conn) {
+    // Stop reading once the connection is closing so a half-closed peer does
+    // not keep waking the loop while the last response drains, and while a
+    // request is in flight so a pipelining client cannot pile up input
+    bool reading = !conn.closeAfterWrite && !conn.peerClosed && !conn.busy;
+    unsigned int interest = reading ? static_cast<unsigned int>(EPOLLIN | EPOLLRDHUP) : 0u;
+    if (!conn.output.empty()) {
+        interest |= EPOLLOUT;
+    }
+    if (interest == conn.interest) {
+        return;
+    }
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = interest;
+    event.data.fd = conn.fd;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event) == 0) {
+        conn.interest = interest;
+    }
+}
+
+void HttpServer::processInput(Connection& conn) {
+    while (!conn.closeAfterWrite && !conn.busy) {
+        std::string::size_type headerEnd = conn.input.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (conn.input.size() > MAX_HEADER_BYTES) {
+                conn.output += serializeResponse(errorResponse(431, "Request headers too large"), false);
+                conn.closeAfterWrite = true;
+            }
+            return;
+        }
+
+        auto started = std::chrono::steady_clock::now();
+        HttpRequest request;
+        std::stringstream head(conn.input.substr(0, headerEnd));
+        std::string requestLine;
+        std::getline(head, requestLine);
+        if (!requestLine.empty() && requestLine.back() == '\r') requestLine.pop_back();
+
+        std::stringstream lineStream(requestLine);
+        std::string target, version;
+        lineStream >> request.method >> target >> version;
+        if (request.method.empty() || target.empty() || version.compare(0, 5, "HTTP/") != 0) {
+            conn.output += serializeResponse(errorResponse(400, "Malformed request line"), false);
+            conn.closeAfterWrite = true;
+            return;
+        }
+
+        std::string headerLine;
+        while (std::getline(head, headerLine)) {
+            if (!headerLine.empty() && headerLine.back() == '\r') headerLine.pop_back();
+            std::string::size_type colon = headerLine.find(':');
+            if (colon == std::string::npos) continue;
+            request.headers[toLower(trim(headerLine.substr(0, colon)))] = trim(headerLine.substr(colon + 1));
+        }
+
+        std::string connectionHeader = toLower(request.headers["connection"]);
+        request.keepAlive = version == "HTTP/1.0" ? connectionHeader == "keep-alive"
+                                                  : connectionHeader != "close";
+
+        if (request.headers.count("transfer-encoding")) {
+            conn.output += serializeResponse(errorResponse(501, "Chunked request bodies are not supported"), false);
+            conn.closeAfterWrite = true;
+            return;
+        }
+
+        size_t contentLength = 0;
+        auto lengthIt = request.headers.find("content-length");
+        if (lengthIt != request.headers.end()) {
+            try {
+                contentLength = static_cast<size_t>(std::stoul(lengthIt->second));
+            } catch (const std::exception&) {
+                conn.output += serializeResponse(errorResponse(400, "Invalid Content-Length"), false);
+                conn.closeAfterWrite = true;
+                return;
+            }
+        }
+        if (contentLength > MAX_BODY_BYTES) {
+            conn.output += serializeResponse(errorResponse(413, "Request body too large"), false);
+            conn.closeAfterWrite = true;
+            return;
+        }
+        if (conn.input.size() < headerEnd + 4 + contentLength) {
+            return; // Wait for the rest of the body
+        }
+        request.body = conn.input.substr(headerEnd + 4, contentLength);
+        conn.input.erase(0, headerEnd + 4 + contentLength);
+
+        std::string::size_type queryStart = target.find('?');
+        request.path = target.substr(0, queryStart);
+        if (queryStart != std::string::npos) {
+            request.query = parseQuery(target.substr(queryStart + 1));
+        }
+
+        if (!trim(request.body).empty() && !parseJsonObject(request.body, request.json)) {
+            finishRequest(conn, errorResponse(400, "Invalid JSON body"), request.keepAlive,
+                          request.method, target, started);
+        } else {
+            dispatch(conn, std::move(request), target, started);
+        }
+    }
+}
+
+void HttpServer::dispatch(Connection& conn, HttpRequest request, const std::string& target,
+                          std::chrono::steady_clock::time_point started) {
+    if (!pool) {
+        HttpResponse response;
+        try {
+            response = route(request);
+        } catch (const std::exception& e) {
+            response = errorResponse(400, std::string("Error: ") + e.what());
+        }
+        finishRequest(conn, response, request.keepAlive, request.method, target, started);
+        return;
+    }
+
+    // Statements scan the whole history of an account; everything else is
+    // a short lookup or a single balance change
+    const std::string transactionsPrefix = "/api/transactions/";
+    bool statement = request.method == "GET" &&
+                     request.path.compare(0, transactionsPrefix.size(), transactionsPrefix) == 0;
+
+    auto pending = std::make_shared<Completion>();
+    pending->fd = conn.fd;
+    pending->serial = conn.serial;
+    pending->keepAlive = request.keepAlive;
+    pending->method = request.method;
+    pending->target = target;
+    pending->started = started;
+    auto shared = std::make_shared<HttpRequest>(std::move(request));
+
+    conn.busy = true;
+    pool->submit([this, pending, shared] {
+        try {
+            pending->response = route(*shared);
+        } catch (const std::exception& e) {
+            pending->response = errorResponse(400, std::string("Error: ") + e.what());
+        }
+        {
+            std::lock_guard<std::mutex> lock(completionMutex);
+            completions.push_back(std::move(*pending));
+        }
+        uint64_t one = 1;
+        ssize_t written = ::write(completionFd, &one, sizeof(one));
+        (void)written;  // only fails if the counter is already huge, which still wakes the loop
+    }, statement ? WorkStealingPool::Priority::LONG : WorkStealingPool::Priority::SHORT);
+}
+
+void HttpServer::finishRequest(Connection& conn, const HttpResponse& response, bool keepAlive,
+                               const std::string& method, const std::string& target,
+                               std::chrono::steady_clock::time_point started) {
+    conn.output += serializeResponse(response, keepAlive);
+    if (!keepAlive) {
+        conn.closeAfterWrite = true;
+    }
+
+    if (!logRequests) {
+        return;
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    std::cerr << "[" << currentTimestamp() << "] " << method << " " << target
+              << " " << response.status << " " << elapsed << "us" << std::endl;
+}
+
+void HttpServer::deliverCompletions() {
+    uint64_t count;
+    while (::read(completionFd, &count, sizeof(count)) > 0) {
+    }
+
+    std::vector<Completion> ready;
+    {
+        std::lock_guard<std::mutex> lock(completionMutex);
+        ready.swap(completions);
+    }
+    for (Completion& done : ready) {
+        // The connection may have closed, and its fd been reused, meanwhile
+        auto it = connections.find(done.fd);
+        if (it == connections.end() || it->second.serial != done.serial) {
+            continue;
+        }
+        Connection& conn = it->second;
+        conn.busy = false;
+        finishRequest(conn, done.response, done.keepAlive, done.method, done.target, done.started);
+        processInput(conn);  // the next pipelined request, if any
+        if (!handleWritable(conn)) {
+            closeConnection(done.fd);
+        }
+    }
+}
+
+void HttpServer::closeConnection(int fd) {
+    ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections.erase(fd);
+}
+
+int HttpServer::run() {
+    if (!openListener()) {
+        return 1;
+    }
+
+    // Stop cleanly on Ctrl+C / SIGTERM so the database is saved on the way out
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handleStopSignal;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    completionFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (completionFd < 0) {
+        std::cerr << "Error: Failed to create eventfd: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    epoll_event completionEvent;
+    std::memset(&completionEvent, 0, sizeof(completionEvent));
+    completionEvent.events = EPOLLIN;
+    completionEvent.data.fd = completionFd;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, completionFd, &completionEvent) < 0) {
+        std::cerr << "Error: Failed to watch eventfd: " << std::strerror(errno) << std::endl;
+        return 1;
+    }
+    unsigned int workers = WorkStealingPool::workersFromEnvironment();
+    if (workers > 0) {
+        pool.reset(new WorkStealingPool(workers));
+    }
+
+    std::cerr << "HTTP server listening on port " << port << " with " << workers << " workers" << std::endl;
+
+    epoll_event events[MAX_EVENTS];
+    while (!stopRequested) {
+        int ready = ::epoll_wait(epollFd, events, MAX_EVENTS, -1);
+        if (ready < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "Error: epoll_wait failed: " << std::strerror(errno) << std::endl;
+            return 1;
+        }
+
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            if (fd == completionFd) {
+                deliverCompletions();
+                continue;
+            }
+
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                continue;
+            }
+
+            bool alive = true;
+            if (events[i].events & EPOLLERR) {
+                alive = false;
+            }
+            if (alive && (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP))) {
+                alive = handleReadable(it->second);
+            }
+            if (alive && (events[i].events & EPOLLOUT)) {
+                alive = handleWritable(it->second);
+            }
+            if (!alive) {
+                closeConnection(fd);
+            }
+        }
+    }
+
+    std::cerr << "HTTP server shutting down" << std::endl;
+    pool.reset();  // finish the requests already handed to the workers
+    return 0;
+}
+
+#else
+
+bool HttpServer::openListener() { return false; }
+void HttpServer::acceptConnections() {}
+bool HttpServer::handleReadable(Connection&) { return false; }
+bool HttpServer::handleWritable(Connection&) { return false; }
+void HttpServer::processInput(Connection&) {}
+void HttpServer::dispatch(Connection&, HttpRequest, const std::string&, std::chrono::steady_clock::time_point) {}
+void HttpServer::finishRequest(Connection&, const HttpResponse&, bool, const std::string&, const std::string&,
+                               std::chrono::steady_clock::time_point) {}
+void HttpServer::deliverCompletions() {}
+void HttpServer::updateInterest(Connection&) {}
+void HttpServer::closeConnection(int) {}
+
+int HttpServer::run() {
+    std::cerr << "Error: The native HTTP server requires Linux (epoll)" << std::endl;
+    return 1;
+}
+
+#endif
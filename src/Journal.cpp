@@ -0,0 +1,196 @@
+#include "../include/Journal.h"
+#include "../include/FileLock.h"
+#include <fstream>
+#include <stdexcept>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+const char* COMMIT_MARKER = "COMMIT";
+}
+
+Journal::Journal(const std::string& path)
+    : path(path), log(path), pendingRecords(0), committedRecords(0), applied(0), appliedDigest(EMPTY_HASH),
+      lockFd(-1), checkpointLocks(0) {
+}
+
+Journal::~Journal() {
+#ifndef _WIN32
+    if (lockFd >= 0) {
+        ::close(lockFd);
+    }
+#endif
+}
+
+int Journal::lockDescriptor() {
+#ifndef _WIN32
+    // Opened on first use: the data directory may not exist at construction
+    if (lockFd < 0) {
+        lockFd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (lockFd < 0) {
+            throw std::runtime_error("Failed to open " + path + " for locking");
+        }
+    }
+#endif
+    return lockFd;
+}
+
+Journal::CheckpointLock::CheckpointLock(Journal& journal) : journal(journal) {
+    if (journal.checkpointLocks == 0) {
+        FileLock::lockExclusive(journal.lockDescriptor(), 0, 0);
+    }
+    journal.checkpointLocks++;
+}
+
+Journal::CheckpointLock::~CheckpointLock() {
+    if (--journal.checkpointLocks > 0) {
+        return;
+    }
+    try {
+        FileLock::unlock(journal.lockFd, 0, 0);
+    } catch (const std::exception&) {
+        // Released anyway when the journal is closed
+    }
+}
+
+void Journal::append(const std::string& record) {
+    if (record.find('\n') != std::string::npos) {
+        throw std::invalid_argument("Journal record cannot contain a newline");
+    }
+    pending += record;
+    pending += '\n';
+    pendingRecords++;
+}
+
+void Journal::commit() {
+    if (pendingRecords == 0) {
+        return;
+    }
+
+    // Returns once the whole group, marker included, is durable
+    std::string group = pending + COMMIT_MARKER + "\n";
+    int fd = lockDescriptor();
+    FileLock::lockShared(fd, 0, 0);
+    uint64_t offset;
+    try {
+        offset = log.append(group);
+    } catch (...) {
+        FileLock::unlock(fd, 0, 0);
+        throw;
+    }
+    FileLock::unlock(fd, 0, 0);
+    if (offset == applied) {
+        applied += group.size();
+        appliedDigest = extendHash(appliedDigest, group);
+    }
+
+    committedRecords += pendingRecords;
+    pending.clear();
+    pendingRecords = 0;
+}
+
+void Journal::rollback() {
+    pending.clear();
+    pendingRecords = 0;
+}
+
+bool Journal::readGroups(uint64_t from, std::vector<std::string>& records, std::string& committedText) {
+    std::ifstream in(path);
+    in.seekg(static_cast<std::streamoff>(from));
+
+    std::vector<std::string> group;
+    std::string groupText;
+    std::string line;
+    while (std::getline(in, line)) {
+        // A final line without its newline is torn or still being written
+        if (in.eof()) {
+            return false;
+        }
+        groupText += line + "\n";
+        if (line == COMMIT_MARKER) {
+            records.insert(records.end(), group.begin(), group.end());
+            committedText += groupText;
+            group.clear();
+            groupText.clear();
+        } else if (!line.empty()) {
+            group.push_back(line);
+        }
+    }
+    return group.empty();
+}
+
+void Journal::truncateTo(uint64_t size) {
+#ifdef _WIN32
+    int fd = _open(path.c_str(), _O_RDWR | _O_BINARY);
+    bool ok = fd >= 0 && _chsize_s(fd, static_cast<__int64>(size)) == 0;
+    if (fd >= 0) {
+        _close(fd);
+    }
+#else
+    bool ok = ::ftruncate(lockDescriptor(), static_cast<off_t>(size)) == 0;
+#endif
+    if (!ok) {
+        throw std::runtime_error("Failed to repair journal");
+    }
+    GroupCommitLog::syncFile(path);
+}
+
+std::vector<std::string> Journal::readCommitted(uint64_t from, uint64_t prefixHash) {
+    std::vector<std::string> records;
+    if (!std::ifstream(path).is_open()) {
+        committedRecords = 0;
+        applied = 0;
+        appliedDigest = EMPTY_HASH;
+        return records;
+    }
+
+    std::string committedText;
+    if (!readGroups(from, records, committedText)) {
+        // Commits hold the shared lock until their group is complete, so
+        // once no commit is in flight an unfinished group was torn by a
+        // crash. It is cut off so new appends do not land behind it.
+        CheckpointLock lock(*this);
+        records.clear();
+        committedText.clear();
+        if (!readGroups(from, records, committedText)) {
+            log.close();
+            truncateTo(from + committedText.size());
+        }
+    }
+
+    committedRecords = records.size();
+    applied = from + committedText.size();
+    appliedDigest = extendHash(prefixHash, committedText);
+    return records;
+}
+
+void Journal::reset() {
+    log.truncate();
+    committedRecords = 0;
+    applied = 0;
+    appliedDigest = EMPTY_HASH;
+}
+
+bool Journal::fileStartsWith(const std::string& path, uint64_t bytes, uint64_t hash) {
+    if (bytes == 0) {
+        return true;
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::string prefix(static_cast<size_t>(bytes), '\0');
+    if (!file.read(&prefix[0], static_cast<std::streamsize>(bytes))) {
+        return false;
+    }
+    return extendHash(EMPTY_HASH, prefix) == hash;
+}
+
+uint64_t Journal::extendHash(uint64_t hash, std::string_view bytes) {
+    for (unsigned char byte : bytes) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    }
+    return hash;
+}
@@ -0,0 +1,254 @@
+#include "../include/LineScanner.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define BANK_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+typedef const char* (*FindFunction)(const char*, const char*, char);
+typedef size_t (*FindAllFunction)(const char*, size_t, char, uint32_t*);
+
+const char* findScalar(const char* p, const char* end, char c) {
+    while (p < end && *p != c) {
+        p++;
+    }
+    return p;
+}
+
+// Appends the offsets of c in data[from, length) after the count already found
+size_t findRemaining(const char* data, size_t from, size_t length, char c, uint32_t* positions, size_t count) {
+    for (size_t i = from; i < length; i++) {
+        if (data[i] == c) {
+            positions[count++] = static_cast<uint32_t>(i);
+        }
+    }
+    return count;
+}
+
+size_t findAllScalar(const char* data, size_t length, char c, uint32_t* positions) {
+    return findRemaining(data, 0, length, c, positions, 0);
+}
+
+#ifdef BANK_SCAN_X86
+// Appends the offsets of the set bits of one block's match mask
+inline size_t appendMatches(uint32_t mask, size_t base, uint32_t* positions, size_t count) {
+    while (mask != 0) {
+        positions[count++] = static_cast<uint32_t>(base + static_cast<size_t>(__builtin_ctz(mask)));
+        mask &= mask - 1;
+    }
+    return count;
+}
+
+__attribute__((target("sse2")))
+const char* findSse2(const char* p, const char* end, char c) {
+    const __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+        p += 16;
+    }
+    return findScalar(p, end, c);
+}
+
+__attribute__((target("sse2")))
+size_t findAllSse2(const char* data, size_t length, char c, uint32_t* positions) {
+    const __m128i needle = _mm_set1_epi8(c);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(block, needle)));
+        count = appendMatches(mask, i, positions, count);
+    }
+    return findRemaining(data, i, length, c, positions, count);
+}
+
+__attribute__((target("avx2")))
+const char* findAvx2(const char* p, const char* end, char c) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    while (end - p >= 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        int mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle));
+        if (mask != 0) {
+            return p + __builtin_ctz(static_cast<unsigned int>(mask));
+        }
+        p += 32;
+    }
+    return findSse2(p, end, c);
+}
+
+__attribute__((target("avx2")))
+size_t findAllAvx2(const char* data, size_t length, char c, uint32_t* positions) {
+    const __m256i needle = _mm256_set1_epi8(c);
+    size_t count = 0;
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+        uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, needle)));
+        count = appendMatches(mask, i, positions, count);
+    }
+    return findRemaining(data, i, length, c, positions, count);
+}
+#endif
+
+struct Functions {
+    FindFunction find;
+    FindAllFunction findAll;
+};
+
+Functions functionsFor(LineScanner::Path path) {
+#ifdef BANK_SCAN_X86
+    switch (path) {
+        case LineScanner::Path::AVX2:
+            return Functions{findAvx2, findAllAvx2};
+        case LineScanner::Path::SSE2:
+            return Functions{findSse2, findAllSse2};
+        default:
+            break;
+    }
+#else
+    (void)path;
+#endif
+    return Functions{findScalar, findAllScalar};
+}
+
+LineScanner::Path pathFromEnvironment() {
+    LineScanner::Path path = LineScanner::bestPath();
+    const char* value = std::getenv("BANK_SCAN");
+    if (value) {
+        std::string name(value);
+        if (name == "scalar") {
+            path = LineScanner::Path::SCALAR;
+        } else if (name == "sse2" && path != LineScanner::Path::SCALAR) {
+            path = LineScanner::Path::SSE2;
+        }
+    }
+    return path;
+}
+
+struct Selection {
+    std::atomic<LineScanner::Path> path;
+    std::atomic<FindFunction> find;
+    std::atomic<FindAllFunction> findAll;
+
+    Selection() : path(pathFromEnvironment()) {
+        set(path.load());
+    }
+
+    void set(LineScanner::Path selected) {
+        Functions functions = functionsFor(selected);
+        path = selected;
+        find = functions.find;
+        findAll = functions.findAll;
+    }
+};
+
+Selection& selection() {
+    static Selection selected;
+    return selected;
+}
+
+} // namespace
+
+const char* LineScanner::find(const char* begin, const char* end, char c) {
+    return selection().find.load(std::memory_order_relaxed)(begin, end, c);
+}
+
+size_t LineScanner::findAll(const char* data, size_t length, char c, uint32_t* positions) {
+    return selection().findAll.load(std::memory_order_relaxed)(data, length, c, positions);
+}
+
+uint64_t LineScanner::scanFile(const std::string& path, uint64_t from, uint64_t to,
+                              const std::function<void(std::string_view, uint64_t)>& onLine) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return from;
+    }
+    file.seekg(static_cast<std::streamoff>(from));
+
+    constexpr size_t BLOCK_BYTES = 1 << 20;
+    std::vector<char> buffer(BLOCK_BYTES);
+    size_t filled = 0;          // bytes in buffer, starting at file offset position
+    uint64_t position = from;   // start of the first unreported line
+    while (position < to) {
+        size_t wanted = buffer.size() - filled;
+        file.read(buffer.data() + filled, static_cast<std::streamsize>(wanted));
+        size_t got = static_cast<size_t>(file.gcount());
+        if (got == 0) {
+            break;
+        }
+        filled += got;
+
+        // Lines from `to` on are left alone
+        size_t stop = filled;
+        size_t consumed = forEachLine(std::string_view(buffer.data(), filled),
+            [&](std::string_view line, size_t offset) {
+                if (stop != filled || position + offset >= to) {
+                    stop = std::min(stop, offset);
+                    return;
+                }
+                onLine(line, position + offset);
+            });
+        if (stop != filled) {
+            position += stop;
+            break;
+        }
+        position += consumed;
+
+        // Keep the partial line and grow the buffer if one line fills it
+        std::memmove(buffer.data(), buffer.data() + consumed, filled - consumed);
+        filled -= consumed;
+        if (filled == buffer.size()) {
+            buffer.resize(buffer.size() * 2);
+        }
+    }
+    return position;
+}
+
+LineScanner::Path LineScanner::bestPath() {
+#ifdef BANK_SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return Path::AVX2;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        return Path::SSE2;
+    }
+#endif
+    return Path::SCALAR;
+}
+
+LineScanner::Path LineScanner::activePath() {
+    return selection().path.load();
+}
+
+const char* LineScanner::pathName(Path path) {
+    switch (path) {
+        case Path::AVX2:
+            return "avx2";
+        case Path::SSE2:
+            return "sse2";
+        default:
+            return "scalar";
+    }
+}
+
+void LineScanner::usePath(Path path) {
+    Path best = bestPath();
+    if (static_cast<int>(path) > static_cast<int>(best)) {
+        path = best;
+    }
+    selection().set(path);
+}
@@ -0,0 +1,120 @@
+#include "../include/Money.h"
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+int64_t roundToMinor(double minor) {
+    // 2^63 is exactly representable, so this bound is exact
+    constexpr double LIMIT = 9223372036854775808.0;
+    if (!std::isfinite(minor) || minor >= LIMIT || minor <= -LIMIT) {
+        throw std::out_of_range("Money: amount out of range");
+    }
+    return std::llround(minor);
+}
+
+bool isDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+} // namespace
+
+Money Money::fromDouble(double value) {
+    return Money(roundToMinor(value * MINOR_PER_MAJOR));
+}
+
+Money Money::times(double factor) const {
+    return Money(roundToMinor(static_cast<double>(minor) * factor));
+}
+
+char* Money::format(char* buffer) const {
+    char* out = buffer;
+    // Unsigned, so the most negative amount has a magnitude too
+    uint64_t magnitude = static_cast<uint64_t>(minor);
+    if (minor < 0) {
+        *out++ = '-';
+        magnitude = 0 - magnitude;
+    }
+    out = std::to_chars(out, buffer + MAX_TEXT, magnitude / MINOR_PER_MAJOR).ptr;
+    uint64_t cents = magnitude % MINOR_PER_MAJOR;
+    *out++ = '.';
+    *out++ = static_cast<char>('0' + cents / 10);
+    *out++ = static_cast<char>('0' + cents % 10);
+    return out;
+}
+
+std::string Money::toString() const {
+    char text[MAX_TEXT];
+    return std::string(text, format(text));
+}
+
+Money Money::parse(std::string_view text) {
+    size_t start = text.find_first_not_of(" \t\r\n");
+    std::string_view field = text.substr(start == std::string_view::npos ? text.size() : start);
+    std::string_view number = field;
+    bool negative = !field.empty() && field[0] == '-';
+    if (!field.empty() && (field[0] == '-' || field[0] == '+')) {
+        field.remove_prefix(1);
+    }
+
+    // Digits are taken one at a time, so no precision is lost on the way
+    constexpr uint64_t MAX_WHOLE = static_cast<uint64_t>(std::numeric_limits<int64_t>::max()) / MINOR_PER_MAJOR;
+    uint64_t whole = 0;
+    bool anyDigits = false;
+    size_t i = 0;
+    for (; i < field.size() && isDigit(field[i]); i++) {
+        whole = whole * 10 + static_cast<uint64_t>(field[i] - '0');
+        if (whole > MAX_WHOLE) {
+            throw std::out_of_range("Money: out of range: '" + std::string(number) + "'");
+        }
+        anyDigits = true;
+    }
+    uint64_t cents = 0;
+    if (i < field.size() && field[i] == '.') {
+        size_t places = 0;
+        bool roundUp = false;
+        for (i++; i < field.size() && isDigit(field[i]); i++, places++) {
+            if (places < 2) {
+                cents = cents * 10 + static_cast<uint64_t>(field[i] - '0');
+            } else if (places == 2) {
+                roundUp = field[i] >= '5';
+            }
+            anyDigits = true;
+        }
+        for (; places < 2; places++) {
+            cents *= 10;
+        }
+        cents += roundUp ? 1 : 0;
+    }
+    if (!anyDigits) {
+        throw std::invalid_argument("Money: not a number: '" + std::string(number) + "'");
+    }
+
+    if (i < field.size() && (field[i] == 'e' || field[i] == 'E')) {
+        // An exponent, as streams and to_chars write large or tiny doubles
+        double value = 0;
+        if (number[0] == '+') {
+            number.remove_prefix(1);
+        }
+        std::from_chars_result result = std::from_chars(number.data(), number.data() + number.size(), value);
+        if (result.ec != std::errc()) {
+            throw std::out_of_range("Money: out of range: '" + std::string(number) + "'");
+        }
+        return fromDouble(value);
+    }
+
+    uint64_t total = whole * MINOR_PER_MAJOR + cents;
+    if (total > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())) {
+        throw std::out_of_range("Money: out of range: '" + std::string(number) + "'");
+    }
+    int64_t amount = static_cast<int64_t>(total);
+    return Money(negative ? -amount : amount);
+}
+
+std::ostream& operator<<(std::ostream& out, Money amount) {
+    char text[Money::MAX_TEXT];
+    return out << std::string_view(text, static_cast<size_t>(amount.format(text) - text));
+}
@@ -0,0 +1,100 @@
+#include "../include/ParallelLoader.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+unsigned int ParallelLoader::threadsFromEnvironment() {
+    const char* value = std::getenv("BANK_LOAD_THREADS");
+    if (value && *value) {
+        char* end = nullptr;
+        unsigned long parsed = std::strtoul(value, &end, 10);
+        if (end && *end == '\0' && parsed > 0) {
+            return static_cast<unsigned int>(std::min(parsed, 256ul));
+        }
+    }
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? hardware : 1;
+}
+
+ParallelLoader::ParallelLoader(unsigned int threads) : threads(std::max(threads, 1u)) {
+}
+
+void ParallelLoader::run(size_t count, const std::function<void(size_t)>& task) const {
+    std::atomic<size_t> next{0};
+    std::exception_ptr failure;
+    std::mutex failureMutex;
+
+    // Workers pull the next index until none are left, so uneven chunks
+    // still keep every thread busy
+    auto worker = [&]() {
+        for (size_t i = next++; i < count; i = next++) {
+            try {
+                task(i);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(failureMutex);
+                if (!failure) {
+                    failure = std::current_exception();
+                }
+                next = count;
+            }
+        }
+    };
+
+    size_t helpers = std::min<size_t>(threads, count);
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < helpers; i++) {
+        pool.emplace_back(worker);
+    }
+    worker();  // the calling thread is one of the workers
+    for (auto& thread : pool) {
+        thread.join();
+    }
+    if (failure) {
+        std::rethrow_exception(failure);
+    }
+}
+
+size_t ParallelLoader::chunkCount(size_t bytes, size_t minChunkBytes) const {
+    if (threads == 1) {
+        return 1;
+    }
+    // A few chunks per thread evens out lines of different lengths
+    size_t wanted = static_cast<size_t>(threads) * 4;
+    return std::max<size_t>(1, std::min(wanted, bytes / std::max<size_t>(minChunkBytes, 1)));
+}
+
+bool ParallelLoader::readFile(const std::string& path, std::string& contents) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    contents.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(&contents[0], static_cast<std::streamsize>(contents.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to read " + path);
+    }
+    return true;
+}
+
+std::vector<std::string_view> ParallelLoader::splitLines(std::string_view text, size_t pieces) {
+    std::vector<std::string_view> chunks;
+    size_t target = text.size() / std::max<size_t>(pieces, 1) + 1;
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = std::min(start + target, text.size());
+        if (end < text.size()) {
+            // Move the cut to just past the next newline
+            size_t newline = text.find('\n', end - 1);
+            end = newline == std::string_view::npos ? text.size() : newline + 1;
+        }
+        chunks.push_back(text.substr(start, end - start));
+        start = end;
+    }
+    return chunks;
+}
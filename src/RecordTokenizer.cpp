@@ -0,0 +1,46 @@
+#include "../include/RecordTokenizer.h"
+#include <charconv>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+
+namespace {
+
+// std::sto* skip leading whitespace and accept a '+' sign; from_chars does
+// neither
+std::string_view trimLeading(std::string_view field, bool allowPlus) {
+    if (!field.empty() && field[0] >= '0' && field[0] <= '9') {
+        return field;  // the usual case
+    }
+    size_t start = field.find_first_not_of(" \t\r\n");
+    field.remove_prefix(start == std::string_view::npos ? field.size() : start);
+    if (allowPlus && field.size() > 1 && field[0] == '+' && field[1] != '-') {
+        field.remove_prefix(1);
+    }
+    return field;
+}
+
+template <typename Number>
+Number parseNumber(std::string_view field, const char* name) {
+    field = trimLeading(field, true);
+    Number value{};
+    std::from_chars_result result = std::from_chars(field.data(), field.data() + field.size(), value);
+    if (result.ec == std::errc::invalid_argument) {
+        throw std::invalid_argument(std::string(name) + ": not a number: '" + std::string(field) + "'");
+    }
+    if (result.ec == std::errc::result_out_of_range) {
+        throw std::out_of_range(std::string(name) + ": out of range: '" + std::string(field) + "'");
+    }
+    return value;
+}
+
+} // namespace
+
+int RecordTokenizer::toInt(std::string_view field) {
+    return parseNumber<int>(field, "toInt");
+}
+
+uint64_t RecordTokenizer::toUnsigned(std::string_view field) {
+    // Unlike stoull, a minus sign is rejected rather than wrapped around
+    return parseNumber<uint64_t>(field, "toUnsigned");
+}
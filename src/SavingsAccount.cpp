@@ -1,43 +1,47 @@
 #include "../include/SavingsAccount.h"
 #include <stdexcept>
 
-SavingsAccount::SavingsAccount(int accNo, double initialBalance, Customer* owner, double interestRate, AccountType type)
+SavingsAccount::SavingsAccount(int accNo, Money initialBalance, Customer* owner, double interestRate, AccountType type)
     : Account(accNo, initialBalance, owner, type), interestRate(interestRate) {
     if (interestRate < 0) {
         throw std::invalid_argument("Interest rate cannot be negative");
     }
 }
 
-bool SavingsAccount::deposit(double amount) {
-    if (amount <= 0) {
-        return false;
-    }
-    try {
-        updateBalance(getBalance() + amount);
-        return true;
-    } catch (const std::exception&) {
+bool SavingsAccount::deposit(Money amount) {
+    if (amount <= Money()) {
         return false;
     }
+    return changeBalance(amount);
 }
 
-bool SavingsAccount::withdraw(double amount) {
-    if (amount <= 0 || amount > getBalance()) {
-        return false;
-    }
-    try {
-        updateBalance(getBalance() - amount);
-        return true;
-    } catch (const std::exception&) {
+bool SavingsAccount::withdraw(Money amount) {
+    if (amount <= Money()) {
         return false;
     }
+    return changeBalance(-amount);
 }
 
 void SavingsAccount::applyMonthlyUpdate() {
-    double interest = calculateInterest();
-    updateBalance(getBalance() + interest);
+    if (accruesLazily(type)) {
+        return; // accrue() adds the interest once the period has advanced
+    }
+    Money interest = calculateInterest();
+    changeBalance(interest);
+}
+
+Money SavingsAccount::accrue(Money storedBalance, uint32_t periods) const {
+    if (!accruesLazily(type)) {
+        return storedBalance;
+    }
+    // The same steps as an eager month-end, so the result is identical
+    for (uint32_t i = 0; i < periods; i++) {
+        storedBalance += storedBalance.times(interestRate / 12.0);
+    }
+    return storedBalance;
 }
 
-double SavingsAccount::calculateInterest() const {
-    return getBalance() * (interestRate / 12.0); // Monthly interest
+Money SavingsAccount::calculateInterest() const {
+    return getBalance().times(interestRate / 12.0); // Monthly interest, to the nearest cent
 } 
 
@@ -0,0 +1,122 @@
+#include "../include/SegmentFooter.h"
+#include "../include/TransactionIndex.h"
+#include "../include/RecordTokenizer.h"
+#include <algorithm>
+#include <sstream>
+
+std::string_view historyTimestamp(std::string_view line) {
+    std::string_view::size_type start = line.find(':');
+    if (start == std::string_view::npos) {
+        return std::string_view();
+    }
+    std::string_view::size_type end = line.find(':', start + 1);
+    if (end == std::string_view::npos) {
+        return std::string_view();
+    }
+    return line.substr(start + 1, end - start - 1);
+}
+
+bool timestampInRange(std::string_view timestamp, const std::string& from, const std::string& to) {
+    if (!from.empty() && timestamp < from) {
+        return false;
+    }
+    return to.empty() || timestamp.compare(0, to.size(), to) <= 0;
+}
+
+void SegmentFooter::include(std::string_view line) {
+    int accountNumber = TransactionIndex::accountOf(line);
+    if (accountNumber < 0) {
+        return;
+    }
+    lines++;
+    included.insert(accountNumber);
+    if (TransactionIndex::isClosure(line)) {
+        closedAccounts.push_back(accountNumber);
+    }
+
+    std::string_view timestamp = historyTimestamp(line);
+    if (!timestamp.empty()) {
+        if (minTimestamp.empty() || timestamp < minTimestamp) {
+            minTimestamp = timestamp;
+        }
+        if (maxTimestamp.empty() || timestamp > maxTimestamp) {
+            maxTimestamp = timestamp;
+        }
+    }
+}
+
+void SegmentFooter::seal() {
+    accounts = BloomFilter(included.size());
+    for (int accountNumber : included) {
+        accounts.add(accountNumber);
+    }
+    included.clear();
+}
+
+bool SegmentFooter::overlaps(const std::string& from, const std::string& to) const {
+    if (lines == 0) {
+        return false;
+    }
+    if (!from.empty() && maxTimestamp < from) {
+        return false;
+    }
+    return to.empty() || minTimestamp.compare(0, to.size(), to) <= 0;
+}
+
+bool SegmentFooter::closes(int accountNumber) const {
+    return std::find(closedAccounts.begin(), closedAccounts.end(), accountNumber) != closedAccounts.end();
+}
+
+std::string SegmentFooter::toLine() const {
+    std::ostringstream out;
+    out << MARKER << ":" << lines << ":"
+        << (minTimestamp.empty() ? "-" : minTimestamp) << ":"
+        << (maxTimestamp.empty() ? "-" : maxTimestamp) << ":";
+    if (closedAccounts.empty()) {
+        out << "-";
+    }
+    for (size_t i = 0; i < closedAccounts.size(); i++) {
+        out << (i ? "," : "") << closedAccounts[i];
+    }
+    out << ":" << accounts.serialize();
+    return out.str();
+}
+
+bool SegmentFooter::isFooter(std::string_view line) {
+    return line.compare(0, std::char_traits<char>::length(MARKER), MARKER) == 0;
+}
+
+bool SegmentFooter::parse(const std::string& line, SegmentFooter& footer) {
+    if (!isFooter(line)) {
+        return false;
+    }
+    std::string_view fields[6];
+    RecordTokenizer tokens(line);
+    size_t count = 0;
+    while (tokens.hasMore() && count < 6) {
+        fields[count++] = tokens.next();
+    }
+    if (count != 6 || tokens.hasMore()) {
+        return false;
+    }
+
+    SegmentFooter parsed;
+    try {
+        parsed.lines = RecordTokenizer::toUnsigned(fields[1]);
+        parsed.minTimestamp = fields[2] == "-" ? "" : std::string(fields[2]);
+        parsed.maxTimestamp = fields[3] == "-" ? "" : std::string(fields[3]);
+        if (fields[4] != "-") {
+            RecordTokenizer closed(fields[4], ',');
+            while (closed.hasMore()) {
+                parsed.closedAccounts.push_back(RecordTokenizer::toInt(closed.next()));
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (!BloomFilter::parse(fields[5], parsed.accounts)) {
+        return false;
+    }
+    footer = std::move(parsed);
+    return true;
+}
@@ -0,0 +1,104 @@
+#include "../include/Sequencer.h"
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <string>
+
+namespace {
+
+// Yields before going to sleep, so a steady stream of commands does not
+// pay for a wakeup each time
+constexpr int IDLE_YIELDS = 64;
+
+// Upper bound on a sleep, in case a wakeup is missed
+constexpr auto IDLE_SLEEP = std::chrono::milliseconds(10);
+
+} // namespace
+
+bool Sequencer::enabledFromEnvironment() {
+    const char* value = std::getenv("BANK_ENGINE");
+    return value && std::string(value) == "sequencer";
+}
+
+Sequencer::Sequencer(Processor processor)
+    : processor(std::move(processor)), ring(CAPACITY), sleeping(false), stopping(false), batches(0),
+      commands(0), thread(&Sequencer::run, this) {
+}
+
+Sequencer::~Sequencer() {
+    stopping = true;
+    wake();
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+Sequencer::Result Sequencer::submit(Kind kind, int account, int toAccount, Money amount) {
+    Command command{kind, account, toAccount, amount, Result::DONE, std::promise<Result>()};
+    std::future<Result> result = command.done.get_future();
+    // A full buffer means the sequencer is behind; wait for it to catch up
+    while (!ring.tryPush(&command)) {
+        wake();
+        std::this_thread::yield();
+    }
+    wake();
+    return result.get();
+}
+
+void Sequencer::wake() {
+    // Pairs with the fence in run(): either this sees sleeping or the
+    // sequencer sees the command just published
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_relaxed)) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        wakeup.notify_one();
+    }
+}
+
+void Sequencer::run() {
+    std::vector<Command*> batch;
+    batch.reserve(MAX_BATCH);
+    int idle = 0;
+    while (true) {
+        Command* command;
+        while (batch.size() < MAX_BATCH && ring.tryPop(command)) {
+            batch.push_back(command);
+        }
+
+        if (batch.empty()) {
+            if (stopping) {
+                return;
+            }
+            if (++idle < IDLE_YIELDS) {
+                std::this_thread::yield();
+                continue;
+            }
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!ring.tryPop(command)) {
+                wakeup.wait_for(lock, IDLE_SLEEP);
+                sleeping = false;
+                continue;
+            }
+            sleeping = false;
+            batch.push_back(command);
+        }
+        idle = 0;
+
+        try {
+            processor(batch);
+            for (Command* finished : batch) {
+                finished->done.set_value(finished->result);
+            }
+        } catch (...) {
+            std::exception_ptr error = std::current_exception();
+            for (Command* failed : batch) {
+                failed->done.set_exception(error);
+            }
+        }
+        batches++;
+        commands += batch.size();
+        batch.clear();
+    }
+}
@@ -0,0 +1,325 @@
+#include "../include/SharedImage.h"
+#include "../include/Journal.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#ifndef _WIN32
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool SharedImage::enabledFromEnvironment() {
+    const char* value = std::getenv("BANK_SHM");
+    return value && *value && std::string(value) != "0";
+}
+
+#ifndef _WIN32
+
+namespace {
+
+constexpr char CONTROL_MAGIC[8] = {'B', 'A', 'N', 'K', 'S', 'H', 'M', 'C'};
+constexpr uint32_t CONTROL_VERSION = 1;
+
+// How long to wait for another process to finish creating the control block
+constexpr int CONTROL_WAIT_MS = 1000;
+
+bool sameFile(const SharedImage::FileStamp& a, const SharedImage::FileStamp& b) {
+    return a.exists == b.exists && a.device == b.device && a.inode == b.inode;
+}
+
+bool sameContents(const SharedImage::FileStamp& a, const SharedImage::FileStamp& b) {
+    return sameFile(a, b) && a.size == b.size && a.modifiedSeconds == b.modifiedSeconds &&
+           a.modifiedNanoseconds == b.modifiedNanoseconds;
+}
+
+bool writeAll(int fd, const std::string& bytes) {
+    size_t written = 0;
+    while (written < bytes.size()) {
+        ssize_t n = ::write(fd, bytes.data() + written, bytes.size() - written);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return false;
+        }
+        written += static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+struct SharedImage::Control {
+    char magic[8];
+    uint32_t version;
+    uint32_t ready;           // set by the creator once the mutex is initialised
+    pthread_mutex_t mutex;    // process-shared and robust
+    uint64_t generation;      // current image; 0 if there is none
+    uint64_t lastGeneration;  // last number handed out
+    uint64_t imageSize;
+    Sources sources;
+
+    bool lock() {
+        int result = pthread_mutex_lock(&mutex);
+        if (result == EOWNERDEAD) {
+            // The holder died, possibly halfway through an update
+            pthread_mutex_consistent(&mutex);
+            generation = 0;
+            result = 0;
+        }
+        return result == 0;
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&mutex);
+    }
+};
+
+SharedImage::SharedImage(const std::string& dataDir) : control(nullptr), knownGeneration(0) {
+    // One control block per data directory, however it is spelled
+    char* resolved = realpath(dataDir.c_str(), nullptr);
+    std::string directory = resolved ? resolved : dataDir;
+    std::free(resolved);
+    char key[17];
+    std::snprintf(key, sizeof(key), "%016llx",
+                  static_cast<unsigned long long>(Journal::extendHash(Journal::EMPTY_HASH, directory)));
+    name = std::string("/bank-") + key;
+    openControl();
+}
+
+SharedImage::~SharedImage() {
+    for (const auto& mapping : mappings) {
+        munmap(mapping.first, mapping.second);
+    }
+    if (control) {
+        munmap(control, sizeof(Control));
+    }
+}
+
+void SharedImage::openControl() {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    bool creator = fd >= 0;
+    if (!creator) {
+        if (errno != EEXIST) {
+            return;
+        }
+        fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            return;
+        }
+    } else if (ftruncate(fd, sizeof(Control)) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return;
+    }
+
+    // A block still being created by another process is empty at first
+    struct stat st;
+    int waited = 0;
+    while (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) < sizeof(Control) && waited < CONTROL_WAIT_MS) {
+        usleep(1000);
+        waited++;
+    }
+    if (static_cast<size_t>(st.st_size) < sizeof(Control)) {
+        ::close(fd);
+        return;
+    }
+    void* mapped = mmap(nullptr, sizeof(Control), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        return;
+    }
+    Control* block = static_cast<Control*>(mapped);
+
+    if (creator) {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&block->mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+        std::memcpy(block->magic, CONTROL_MAGIC, sizeof(CONTROL_MAGIC));
+        block->version = CONTROL_VERSION;
+        __atomic_store_n(&block->ready, 1u, __ATOMIC_RELEASE);
+    } else {
+        while (__atomic_load_n(&block->ready, __ATOMIC_ACQUIRE) == 0 && waited < CONTROL_WAIT_MS) {
+            usleep(1000);
+            waited++;
+        }
+    }
+    if (__atomic_load_n(&block->ready, __ATOMIC_ACQUIRE) == 0 ||
+        std::memcmp(block->magic, CONTROL_MAGIC, sizeof(CONTROL_MAGIC)) != 0 || block->version != CONTROL_VERSION) {
+        munmap(block, sizeof(Control));
+        return;
+    }
+    control = block;
+}
+
+std::string SharedImage::imageName(uint64_t generation) const {
+    return name + "." + std::to_string(generation);
+}
+
+SharedImage::FileStamp SharedImage::stamp(const std::string& path) {
+    FileStamp result{};
+    struct stat st;
+    if (stat(path.c_str(), &st) == 0) {
+        result.exists = 1;
+        result.device = static_cast<uint64_t>(st.st_dev);
+        result.inode = static_cast<uint64_t>(st.st_ino);
+        result.size = static_cast<uint64_t>(st.st_size);
+#ifdef __APPLE__
+        result.modifiedSeconds = st.st_mtimespec.tv_sec;
+        result.modifiedNanoseconds = st.st_mtimespec.tv_nsec;
+#else
+        result.modifiedSeconds = st.st_mtim.tv_sec;
+        result.modifiedNanoseconds = st.st_mtim.tv_nsec;
+#endif
+    }
+    return result;
+}
+
+SharedImage::Sources SharedImage::stampFiles(const std::vector<std::string>& files, const std::string& accountStore) {
+    Sources sources{};
+    sources.fileCount = static_cast<uint32_t>(std::min(files.size(), MAX_FILES));
+    for (uint32_t i = 0; i < sources.fileCount; i++) {
+        sources.files[i] = stamp(files[i]);
+    }
+    sources.accountStore = stamp(accountStore);
+    sources.journalHash = Journal::EMPTY_HASH;
+    return sources;
+}
+
+bool SharedImage::attach(const std::string& journalPath, Sources& sources, const char*& data, size_t& size) {
+    if (!control || !control->lock()) {
+        return false;
+    }
+    const Sources& built = control->sources;
+    bool matches = control->generation != 0 && built.fileCount == sources.fileCount &&
+                   sameFile(built.accountStore, sources.accountStore) &&
+                   Journal::fileStartsWith(journalPath, built.journalBytes, built.journalHash);
+    for (uint32_t i = 0; matches && i < sources.fileCount; i++) {
+        matches = sameContents(built.files[i], sources.files[i]);
+    }
+
+    void* mapped = MAP_FAILED;
+    if (matches) {
+        // Mapped under the lock, so a publisher cannot unlink it first
+        int fd = shm_open(imageName(control->generation).c_str(), O_RDONLY, 0);
+        if (fd >= 0) {
+            mapped = mmap(nullptr, control->imageSize, PROT_READ, MAP_SHARED, fd, 0);
+            ::close(fd);
+        }
+    }
+    if (mapped != MAP_FAILED) {
+        size = control->imageSize;
+        data = static_cast<const char*>(mapped);
+        sources = built;
+        knownGeneration = control->generation;
+        mappings.emplace_back(mapped, size);
+    }
+    control->unlock();
+    return mapped != MAP_FAILED;
+}
+
+bool SharedImage::publish(const Sources& sources, const std::string& image) {
+    if (!control || !control->lock()) {
+        return false;
+    }
+    uint64_t generation = ++control->lastGeneration;
+    control->unlock();
+
+    // Written before it is made current, so readers never see it partial
+    std::string objectName = imageName(generation);
+    int fd = shm_open(objectName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = writeAll(fd, image);
+    ::close(fd);
+    if (!written || !control->lock()) {
+        shm_unlink(objectName.c_str());
+        return false;
+    }
+    // Whoever maps the old generation keeps it until they unmap it
+    if (control->generation != 0) {
+        shm_unlink(imageName(control->generation).c_str());
+    }
+    control->generation = generation;
+    control->imageSize = image.size();
+    control->sources = sources;
+    control->unlock();
+    knownGeneration = generation;
+    return true;
+}
+
+bool SharedImage::extend(uint64_t journalBytes, uint64_t journalHash) {
+    if (!control || knownGeneration == 0 || !control->lock()) {
+        return false;
+    }
+    bool current = control->generation == knownGeneration && journalBytes > control->sources.journalBytes;
+    if (current) {
+        control->sources.journalBytes = journalBytes;
+        control->sources.journalHash = journalHash;
+    }
+    control->unlock();
+    return current;
+}
+
+#else
+
+struct SharedImage::Control {
+};
+
+SharedImage::SharedImage(const std::string& dataDir) : control(nullptr), knownGeneration(0) {
+    (void)dataDir;
+}
+
+SharedImage::~SharedImage() {
+}
+
+void SharedImage::openControl() {
+}
+
+std::string SharedImage::imageName(uint64_t generation) const {
+    return name + "." + std::to_string(generation);
+}
+
+SharedImage::FileStamp SharedImage::stamp(const std::string& path) {
+    (void)path;
+    return FileStamp{};
+}
+
+SharedImage::Sources SharedImage::stampFiles(const std::vector<std::string>& files, const std::string& accountStore) {
+    (void)files;
+    (void)accountStore;
+    Sources sources{};
+    sources.journalHash = Journal::EMPTY_HASH;
+    return sources;
+}
+
+bool SharedImage::attach(const std::string& journalPath, Sources& sources, const char*& data, size_t& size) {
+    (void)journalPath;
+    (void)sources;
+    (void)data;
+    (void)size;
+    return false;
+}
+
+bool SharedImage::publish(const Sources& sources, const std::string& image) {
+    (void)sources;
+    (void)image;
+    return false;
+}
+
+bool SharedImage::extend(uint64_t journalBytes, uint64_t journalHash) {
+    (void)journalBytes;
+    (void)journalHash;
+    return false;
+}
+
+#endif
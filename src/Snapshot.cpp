@@ -0,0 +1,314 @@
+#include "../include/Snapshot.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(Snapshot::Header) == 136, "snapshot header layout changed");
+static_assert(offsetof(Snapshot::Header, accountLists) == Snapshot::V1_HEADER_SIZE, "version 1 header prefix changed");
+static_assert(sizeof(Snapshot::CustomerRecord) == 24, "customer record layout changed");
+static_assert(sizeof(Snapshot::AccountRecord) == 24, "account record layout changed");
+static_assert(sizeof(Snapshot::UserRecord) == 24, "user record layout changed");
+static_assert(sizeof(Snapshot::AccountAuthRecord) == 16, "account auth record layout changed");
+static_assert(sizeof(Snapshot::AccountList) == 8, "account list layout changed");
+
+namespace {
+
+// Tables start on an 8-byte boundary so records can be read in place
+uint64_t align(uint64_t offset) {
+    return (offset + 7) & ~uint64_t(7);
+}
+
+// Pads up to offset, then appends bytes
+void writeAt(std::string& out, uint64_t offset, const void* bytes, size_t length) {
+    out.resize(static_cast<size_t>(offset), '\0');
+    out.append(static_cast<const char*>(bytes), length);
+}
+
+template <typename Record>
+void writeTable(std::string& out, const std::vector<Record>& records, uint64_t offset) {
+    writeAt(out, offset, records.data(), records.size() * sizeof(Record));
+}
+
+// Reorders records by a permutation of their indexes
+template <typename Record>
+void permute(std::vector<Record>& records, const std::vector<size_t>& order) {
+    std::vector<Record> sorted;
+    sorted.reserve(records.size());
+    for (size_t i : order) {
+        sorted.push_back(records[i]);
+    }
+    records.swap(sorted);
+}
+
+} // namespace
+
+Snapshot::StringRef Snapshot::Writer::addString(std::string_view text) {
+    if (strings.size() + text.size() > std::numeric_limits<uint32_t>::max()) {
+        throw std::runtime_error("Snapshot string heap is full");
+    }
+    StringRef ref{static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(text.size())};
+    strings += text;
+    return ref;
+}
+
+void Snapshot::Writer::addCustomer(int id, std::string_view name, std::string_view phone,
+                                   const std::vector<int>& accounts) {
+    customers.push_back(CustomerRecord{id, 0, addString(name), addString(phone)});
+    accountLists.push_back(AccountList{static_cast<uint32_t>(accountNumbers.size()),
+                                       static_cast<uint32_t>(accounts.size())});
+    accountNumbers.insert(accountNumbers.end(), accounts.begin(), accounts.end());
+}
+
+void Snapshot::Writer::addUser(std::string_view username, int customerId, std::string_view password) {
+    users.push_back(UserRecord{customerId, 0, addString(username), addString(password)});
+}
+
+void Snapshot::Writer::addAccountPassword(int accountNumber, std::string_view password) {
+    accountAuth.push_back(AccountAuthRecord{accountNumber, 0, addString(password)});
+}
+
+void Snapshot::Writer::setCounters(int nextCustomerId, int nextAccountNumber) {
+    this->nextCustomerId = nextCustomerId;
+    this->nextAccountNumber = nextAccountNumber;
+}
+
+std::string Snapshot::Writer::serialize() {
+    // Sort by key; account lists move with their customers
+    std::vector<size_t> order(customers.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return customers[a].id < customers[b].id; });
+    permute(customers, order);
+    permute(accountLists, order);
+    std::sort(users.begin(), users.end(), [this](const UserRecord& a, const UserRecord& b) {
+        return text(a.username) < text(b.username);
+    });
+    std::sort(accountAuth.begin(), accountAuth.end(), [](const AccountAuthRecord& a, const AccountAuthRecord& b) {
+        return a.accountNumber < b.accountNumber;
+    });
+
+    Header header{};
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.nextCustomerId = nextCustomerId;
+    header.nextAccountNumber = nextAccountNumber;
+
+    uint64_t offset = sizeof(Header);
+    header.customers = Table{offset, customers.size()};
+    offset = align(offset + customers.size() * sizeof(CustomerRecord));
+    header.accounts = Table{offset, 0};
+    header.users = Table{offset, users.size()};
+    offset = align(offset + users.size() * sizeof(UserRecord));
+    header.accountAuth = Table{offset, accountAuth.size()};
+    offset = align(offset + accountAuth.size() * sizeof(AccountAuthRecord));
+    header.strings = Table{offset, strings.size()};
+    offset = align(offset + strings.size());
+    header.accountLists = Table{offset, accountLists.size()};
+    offset = align(offset + accountLists.size() * sizeof(AccountList));
+    header.accountNumbers = Table{offset, accountNumbers.size()};
+
+    std::string out;
+    out.reserve(static_cast<size_t>(header.accountNumbers.offset + accountNumbers.size() * sizeof(int32_t)));
+    writeAt(out, 0, &header, sizeof(header));
+    writeTable(out, customers, header.customers.offset);
+    writeTable(out, users, header.users.offset);
+    writeTable(out, accountAuth, header.accountAuth.offset);
+    writeAt(out, header.strings.offset, strings.data(), strings.size());
+    writeTable(out, accountLists, header.accountLists.offset);
+    writeTable(out, accountNumbers, header.accountNumbers.offset);
+    return out;
+}
+
+void Snapshot::Writer::write(const std::string& path) {
+    std::string bytes = serialize();
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open snapshot file for writing");
+    }
+    file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    file.close();
+    if (!file.good()) {
+        throw std::runtime_error("Failed to write snapshot file");
+    }
+}
+
+Snapshot::~Snapshot() {
+    close();
+}
+
+bool Snapshot::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return false;
+    }
+    buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    if (!file) {
+        throw std::runtime_error("Failed to read snapshot " + path);
+    }
+    data = buffer.data();
+    size = buffer.size();
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Failed to stat snapshot " + path);
+    }
+    size = static_cast<size_t>(st.st_size);
+    if (size > 0) {
+        mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            mapping = nullptr;
+            ::close(fd);
+            throw std::runtime_error("Failed to map snapshot " + path);
+        }
+        data = static_cast<const char*>(mapping);
+    }
+    ::close(fd);
+#endif
+    try {
+        readHeader(path);
+    } catch (...) {
+        close();
+        throw;
+    }
+    return true;
+}
+
+void Snapshot::openImage(const char* bytes, size_t length, const std::string& name) {
+    close();
+    data = bytes;
+    size = length;
+    try {
+        readHeader(name);
+    } catch (...) {
+        close();
+        throw;
+    }
+}
+
+void Snapshot::close() {
+#ifndef _WIN32
+    if (mapping) {
+        munmap(mapping, size);
+    }
+#endif
+    mapping = nullptr;
+    buffer.clear();
+    data = nullptr;
+    size = 0;
+    info = Header{};
+}
+
+void Snapshot::readHeader(const std::string& path) {
+    if (size < V1_HEADER_SIZE || std::memcmp(data, MAGIC, sizeof(MAGIC)) != 0) {
+        throw std::runtime_error("Not a snapshot file: " + path);
+    }
+    // Version 1 headers end before the version 2 tables, which stay empty
+    info = Header{};
+    std::memcpy(&info, data, V1_HEADER_SIZE);
+    if (info.byteOrder != BYTE_ORDER_MARK) {
+        throw std::runtime_error("Snapshot was written with a different byte order: " + path);
+    }
+    if (info.version < 1 || info.version > VERSION) {
+        throw std::runtime_error("Unsupported snapshot version " + std::to_string(info.version) + ": " + path);
+    }
+    if (info.version >= 2) {
+        if (size < sizeof(Header)) {
+            throw std::runtime_error("Truncated snapshot header: " + path);
+        }
+        std::memcpy(&info, data, sizeof(Header));
+    }
+
+    auto check = [&](const Table& where, size_t recordSize) {
+        if (where.count == 0) {
+            return;
+        }
+        if (where.offset % 8 != 0 || where.offset > size ||
+            where.count > (size - where.offset) / recordSize) {
+            throw std::runtime_error("Snapshot table out of bounds: " + path);
+        }
+    };
+    check(info.customers, sizeof(CustomerRecord));
+    check(info.accounts, sizeof(AccountRecord));
+    check(info.users, sizeof(UserRecord));
+    check(info.accountAuth, sizeof(AccountAuthRecord));
+    check(info.strings, 1);
+    check(info.accountLists, sizeof(AccountList));
+    check(info.accountNumbers, sizeof(int32_t));
+    if (info.accountLists.count != 0 && info.accountLists.count != info.customers.count) {
+        throw std::runtime_error("Snapshot account lists do not match its customers: " + path);
+    }
+}
+
+std::vector<int> Snapshot::customerAccounts(size_t i) const {
+    if (i >= info.accountLists.count) {
+        return {};
+    }
+    const AccountList& list = table<AccountList>(info.accountLists)[i];
+    if (static_cast<uint64_t>(list.offset) + list.count > info.accountNumbers.count) {
+        throw std::runtime_error("Snapshot account list out of bounds");
+    }
+    const int32_t* numbers = table<int32_t>(info.accountNumbers) + list.offset;
+    return std::vector<int>(numbers, numbers + list.count);
+}
+
+bool Snapshot::findCustomer(int id, size_t& index) const {
+    const CustomerRecord* first = table<CustomerRecord>(info.customers);
+    const CustomerRecord* last = first + info.customers.count;
+    const CustomerRecord* it = std::lower_bound(first, last, id,
+        [](const CustomerRecord& record, int key) { return record.id < key; });
+    if (it == last || it->id != id) {
+        return false;
+    }
+    index = static_cast<size_t>(it - first);
+    return true;
+}
+
+bool Snapshot::findUser(std::string_view username, size_t& index) const {
+    const UserRecord* first = table<UserRecord>(info.users);
+    const UserRecord* last = first + info.users.count;
+    const UserRecord* it = std::lower_bound(first, last, username,
+        [this](const UserRecord& record, std::string_view key) { return text(record.username) < key; });
+    if (it == last || text(it->username) != username) {
+        return false;
+    }
+    index = static_cast<size_t>(it - first);
+    return true;
+}
+
+bool Snapshot::findAccountAuth(int accountNumber, size_t& index) const {
+    const AccountAuthRecord* first = table<AccountAuthRecord>(info.accountAuth);
+    const AccountAuthRecord* last = first + info.accountAuth.count;
+    const AccountAuthRecord* it = std::lower_bound(first, last, accountNumber,
+        [](const AccountAuthRecord& record, int key) { return record.accountNumber < key; });
+    if (it == last || it->accountNumber != accountNumber) {
+        return false;
+    }
+    index = static_cast<size_t>(it - first);
+    return true;
+}
+
+std::string_view Snapshot::text(StringRef ref) const {
+    const Table& strings = info.strings;
+    if (static_cast<uint64_t>(ref.offset) + ref.length > strings.count) {
+        throw std::runtime_error("Snapshot string out of bounds");
+    }
+    return std::string_view(data + strings.offset + ref.offset, ref.length);
+}
@@ -9,17 +9,21 @@
 #include <chrono>
 #include <fstream>
 
-// Helper function for safe double input
-static double getDoubleInput(const std::string& prompt) {
-    double value;
+// Helper function for safe amount input
+static Money getMoneyInput(const std::string& prompt) {
+    std::string text;
     while (true) {
         std::cout << prompt;
-        if (std::cin >> value) {
+        if (std::cin >> text) {
             std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
-            return value;
+            try {
+                return Money::parse(text);
+            } catch (const std::exception&) {
+            }
+        } else {
+            std::cin.clear();  // Clear error flags
+            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');  // Clear input buffer
         }
-        std::cin.clear();  // Clear error flags
-        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');  // Clear input buffer
         std::cout << "Invalid input! Please enter a valid number." << std::endl;
     }
 }
@@ -69,7 +73,7 @@ void transactionFun(int accountNumber) {
 
     Database* db = Database::getInstance();
     int choice;
-    double amount;
+    Money amount;
     int targetAccount;
 
     while (true) {
@@ -93,9 +97,9 @@ void transactionFun(int accountNumber) {
 
         switch (choice) {
             case 1: { // Deposit
-                amount = getDoubleInput("Enter amount to deposit: $");
+                amount = getMoneyInput("Enter amount to deposit: $");
                 
-                if (amount <= 0) {
+                if (amount <= Money()) {
                     std::cout << "Invalid amount. Please enter a positive number.\n";
                     break;
                 }
@@ -106,6 +110,8 @@ void transactionFun(int accountNumber) {
                     break;
                 }
 
+                // Other processes may be changing the same balance
+                auto lock = db->lockAccounts({accountNumber});
                 auto deposit = std::make_unique<Deposit>(account, amount);
                 if (deposit->execute()) {
                     if (db->addTransaction(accountNumber, std::move(deposit))) {
@@ -125,9 +131,9 @@ void transactionFun(int accountNumber) {
                 break;
             }
             case 2: { // Withdraw
-                amount = getDoubleInput("Enter amount to withdraw: $");
+                amount = getMoneyInput("Enter amount to withdraw: $");
                 
-                if (amount <= 0) {
+                if (amount <= Money()) {
                     std::cout << "Invalid amount. Please enter a positive number.\n";
                     break;
                 }
@@ -138,6 +144,7 @@ void transactionFun(int accountNumber) {
                     break;
                 }
 
+                auto lock = db->lockAccounts({accountNumber});
                 auto withdrawal = std::make_unique<Withdrawal>(account, amount);
                 if (withdrawal->execute()) {
                     if (db->addTransaction(accountNumber, std::move(withdrawal))) {
@@ -165,9 +172,9 @@ void transactionFun(int accountNumber) {
                     break;
                 }
                 
-                amount = getDoubleInput("Enter amount to transfer: $");
+                amount = getMoneyInput("Enter amount to transfer: $");
 
-                if (amount <= 0) {
+                if (amount <= Money()) {
                     std::cout << "Invalid amount. Please enter a positive number.\n";
                     break;
                 }
@@ -180,20 +187,18 @@ void transactionFun(int accountNumber) {
                     break;
                 }
 
-                auto transfer = std::make_unique<Transfer>(fromAccount, toAccount, amount);
-                if (transfer->execute()) {
-                    if (db->addTransaction(accountNumber, std::move(transfer))) {
-                        std::cout << "\n┌─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─┐" << std::endl;
-                        std::cout << "│         Transaction Result        │" << std::endl;
-                        std::cout << "├───────────────────────────────────┤" << std::endl;
-                        std::cout << "│ Transfer Successful!              │" << std::endl;
-                        std::cout << "│ Receiving Account: " << std::setw(15) << targetAccount << "│" << std::endl;
-                        std::cout << "│ Amount Transferred: $" << std::fixed << std::setprecision(2) << std::setw(12) << amount << " │" << std::endl;
-                        std::cout << "│ Updated Balance:    $" << std::fixed << std::setprecision(2) << std::setw(12) << fromAccount->getBalance() << " │" << std::endl;
-                        std::cout << "└─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─┘" << std::endl;
-                    } else {
-                        std::cout << "Failed to record transfer transaction.\n";
-                    }
+                Database::TransferResult result = db->transfer(accountNumber, targetAccount, amount);
+                if (result == Database::TransferResult::DONE) {
+                    std::cout << "\n┌─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─┐" << std::endl;
+                    std::cout << "│         Transaction Result        │" << std::endl;
+                    std::cout << "├───────────────────────────────────┤" << std::endl;
+                    std::cout << "│ Transfer Successful!              │" << std::endl;
+                    std::cout << "│ Receiving Account: " << std::setw(15) << targetAccount << "│" << std::endl;
+                    std::cout << "│ Amount Transferred: $" << std::fixed << std::setprecision(2) << std::setw(12) << amount << " │" << std::endl;
+                    std::cout << "│ Updated Balance:    $" << std::fixed << std::setprecision(2) << std::setw(12) << fromAccount->getBalance() << " │" << std::endl;
+                    std::cout << "└─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─x─┘" << std::endl;
+                } else if (result == Database::TransferResult::NO_ACCOUNT) {
+                    std::cout << "Sender or Receiver Account not found.\n";
                 } else {
                     std::cout << "Transfer failed.\n";
                 }
@@ -258,8 +263,10 @@ void closeAccount(int accountNumber) {
         return;
     }
 
-    double remainingBalance = account->getBalance();
-    if (remainingBalance > 0) {
+    auto lock = db->lockAccounts({accountNumber});
+
+    Money remainingBalance = account->getBalance();
+    if (remainingBalance > Money()) {
         // Create and execute withdrawal for remaining balance
         auto withdrawal = std::make_unique<Withdrawal>(account, remainingBalance);
         if (withdrawal->execute()) {
@@ -288,19 +295,20 @@ void closeAccount(int accountNumber) {
 }
 
 // Deposit implementation
-Deposit::Deposit(Account* account, double amount)
+Deposit::Deposit(Account* account, Money amount)
     : account(account), amount(amount), type(TransactionType::DEPOSIT) {
     if (!account) {
         throw std::invalid_argument("Account cannot be null");
     }
-    if (amount <= 0) {
+    if (amount <= Money()) {
         throw std::invalid_argument("Amount must be positive");
     }
     // Set current timestamp
     auto now = std::chrono::system_clock::now();
     auto now_time_t = std::chrono::system_clock::to_time_t(now);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&now_time_t), "%Y-%m-%d %H-%M-%S");
+    std::tm local = localTime(now_time_t);
+    ss << std::put_time(&local, "%Y-%m-%d %H-%M-%S");
     timestamp = ss.str();
 }
 
@@ -314,19 +322,20 @@ bool Deposit::undo() {
 }
 
 // Withdrawal implementation
-Withdrawal::Withdrawal(Account* account, double amount)
+Withdrawal::Withdrawal(Account* account, Money amount)
     : account(account), amount(amount), type(TransactionType::WITHDRAWAL) {
     if (!account) {
         throw std::invalid_argument("Account cannot be null");
     }
-    if (amount <= 0) {
+    if (amount <= Money()) {
         throw std::invalid_argument("Amount must be positive");
     }
     // Set current timestamp
     auto now = std::chrono::system_clock::now();
     auto now_time_t = std::chrono::system_clock::to_time_t(now);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&now_time_t), "%Y-%m-%d %H-%M-%S");
+    std::tm local = localTime(now_time_t);
+    ss << std::put_time(&local, "%Y-%m-%d %H-%M-%S");
     timestamp = ss.str();
 }
 
@@ -340,12 +349,12 @@ bool Withdrawal::undo() {
 }
 
 // Transfer implementation
-Transfer::Transfer(Account* from, Account* to, double amount)
+Transfer::Transfer(Account* from, Account* to, Money amount)
     : fromAccount(from), toAccount(to), amount(amount), type(TransactionType::TRANSFER) {
     if (!from || !to) {
         throw std::invalid_argument("Accounts cannot be null");
     }
-    if (amount <= 0) {
+    if (amount <= Money()) {
         throw std::invalid_argument("Amount must be positive");
     }
     if (from == to) {
@@ -355,7 +364,8 @@ Transfer::Transfer(Account* from, Account* to, double amount)
     auto now = std::chrono::system_clock::now();
     auto now_time_t = std::chrono::system_clock::to_time_t(now);
     std::stringstream ss;
-    ss << std::put_time(std::localtime(&now_time_t), "%Y-%m-%d %H-%M-%S");
+    std::tm local = localTime(now_time_t);
+    ss << std::put_time(&local, "%Y-%m-%d %H-%M-%S");
     timestamp = ss.str();
 }
 
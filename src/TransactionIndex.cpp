@@ -0,0 +1,678 @@
+#include "../include/TransactionIndex.h"
+#include "../include/RecordTokenizer.h"
+#include "../include/LineScanner.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+struct IndexEntry {
+    int accountNumber;
+    uint64_t offset;
+    uint64_t length;
+};
+
+bool parseIndexEntry(const std::string& line, IndexEntry& entry) {
+    char sep1 = 0, sep2 = 0;
+    unsigned long long offset = 0, length = 0;
+    if (std::sscanf(line.c_str(), "%d%c%llu%c%llu", &entry.accountNumber, &sep1, &offset, &sep2, &length) != 5 ||
+        sep1 != ':' || sep2 != ':' || length == 0) {
+        return false;
+    }
+    entry.offset = offset;
+    entry.length = length;
+    return true;
+}
+
+uint64_t envNumber(const char* name, uint64_t fallback) {
+    const char* value = std::getenv(name);
+    if (!value || !*value) {
+        return fallback;
+    }
+    try {
+        return std::stoull(value);
+    } catch (const std::exception&) {
+        return fallback;
+    }
+}
+
+std::string directoryOf(const std::string& path) {
+    std::string::size_type slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? "." : path.substr(0, slash);
+}
+
+// Last line of a file, without its newline
+std::string readLastLine(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return "";
+    }
+    std::streamoff end = file.tellg();
+    if (end <= 0) {
+        return "";
+    }
+    // Footers are a few KB at most; read backwards until a line break
+    std::string tail;
+    const std::streamoff chunk = 4096;
+    std::streamoff start = end;
+    while (start > 0) {
+        std::streamoff readFrom = start > chunk ? start - chunk : 0;
+        std::string block(static_cast<size_t>(start - readFrom), '\0');
+        file.seekg(readFrom);
+        file.read(&block[0], static_cast<std::streamsize>(block.size()));
+        tail = block + tail;
+        start = readFrom;
+        if (tail.size() >= 2) {
+            std::string::size_type lastBreak = tail.find_last_of('\n', tail.size() - 2);
+            if (lastBreak != std::string::npos) {
+                tail = tail.substr(lastBreak + 1);
+                break;
+            }
+        }
+    }
+    if (!tail.empty() && tail.back() == '\n') {
+        tail.pop_back();
+    }
+    return tail;
+}
+
+// "%Y-%m-%d %H-%M-%S" in local time, as written by the transactions
+std::time_t parseTimestamp(const std::string& timestamp) {
+    std::tm tm = {};
+    std::istringstream in(timestamp);
+    in >> std::get_time(&tm, "%Y-%m-%d %H-%M-%S");
+    if (in.fail()) {
+        return std::time(nullptr);
+    }
+    tm.tm_isdst = -1;
+    return std::mktime(&tm);
+}
+
+} // namespace
+
+int TransactionIndex::accountOf(std::string_view line) {
+    // The account number is a few bytes long, too short for a vector search
+    std::string_view::size_type colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0 || SegmentFooter::isFooter(line)) {
+        return -1;
+    }
+    try {
+        return RecordTokenizer::toInt(line.substr(0, colon));
+    } catch (const std::exception&) {
+        return -1;
+    }
+}
+
+bool TransactionIndex::isClosure(std::string_view line) {
+    // The timestamp contains no colon, so the type is the third field
+    const char* end = line.data() + line.size();
+    const char* typeStart = LineScanner::find(line.data(), end, ':');
+    typeStart = typeStart == end ? end : LineScanner::find(typeStart + 1, end, ':');
+    return typeStart != end && std::string_view(typeStart + 1, static_cast<size_t>(end - typeStart - 1)) == CLOSED_TYPE;
+}
+
+TransactionIndex::TransactionIndex(const std::string& historyPath, const std::string& indexPath)
+    : historyPath(historyPath), indexPath(indexPath), segmentsLoaded(false), indexedEnd(0), loaded(false),
+      segmentBytes(envNumber("BANK_SEGMENT_BYTES", DEFAULT_SEGMENT_BYTES)),
+      segmentSeconds(static_cast<unsigned int>(envNumber("BANK_SEGMENT_SECONDS", 0))),
+      activeEnd(0), activeStart(0) {
+    if (segmentBytes == 0) {
+        segmentBytes = DEFAULT_SEGMENT_BYTES;
+    }
+}
+
+uint64_t TransactionIndex::fileSize(const std::string& path) {
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file.is_open()) {
+        return 0;
+    }
+    std::streamoff size = file.tellg();
+    return size > 0 ? static_cast<uint64_t>(size) : 0;
+}
+
+std::string TransactionIndex::segmentPath(unsigned int id) const {
+    std::string base = historyPath;
+    if (base.size() > 4 && base.compare(base.size() - 4, 4, ".txt") == 0) {
+        base.resize(base.size() - 4);
+    }
+    std::ostringstream path;
+    path << base << "." << std::setw(6) << std::setfill('0') << id << ".txt";
+    return path.str();
+}
+
+std::string TransactionIndex::segmentIndexPath(unsigned int id) const {
+    std::string path = segmentPath(id);
+    return path.substr(0, path.size() - 4) + ".idx";
+}
+
+// Shared file helpers
+
+uint64_t TransactionIndex::scanFile(const std::string& path, uint64_t from, uint64_t to,
+                                    LocationMap& into, SegmentFooter* footer) {
+    // An unterminated last line is still being written and is left out
+    return LineScanner::scanFile(path, from, to, [&](std::string_view line, uint64_t offset) {
+        int accountNumber = accountOf(line);
+        if (accountNumber >= 0) {
+            into[accountNumber].push_back(Location{offset, line.size() + 1});
+            if (footer) {
+                footer->include(line);
+            }
+        }
+    });
+}
+
+bool TransactionIndex::readLines(const std::string& path, const std::vector<Location>& where, int accountNumber,
+                                 const std::string& from, const std::string& to, std::vector<std::string>& into) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::string prefix = std::to_string(accountNumber) + ":";
+    for (const Location& location : where) {
+        std::string line(location.length, '\0');
+        file.seekg(static_cast<std::streamoff>(location.offset));
+        file.read(&line[0], static_cast<std::streamsize>(location.length));
+        if (!file.good() || line.back() != '\n' || line.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        line.pop_back();
+        if (isClosure(line)) {
+            into.clear(); // everything so far belongs to the closed account
+            continue;
+        }
+        if (timestampInRange(historyTimestamp(line), from, to)) {
+            into.push_back(std::move(line));
+        }
+    }
+    return true;
+}
+
+void TransactionIndex::writeIndexFile(const std::string& path, const LocationMap& entries) {
+    std::vector<IndexEntry> sorted;
+    for (const auto& pair : entries) {
+        for (const Location& location : pair.second) {
+            sorted.push_back(IndexEntry{pair.first, location.offset, location.length});
+        }
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return a.offset < b.offset;
+    });
+
+    std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file.is_open()) {
+            return;
+        }
+        for (const IndexEntry& entry : sorted) {
+            file << entry.accountNumber << ":" << entry.offset << ":" << entry.length << "\n";
+        }
+    }
+#ifdef _WIN32
+    std::remove(path.c_str());
+#endif
+    std::rename(tempPath.c_str(), path.c_str());
+}
+
+// Active segment
+
+void TransactionIndex::add(int accountNumber, uint64_t offset, uint64_t length) {
+    locations[accountNumber].push_back(Location{offset, length});
+    indexedEnd = offset + length;
+}
+
+void TransactionIndex::appendEntry(int accountNumber, uint64_t offset, uint64_t length) {
+    if (!indexFile.is_open()) {
+        indexFile.open(indexPath, std::ios::app);
+        if (!indexFile.is_open()) {
+            return; // the index is only a cache; lookups rebuild it
+        }
+    }
+    indexFile << accountNumber << ":" << offset << ":" << length << "\n";
+    indexFile.flush();
+}
+
+void TransactionIndex::scanHistory(uint64_t from, uint64_t to) {
+    uint64_t end = scanFile(historyPath, from, to, locations, nullptr);
+    if (end > indexedEnd) {
+        indexedEnd = end;
+    }
+}
+
+void TransactionIndex::rewriteIndexFile() {
+    if (indexFile.is_open()) {
+        indexFile.close();
+    }
+    writeIndexFile(indexPath, locations);
+}
+
+void TransactionIndex::rebuild() {
+    locations.clear();
+    indexedEnd = 0;
+    scanHistory(0, fileSize(historyPath));
+    rewriteIndexFile();
+    loaded = true;
+}
+
+void TransactionIndex::load() {
+    locations.clear();
+    indexedEnd = 0;
+
+    std::vector<IndexEntry> entries;
+    std::ifstream file(indexPath);
+    std::string line;
+    IndexEntry entry;
+    while (std::getline(file, line)) {
+        if (parseIndexEntry(line, entry)) {
+            entries.push_back(entry);
+        }
+    }
+    file.close();
+    std::stable_sort(entries.begin(), entries.end(), [](const IndexEntry& a, const IndexEntry& b) {
+        return a.offset < b.offset;
+    });
+
+    uint64_t size = fileSize(historyPath);
+    bool repaired = false;
+    for (const IndexEntry& indexed : entries) {
+        if (indexed.offset + indexed.length > size) {
+            // Points past the history: the file was replaced or truncated
+            rebuild();
+            return;
+        }
+        if (indexed.offset < indexedEnd) {
+            repaired = true; // duplicate left by a gap fill
+            continue;
+        }
+        if (indexed.offset > indexedEnd) {
+            scanHistory(indexedEnd, indexed.offset);
+            repaired = true;
+            if (indexedEnd != indexed.offset) {
+                rebuild();
+                return;
+            }
+        }
+        add(indexed.accountNumber, indexed.offset, indexed.length);
+    }
+    if (indexedEnd < size) {
+        scanHistory(indexedEnd, size);
+        repaired = true;
+    }
+    if (repaired) {
+        rewriteIndexFile();
+    }
+    loaded = true;
+}
+
+void TransactionIndex::refreshActive() {
+    if (!loaded) {
+        load();
+        return;
+    }
+    uint64_t size = fileSize(historyPath);
+    if (size < indexedEnd) {
+        rebuild();
+    } else if (size > indexedEnd) {
+        scanHistory(indexedEnd, size);
+        rewriteIndexFile();
+    }
+}
+
+void TransactionIndex::record(int accountNumber, uint64_t offset, uint64_t length) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (offset + length > activeEnd) {
+        activeEnd = offset + length;
+    }
+    if (activeStart == 0) {
+        // The segment's age counts from its first line
+        std::string first;
+        if (offset > 0) {
+            std::ifstream file(historyPath);
+            std::getline(file, first);
+        }
+        activeStart = first.empty() ? std::time(nullptr) : parseTimestamp(std::string(historyTimestamp(first)));
+    }
+
+    if (!loaded) {
+        // Not in memory yet; the next lookup will load this entry from disk
+        appendEntry(accountNumber, offset, length);
+        return;
+    }
+    if (offset < indexedEnd) {
+        return; // already picked up by a scan
+    }
+    if (offset > indexedEnd) {
+        // Someone else appended in between; index their lines first
+        scanHistory(indexedEnd, offset);
+        rewriteIndexFile();
+        if (indexedEnd != offset) {
+            loaded = false;
+            return;
+        }
+    }
+    add(accountNumber, offset, length);
+    appendEntry(accountNumber, offset, length);
+}
+
+// Sealed segments
+
+void TransactionIndex::loadSegments() {
+    sealed.clear();
+    for (unsigned int id = 1;; id++) {
+        std::string path = segmentPath(id);
+        std::ifstream probe(path);
+        if (!probe.is_open()) {
+            break;
+        }
+        probe.close();
+
+        Segment segment;
+        segment.id = id;
+        if (!SegmentFooter::parse(readLastLine(path), segment.footer)) {
+            // No usable footer; summarise the segment from its lines
+            SegmentFooter footer;
+            scanFile(path, 0, fileSize(path), segment.locations, &footer);
+            footer.seal();
+            segment.footer = std::move(footer);
+            segment.indexLoaded = true;
+            writeIndexFile(segmentIndexPath(id), segment.locations);
+        }
+        sealed.push_back(std::move(segment));
+    }
+    segmentsLoaded = true;
+}
+
+void TransactionIndex::loadSegmentIndex(Segment& segment) {
+    if (segment.indexLoaded) {
+        return;
+    }
+    segment.locations.clear();
+
+    std::string path = segmentPath(segment.id);
+    uint64_t size = fileSize(path);
+    uint64_t count = 0;
+    bool valid = true;
+    std::ifstream file(segmentIndexPath(segment.id));
+    std::string line;
+    IndexEntry entry;
+    while (valid && std::getline(file, line)) {
+        valid = parseIndexEntry(line, entry) && entry.offset + entry.length <= size;
+        if (valid) {
+            segment.locations[entry.accountNumber].push_back(Location{entry.offset, entry.length});
+            count++;
+        }
+    }
+    if (!file.is_open() || !valid || count != segment.footer.lines) {
+        segment.locations.clear();
+        scanFile(path, 0, size, segment.locations, nullptr);
+        writeIndexFile(segmentIndexPath(segment.id), segment.locations);
+    }
+    segment.indexLoaded = true;
+}
+
+bool TransactionIndex::refreshSegments() {
+    if (segmentsLoaded && !std::ifstream(segmentPath(nextSegmentId())).is_open()) {
+        return false;
+    }
+    bool sealedElsewhere = segmentsLoaded;
+    loadSegments();
+    if (sealedElsewhere) {
+        // Another process sealed the active segment; this one is new
+        loaded = false;
+        if (indexFile.is_open()) {
+            indexFile.close();
+        }
+        activeEnd = fileSize(historyPath);
+        activeStart = 0;
+    }
+    return sealedElsewhere;
+}
+
+TransactionIndex::Segment* TransactionIndex::findSegment(unsigned int id) {
+    for (Segment& segment : sealed) {
+        if (segment.id == id) {
+            return &segment;
+        }
+    }
+    return nullptr;
+}
+
+unsigned int TransactionIndex::nextSegmentId() const {
+    return sealed.empty() ? 1 : sealed.back().id + 1;
+}
+
+// Lookups
+
+std::vector<std::string> TransactionIndex::lines(int accountNumber, const std::string& from, const std::string& to) {
+    std::lock_guard<std::mutex> lock(mutex);
+    refreshSegments();
+    refreshActive();
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        std::vector<std::string> result;
+        bool valid = true;
+
+        // Nothing before the segment that last closed the account is visible
+        size_t first = 0;
+        for (size_t i = 0; i < sealed.size(); i++) {
+            if (sealed[i].footer.closes(accountNumber)) {
+                first = i;
+            }
+        }
+
+        for (size_t i = first; i < sealed.size() && valid; i++) {
+            Segment& segment = sealed[i];
+            if (!segment.footer.accounts.mayContain(accountNumber) ||
+                (!segment.footer.overlaps(from, to) && !segment.footer.closes(accountNumber))) {
+                continue; // cannot hold a matching line
+            }
+            loadSegmentIndex(segment);
+            auto it = segment.locations.find(accountNumber);
+            if (it == segment.locations.end()) {
+                continue;
+            }
+            if (!readLines(segmentPath(segment.id), it->second, accountNumber, from, to, result)) {
+                // Stale segment index: rebuild it from the segment
+                std::remove(segmentIndexPath(segment.id).c_str());
+                segment.indexLoaded = false;
+                valid = false;
+            }
+        }
+
+        if (valid) {
+            auto it = locations.find(accountNumber);
+            if (it != locations.end() && !readLines(historyPath, it->second, accountNumber, from, to, result)) {
+                rebuild();
+                valid = false;
+            }
+        }
+        if (valid) {
+            return result;
+        }
+    }
+    return {};
+}
+
+// Rotation
+
+bool TransactionIndex::needsSeal() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return sealDue();
+}
+
+bool TransactionIndex::sealDue() const {
+    if (activeEnd == 0) {
+        return false;
+    }
+    if (activeEnd >= segmentBytes) {
+        return true;
+    }
+    return segmentSeconds > 0 && activeStart > 0 &&
+           std::difftime(std::time(nullptr), activeStart) >= segmentSeconds;
+}
+
+void TransactionIndex::seal(GroupCommitLog& log) {
+    std::lock_guard<std::mutex> sealLock(sealMutex);
+    unsigned int id;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (refreshSegments() && !sealDue()) {
+            return; // another process sealed it already
+        }
+        id = nextSegmentId();
+    }
+
+    // Bytes already in the active segment never change, so most of the scan
+    // runs before appends are held back
+    LocationMap sealedLocations;
+    SegmentFooter footer;
+    uint64_t scanned = scanFile(historyPath, 0, fileSize(historyPath), sealedLocations, &footer);
+
+    log.exclusive([&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        refreshSegments();
+        uint64_t size = fileSize(historyPath);
+        if (nextSegmentId() != id || size < scanned) {
+            return; // sealed by another process meanwhile
+        }
+        scanned = scanFile(historyPath, scanned, size, sealedLocations, &footer);
+        if (footer.lines == 0) {
+            return;
+        }
+        footer.seal();
+
+        {
+            std::ofstream out(historyPath, std::ios::app | std::ios::binary);
+            if (scanned < size) {
+                out << '\n'; // end a torn final line so the footer stays intact
+            }
+            out << footer.toLine() << '\n';
+            if (!out.good()) {
+                throw std::runtime_error("Failed to write segment footer");
+            }
+        }
+        GroupCommitLog::syncFile(historyPath);
+
+        writeIndexFile(segmentIndexPath(id), sealedLocations);
+        if (std::rename(historyPath.c_str(), segmentPath(id).c_str()) != 0) {
+            throw std::runtime_error("Failed to seal " + historyPath);
+        }
+        if (indexFile.is_open()) {
+            indexFile.close();
+        }
+        std::remove(indexPath.c_str());
+        GroupCommitLog::syncDirectory(directoryOf(historyPath));
+
+        Segment segment;
+        segment.id = id;
+        segment.footer = std::move(footer);
+        segment.locations = std::move(sealedLocations);
+        segment.indexLoaded = true;
+        sealed.push_back(std::move(segment));
+
+        locations.clear();
+        indexedEnd = 0;
+        loaded = true;
+        activeEnd = 0;
+        activeStart = 0;
+    });
+}
+
+// Compaction support
+
+std::vector<unsigned int> TransactionIndex::segmentIds() {
+    std::lock_guard<std::mutex> lock(mutex);
+    refreshSegments();
+    std::vector<unsigned int> ids;
+    for (const Segment& segment : sealed) {
+        ids.push_back(segment.id);
+    }
+    return ids;
+}
+
+std::unordered_set<int> TransactionIndex::closedAccounts() {
+    std::lock_guard<std::mutex> lock(mutex);
+    refreshSegments();
+    std::unordered_set<int> closed;
+    for (const Segment& segment : sealed) {
+        closed.insert(segment.footer.closedAccounts.begin(), segment.footer.closedAccounts.end());
+    }
+
+    // The active segment has no footer yet
+    LineScanner::scanFile(historyPath, 0, UINT64_MAX, [&](std::string_view line, uint64_t) {
+        if (isClosure(line)) {
+            closed.insert(accountOf(line));
+        }
+    });
+    return closed;
+}
+
+bool TransactionIndex::activeHasAny(const std::unordered_set<int>& accounts) {
+    std::lock_guard<std::mutex> lock(mutex);
+    refreshActive();
+    for (int accountNumber : accounts) {
+        if (locations.count(accountNumber)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool TransactionIndex::segmentHasReclaimable(unsigned int id, const std::unordered_set<int>& closed) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Segment* segment = findSegment(id);
+    if (!segment) {
+        return false;
+    }
+    for (int accountNumber : closed) {
+        if (!segment->footer.accounts.mayContain(accountNumber)) {
+            continue;
+        }
+        loadSegmentIndex(*segment);
+        auto it = segment->locations.find(accountNumber);
+        if (it == segment->locations.end()) {
+            continue;
+        }
+        // Tombstones stay; anything else of a closed account can go
+        size_t tombstones = static_cast<size_t>(std::count(segment->footer.closedAccounts.begin(),
+                                                           segment->footer.closedAccounts.end(), accountNumber));
+        if (it->second.size() > tombstones) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TransactionIndex::replaceSegment(unsigned int id, const std::string& compactedPath, const std::string& compactedIndexPath) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Segment* segment = findSegment(id);
+    if (!segment) {
+        throw std::runtime_error("Unknown history segment " + std::to_string(id));
+    }
+
+    std::string path = segmentPath(id);
+    std::string segmentIndex = segmentIndexPath(id);
+    // No lookup can run between the two renames
+#ifdef _WIN32
+    std::remove(path.c_str());
+    std::remove(segmentIndex.c_str());
+#endif
+    if (std::rename(compactedPath.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Failed to replace " + path);
+    }
+    if (std::rename(compactedIndexPath.c_str(), segmentIndex.c_str()) != 0) {
+        std::remove(segmentIndex.c_str()); // a missing index is rebuilt on demand
+    }
+
+    SegmentFooter footer;
+    if (SegmentFooter::parse(readLastLine(path), footer)) {
+        segment->footer = std::move(footer);
+    }
+    segment->locations.clear();
+    segment->indexLoaded = false;
+}
@@ -0,0 +1,169 @@
+#include "../include/WorkStealingPool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+
+unsigned int WorkStealingPool::workersFromEnvironment() {
+    const char* value = std::getenv("BANK_WORKERS");
+    if (value && *value) {
+        char* end = nullptr;
+        unsigned long parsed = std::strtoul(value, &end, 10);
+        if (end && *end == '\0') {
+            return static_cast<unsigned int>(std::min(parsed, 256ul));
+        }
+    }
+    // Two workers even on one core, so a statement never blocks every
+    // balance check
+    return std::max(std::thread::hardware_concurrency(), 2u);
+}
+
+WorkStealingPool::WorkStealingPool(unsigned int count)
+    : nextWorker(0), longRunning(0), pendingShort(0), pendingLong(0), stopping(false) {
+    count = std::max(count, 1u);
+    maxLongRunning = std::max(count - 1, 1u);
+    for (unsigned int i = 0; i < count; ++i) {
+        workers.push_back(std::unique_ptr<Worker>(new Worker()));
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i]->thread = std::thread(&WorkStealingPool::run, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+    for (auto& worker : workers) {
+        worker->thread.join();
+    }
+}
+
+void WorkStealingPool::submit(Task task, Priority priority) {
+    Worker& worker = *workers[nextWorker++ % workers.size()];
+    {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (priority == Priority::LONG) {
+            worker.longTasks.push_back(std::move(task));
+            ++pendingLong;
+        } else {
+            worker.shortTasks.push_back(std::move(task));
+            ++pendingShort;
+        }
+    }
+    {
+        // Taking the lock orders this with a worker checking for work just
+        // before it sleeps, so the wakeup is not lost
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wakeup.notify_one();
+}
+
+std::vector<WorkStealingPool::WorkerStats> WorkStealingPool::stats() const {
+    std::vector<WorkerStats> result;
+    for (const auto& worker : workers) {
+        WorkerStats stats;
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            stats.queued = worker->shortTasks.size() + worker->longTasks.size();
+        }
+        stats.executed = worker->executed.load();
+        stats.stolen = worker->stolen.load();
+        result.push_back(stats);
+    }
+    return result;
+}
+
+bool WorkStealingPool::hasRunnableWork() const {
+    return pendingShort.load() > 0 || (pendingLong.load() > 0 && longRunning.load() < maxLongRunning);
+}
+
+bool WorkStealingPool::drained() const {
+    return pendingShort.load() == 0 && pendingLong.load() == 0;
+}
+
+bool WorkStealingPool::takeFrom(size_t self, bool longTask, Task& task) {
+    std::atomic<size_t>& pending = longTask ? pendingLong : pendingShort;
+    if (pending.load() == 0) {
+        return false;
+    }
+    // Own deque first, oldest task first; then the newest task of each other
+    // worker, starting with the next one so thieves spread out
+    for (size_t i = 0; i < workers.size(); ++i) {
+        Worker& victim = *workers[(self + i) % workers.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        std::deque<Task>& queue = longTask ? victim.longTasks : victim.shortTasks;
+        if (queue.empty()) {
+            continue;
+        }
+        if (i == 0) {
+            task = std::move(queue.front());
+            queue.pop_front();
+        } else {
+            task = std::move(queue.back());
+            queue.pop_back();
+            ++workers[self]->stolen;
+        }
+        --pending;
+        return true;
+    }
+    return false;
+}
+
+bool WorkStealingPool::takeLong(size_t self, Task& task) {
+    if (pendingLong.load() == 0) {
+        return false;
+    }
+    unsigned int running = longRunning.load();
+    do {
+        if (running >= maxLongRunning) {
+            return false;
+        }
+    } while (!longRunning.compare_exchange_weak(running, running + 1));
+
+    if (takeFrom(self, true, task)) {
+        return true;
+    }
+    --longRunning;
+    return false;
+}
+
+void WorkStealingPool::run(size_t self) {
+    Worker& worker = *workers[self];
+    while (true) {
+        Task task;
+        bool longTask = false;
+        if (!takeFrom(self, false, task)) {
+            longTask = takeLong(self, task);
+            if (!longTask) {
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                wakeup.wait(lock, [this] { return hasRunnableWork() || (stopping && drained()); });
+                if (stopping && drained()) {
+                    return;
+                }
+                continue;
+            }
+        }
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            std::cerr << "Error: worker task failed: " << e.what() << std::endl;
+        } catch (...) {
+            std::cerr << "Error: worker task failed" << std::endl;
+        }
+        ++worker.executed;
+
+        // A finished statement frees a slot for the next one; a worker that
+        // found only long tasks over the limit is asleep waiting for it
+        if (longTask) {
+            --longRunning;
+        }
+        if ((longTask && pendingLong.load() > 0) || stopping) {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            wakeup.notify_all();
+        }
+    }
+}
@@ -0,0 +1,193 @@
+#!/usr/bin/env bash
+# Many processes changing balances in one data directory at once.
+#
+# Usage: tests/conservation_test.sh path/to/bank
+#
+# Two `bank http` servers, one on each multi-process engine and each taking
+# many requests at once so that their commits go out in large batches, and
+# a crowd of one-shot CLI
+# processes deposit, withdraw and transfer between a handful of accounts,
+# while a small BANK_SEGMENT_BYTES keeps sealing the transaction history
+# underneath them. Afterwards:
+#   - the balances add up to the opening total plus the successful deposits
+#     minus the successful withdrawals
+#   - the history holds exactly the lines of the successful operations, and
+#     every one of them is well formed
+#   - every account's statement holds all of its history lines
+set -u
+
+if [ $# -ne 1 ] || [ ! -x "$1" ]; then
+    echo "Usage: $0 path/to/bank" >&2
+    exit 2
+fi
+BANK=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+
+ACCOUNTS=8
+FIRST=10000
+PASSWORD='Passw0rd!'
+CLI_WORKERS=8
+CLI_OPS=25
+HTTP_OPS=600
+HTTP_PARALLEL=128
+
+DIR=$(mktemp -d)
+SERVERS=""
+cleanup() {
+    [ -n "$SERVERS" ] && kill $SERVERS 2>/dev/null
+    wait 2>/dev/null
+    rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+# Run from bin/, so the data directory is ../data
+mkdir -p "$DIR/bin" "$DIR/data" "$DIR/log"
+cp "$BANK" "$DIR/bin/bank"
+cd "$DIR/bin" || exit 1
+for i in $(seq 0 $((ACCOUNTS - 1))); do
+    echo "$((1000 + i)):Customer$i:98765000$i" >> ../data/customers.txt
+    # Alternating savings and current accounts with 1000.00 or more each
+    echo "$((FIRST + i)):$((1000 + i)):$((1000 + i)).00:$((i % 2))" >> ../data/accounts.txt
+    echo "CUSTOMER:user$i:$PASSWORD:$((1000 + i))" >> ../data/auth.txt
+done
+for i in $(seq 0 $((ACCOUNTS - 1))); do
+    echo "ACCOUNT:$((FIRST + i)):$PASSWORD" >> ../data/auth.txt
+done
+echo "$((1000 + ACCOUNTS)):$((FIRST + ACCOUNTS))" > ../data/counters.txt
+
+export BANK_SEGMENT_BYTES=2048 BANK_GROUP_COMMIT_MAX_WAIT_US=2000 BANK_WORKERS=$HTTP_PARALLEL
+
+# Balance of an account in cents
+balance() {
+    ./bank get-account "$1" | sed -n 's/.*"balance":\([0-9]*\)\.\([0-9][0-9]\).*/\1\2/p'
+}
+
+total() {
+    local sum=0 cents
+    for i in $(seq 0 $((ACCOUNTS - 1))); do
+        cents=$(balance $((FIRST + i)))
+        if [ -z "$cents" ]; then
+            echo "FAIL: cannot read account $((FIRST + i))" >&2
+            exit 1
+        fi
+        sum=$((sum + 10#$cents))
+    done
+    echo $sum
+}
+
+before=$(total)
+
+# Workers log "cents lines" for each operation that succeeded: the cents it
+# moved into or out of the bank and the history lines it wrote
+cli_worker() {
+    RANDOM=$1
+    local a b
+    for _ in $(seq $CLI_OPS); do
+        a=$((FIRST + RANDOM % ACCOUNTS))
+        b=$((FIRST + RANDOM % ACCOUNTS))
+        case $((RANDOM % 4)) in
+            0) ./bank deposit $a 5 "$PASSWORD" >/dev/null 2>&1 && echo "500 1" ;;
+            1) ./bank withdraw $a 3 "$PASSWORD" >/dev/null 2>&1 && echo "-300 1" ;;
+            *) [ $a != $b ] && ./bank transfer $a $b 7 "$PASSWORD" >/dev/null 2>&1 && echo "0 2" ;;
+        esac
+    done > "../log/cli$1"
+}
+
+# One request in a curl config file, whose strings escape quotes. The
+# query string, which routing ignores, carries what a success amounts to.
+request() {
+    echo 'next'
+    echo 'silent'
+    echo "url = \"http://127.0.0.1:$1/api/transactions/$2?moved=$3\""
+    echo "data = \"$(echo "$4" | sed 's/"/\\"/g')\""
+    echo 'header = "Content-Type: application/json"'
+    echo 'output = "/dev/null"'
+    echo 'write-out = "%{http_code} %{url_effective}\\n"'
+}
+
+# One curl keeping HTTP_PARALLEL requests in flight against a server
+http_client() {
+    local port=$1 a b
+    RANDOM=$port
+    for _ in $(seq $HTTP_OPS); do
+        a=$((FIRST + RANDOM % ACCOUNTS))
+        b=$(((a - FIRST + 1 + RANDOM % (ACCOUNTS - 1)) % ACCOUNTS + FIRST))
+        case $((RANDOM % 4)) in
+            0) request $port deposit 200+1 "{\"accountNumber\":\"$a\",\"amount\":\"2\",\"password\":\"$PASSWORD\"}" ;;
+            1) request $port withdraw -100+1 "{\"accountNumber\":\"$a\",\"amount\":\"1\",\"password\":\"$PASSWORD\"}" ;;
+            *) request $port transfer 0+2 \
+                   "{\"fromAccount\":\"$a\",\"toAccount\":\"$b\",\"amount\":\"3\",\"password\":\"$PASSWORD\"}" ;;
+        esac
+    done > "../log/curl$port"
+    curl -s -Z --parallel-max $HTTP_PARALLEL -K "../log/curl$port" 2>/dev/null |
+        sed -n 's/^200 .*moved=\(-*[0-9]*\)+\([0-9]*\)$/\1 \2/p' > "../log/http$port"
+}
+
+# The sequencer persists up to 256 commands in one batch
+PORTS=""
+n=0
+for engine in sequencer locks; do
+    n=$((n + 1))
+    port=$((20000 + (RANDOM + $$ + n) % 20000))
+    BANK_ENGINE=$engine ./bank http $port > "../log/server$n" 2>&1 &
+    SERVERS="$SERVERS $!"
+    PORTS="$PORTS $port"
+done
+for port in $PORTS; do
+    for _ in $(seq 50); do
+        curl -s -o /dev/null "http://127.0.0.1:$port/api/accounts/$FIRST" && break
+        sleep 0.1
+    done
+done
+
+WORKERS=""
+for port in $PORTS; do
+    http_client $port &
+    WORKERS="$WORKERS $!"
+done
+for w in $(seq $CLI_WORKERS); do
+    cli_worker $((100 + w)) &
+    WORKERS="$WORKERS $!"
+done
+wait $WORKERS
+kill $SERVERS 2>/dev/null
+wait $SERVERS 2>/dev/null
+SERVERS=""
+
+after=$(total)
+moved=$(cat ../log/cli* ../log/http* | awk '{ sum += $1 } END { print sum + 0 }')
+written=$(cat ../log/cli* ../log/http* | awk '{ sum += $2 } END { print sum + 0 }')
+failed=0
+
+if [ $((before + moved)) -ne "$after" ]; then
+    echo "FAIL: opening $before + moved $moved cents != closing $after" >&2
+    failed=1
+fi
+
+lines=$(cat ../data/transactions*.txt | grep -c -v '^#SEGMENT')
+if [ "$lines" -ne "$written" ]; then
+    echo "FAIL: $written history lines written, $lines in the history" >&2
+    failed=1
+fi
+
+# account:timestamp:type:amount[:other account]
+malformed=$(cat ../data/transactions*.txt | grep -v '^#SEGMENT' |
+    grep -c -v -E '^[0-9]+:[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}-[0-9]{2}-[0-9]{2}:[0-9]+:-?[0-9]+\.[0-9]{2}(:[0-9]+)?$')
+if [ "$malformed" -ne 0 ]; then
+    echo "FAIL: $malformed malformed history lines" >&2
+    failed=1
+fi
+
+for i in $(seq 0 $((ACCOUNTS - 1))); do
+    account=$((FIRST + i))
+    history=$(cat ../data/transactions*.txt | grep -c "^$account:")
+    statement=$(./bank get-transactions $account | grep -o '"amount"' | wc -l)
+    if [ "$history" -ne "$statement" ]; then
+        echo "FAIL: account $account has $history history lines but $statement in its statement" >&2
+        failed=1
+    fi
+done
+
+segments=$(ls ../data | grep -c -E '^transactions\.[0-9]+\.txt$')
+echo "$((before + moved)) == $after cents, $lines history lines in $segments sealed segments and the active one"
+[ $failed -eq 0 ] && echo "conservation: ok"
+exit $failed
@@ -0,0 +1,142 @@
+// Several processes appending to one GroupCommitLog file at once.
+//
+// Each process runs threads whose appends are gathered into batches of
+// several KB, larger than a stdio buffer, as a busy server's are. Every
+// line must come out whole and exactly once, at the offset append()
+// returned for it.
+#include "../include/GroupCommitLog.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+const int PROCESSES = 12;
+const int THREADS = 6;
+const int APPENDS = 300;  // per thread
+const size_t LINE = 1000; // bytes, with the newline
+
+std::string makeLine(int process, int thread, int n) {
+    std::string line = std::to_string(process) + ":" + std::to_string(thread) + ":" + std::to_string(n) + ":";
+    line.resize(LINE - 1, 'x');
+    return line + "\n";
+}
+
+// Appends from THREADS threads, then lists "process thread n offset" for
+// each line in offsetsPath
+int appendAll(const std::string& path, const std::string& offsetsPath, int process) {
+    GroupCommitLog::Options options;
+    options.sync = false;
+    options.maxWait = std::chrono::microseconds(2000);
+    GroupCommitLog log(path, options);
+
+    std::vector<std::vector<uint64_t>> offsets(THREADS, std::vector<uint64_t>(APPENDS));
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; t++) {
+        threads.emplace_back([&, t] {
+            for (int n = 0; n < APPENDS; n++) {
+                offsets[t][n] = log.append(makeLine(process, t, n));
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::ofstream out(offsetsPath);
+    for (int t = 0; t < THREADS; t++) {
+        for (int n = 0; n < APPENDS; n++) {
+            out << process << " " << t << " " << n << " " << offsets[t][n] << "\n";
+        }
+    }
+    return out.good() ? 0 : 1;
+}
+
+} // namespace
+
+int main() {
+    char dir[] = "/tmp/group_commit_test.XXXXXX";
+    if (!mkdtemp(dir)) {
+        std::perror("mkdtemp");
+        return 1;
+    }
+    const std::string path = std::string(dir) + "/log.txt";
+    auto offsetsPath = [&](int process) { return std::string(dir) + "/offsets." + std::to_string(process); };
+
+    std::vector<pid_t> children;
+    for (int p = 0; p < PROCESSES; p++) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            _exit(appendAll(path, offsetsPath(p), p));
+        }
+        children.push_back(pid);
+    }
+    int failures = 0;
+    for (pid_t pid : children) {
+        int status = 0;
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::printf("an appending process failed\n");
+            failures++;
+        }
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    std::string contents((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    const size_t expected = static_cast<size_t>(PROCESSES) * THREADS * APPENDS;
+    if (contents.size() != expected * LINE) {
+        std::printf("%zu bytes in the log, expected %zu\n", contents.size(), expected * LINE);
+        failures++;
+    }
+
+    // Every line whole and seen once
+    std::set<std::tuple<int, int, int>> seen;
+    std::istringstream lines(contents);
+    std::string line;
+    size_t torn = 0;
+    while (std::getline(lines, line)) {
+        int process = -1, thread = -1, n = -1;
+        if (std::sscanf(line.c_str(), "%d:%d:%d:", &process, &thread, &n) != 3 ||
+            line + "\n" != makeLine(process, thread, n) || !seen.insert({process, thread, n}).second) {
+            torn++;
+        }
+    }
+    if (torn > 0 || seen.size() != expected) {
+        std::printf("%zu torn or repeated lines, %zu of %zu lines intact\n", torn, seen.size(), expected);
+        failures++;
+    }
+
+    // Every offset returned by append() points at its own line
+    size_t misplaced = 0;
+    for (int p = 0; p < PROCESSES; p++) {
+        std::ifstream offsets(offsetsPath(p));
+        int process, thread, n;
+        uint64_t offset;
+        while (offsets >> process >> thread >> n >> offset) {
+            if (contents.compare(offset, LINE, makeLine(process, thread, n)) != 0) {
+                misplaced++;
+            }
+        }
+        std::remove(offsetsPath(p).c_str());
+    }
+    if (misplaced > 0) {
+        std::printf("%zu offsets do not point at their line\n", misplaced);
+        failures++;
+    }
+
+    std::remove(path.c_str());
+    rmdir(dir);
+    if (failures > 0) {
+        return 1;
+    }
+    std::printf("%d processes appended %zu lines intact\n", PROCESSES, expected);
+    return 0;
+}
@@ -0,0 +1,117 @@
+// Lazy interest accrual against eager month-ends.
+//
+// Runs the same random operations twice: once adding each savings account's
+// interest at every month-end, once only advancing the interest period so
+// that balances catch up through accrue(). Every result and balance seen
+// along the way must match to the cent. The lazy run also calls
+// applyMonthlyUpdate() on savings accounts, which must not add interest a
+// second time.
+#include "../include/SavingsAccount.h"
+#include "../include/CurrentAccount.h"
+#include "../include/Customer.h"
+#include <cstdio>
+#include <exception>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+
+const unsigned SEEDS = 200;
+const int STEPS = 4000;
+
+uint32_t period = 0;
+
+void monthEnd(std::vector<std::unique_ptr<Account>>& accounts, bool lazy) {
+    for (auto& account : accounts) {
+        bool savings = account->getType() == AccountType::SAVINGS;
+        try {
+            if (savings && !lazy) {
+                // What month-end did before interest accrued lazily
+                account->deposit(account->calculateInterest());
+            } else {
+                account->applyMonthlyUpdate();
+            }
+        } catch (const std::exception&) {
+            // A fee the account cannot pay, as month-end reports it
+        }
+    }
+    if (lazy) {
+        period++;
+    }
+}
+
+std::vector<int64_t> run(bool lazy, unsigned seed) {
+    period = 0;
+    Account::setPeriodSource(&period);
+    Customer owner(1, "Accrual", "0");
+    std::mt19937_64 rng(seed);
+    std::vector<std::unique_ptr<Account>> accounts;
+    for (int i = 0; i < 8; i++) {
+        Money opening = Money::fromDouble(std::uniform_real_distribution<double>(0, 5000)(rng));
+        if (i % 4 == 3) {
+            accounts.push_back(std::make_unique<CurrentAccount>(10000 + i, opening, &owner));
+        } else {
+            accounts.push_back(std::make_unique<SavingsAccount>(10000 + i, opening, &owner, 0.01 + 0.01 * i));
+        }
+    }
+
+    std::vector<int64_t> trace;
+    for (int step = 0; step < STEPS; step++) {
+        Account& a = *accounts[rng() % accounts.size()];
+        Account& b = *accounts[rng() % accounts.size()];
+        Money amount = Money::fromDouble(std::uniform_real_distribution<double>(0.01, 900)(rng));
+        switch (rng() % 6) {
+            case 0:
+                trace.push_back(a.deposit(amount));
+                break;
+            case 1:
+                trace.push_back(a.withdraw(amount));
+                break;
+            case 2:
+                if (&a != &b) {
+                    trace.push_back(Account::transferBetween(a, b, amount));
+                }
+                break;
+            case 3:
+            case 4:
+                trace.push_back(a.getBalance().toMinor());
+                break;
+            case 5: {
+                // Several month-ends may pass between two operations
+                int months = 1 + static_cast<int>(rng() % 3);
+                for (int m = 0; m < months; m++) {
+                    monthEnd(accounts, lazy);
+                }
+                break;
+            }
+        }
+    }
+    for (auto& account : accounts) {
+        trace.push_back(account->getBalance().toMinor());
+    }
+    Account::setPeriodSource(nullptr);
+    return trace;
+}
+
+} // namespace
+
+int main() {
+    for (unsigned seed = 1; seed <= SEEDS; seed++) {
+        std::vector<int64_t> eager = run(false, seed);
+        std::vector<int64_t> lazy = run(true, seed);
+        if (eager.size() != lazy.size()) {
+            std::printf("seed %u: %zu eager results, %zu lazy\n", seed, eager.size(), lazy.size());
+            return 1;
+        }
+        for (size_t i = 0; i < eager.size(); i++) {
+            if (eager[i] != lazy[i]) {
+                std::printf("seed %u, result %zu: eager %lld, lazy %lld\n", seed, i,
+                            static_cast<long long>(eager[i]), static_cast<long long>(lazy[i]));
+                return 1;
+            }
+        }
+    }
+    std::printf("lazy accrual matches eager month-ends over %u seeds\n", SEEDS);
+    return 0;
+}
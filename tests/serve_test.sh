@@ -0,0 +1,75 @@
+#!/usr/bin/env bash
+# Framing of `bank serve` responses on stdout.
+#
+# Usage: tests/serve_test.sh path/to/bank
+#
+# Sends requests that succeed and fail, among them a second registration of
+# the same username, and reads the responses back frame by frame: every
+# header must be "<exitCode> <stdoutLength> <stderrLength>", the lengths
+# must cover exactly what follows up to the next header, and nothing may
+# be left over.
+set -u
+
+if [ $# -ne 1 ] || [ ! -x "$1" ]; then
+    echo "Usage: $0 path/to/bank" >&2
+    exit 2
+fi
+BANK=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+
+DIR=$(mktemp -d)
+trap 'rm -rf "$DIR"' EXIT
+
+# Run from bin/, so the data directory is ../data
+mkdir -p "$DIR/bin" "$DIR/data"
+cp "$BANK" "$DIR/bin/bank"
+cd "$DIR/bin" || exit 1
+echo "1000:Existing:9876500000" > ../data/customers.txt
+echo "10000:1000:100.00:1" > ../data/accounts.txt
+printf 'CUSTOMER:existing:Passw0rd!:1000\nACCOUNT:10000:Passw0rd!\n' > ../data/auth.txt
+echo "1001:10001" > ../data/counters.txt
+
+# Fields are separated by tabs; "expected exit code" precedes each request
+REQUESTS=(
+    "0 register	Alice Smith	9876500001	alice_1	Passw0rd!"
+    "1 register	Alice Again	9876500002	alice_1	Passw0rd!"
+    "1 register	Bad User	9876500003	ab	Passw0rd!"
+    "1 change-password	alice_1	wrong	Newpassw0rd"
+    "0 change-password	alice_1	Passw0rd!	Newpassw0rd"
+    "0 get-user	alice_1"
+    "1 withdraw	10000	500	Passw0rd!"
+    "0 get-account	10000"
+)
+for request in "${REQUESTS[@]}"; do
+    echo "${request#* }"
+done > ../requests
+./bank serve < ../requests > ../responses 2> ../stderr
+
+failed=0
+exec 3< ../responses
+for i in "${!REQUESTS[@]}"; do
+    request=${REQUESTS[$i]}
+    if ! IFS= read -r header <&3 || ! [[ $header =~ ^([0-9]+)\ ([0-9]+)\ ([0-9]+)$ ]]; then
+        echo "FAIL: response $((i + 1)) has header '${header:-}'" >&2
+        failed=1
+        break
+    fi
+    code=${BASH_REMATCH[1]}
+    out=$(dd bs=1 count="${BASH_REMATCH[2]}" <&3 2>/dev/null | tr '\n' ' ')
+    err=$(dd bs=1 count="${BASH_REMATCH[3]}" <&3 2>/dev/null | tr '\n' ' ')
+    if [ "$code" != "${request%% *}" ]; then
+        echo "FAIL: '${request#* }' exited $code: $out$err" >&2
+        failed=1
+    fi
+    if [ $i -eq 1 ] && [[ $err != *"Username already exists"* ]]; then
+        echo "FAIL: duplicate registration says '$err' on stderr" >&2
+        failed=1
+    fi
+done
+if [ $failed -eq 0 ] && [ -n "$(cat <&3)" ]; then
+    echo "FAIL: bytes left after the last response" >&2
+    failed=1
+fi
+exec 3<&-
+
+[ $failed -eq 0 ] && echo "serve: ${#REQUESTS[@]} responses framed"
+exit $failed